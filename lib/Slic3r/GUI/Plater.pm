@@ -1559,7 +1559,7 @@ sub export_amf {
     return if !@{$self->{objects}};
         
     my $output_file = $self->_get_export_file('AMF') or return;
-    $self->{model}->store_amf(Slic3r::encode_path($output_file));
+    $self->{model}->store_amf(Slic3r::encode_path($output_file), $output_file =~ /\.zip\.amf$/i);
     $self->statusbar->SetStatusText("AMF file exported to $output_file");
 }
 
@@ -1567,7 +1567,7 @@ sub _get_export_file {
     my $self = shift;
     my ($format) = @_;
     
-    my $suffix = $format eq 'STL' ? '.stl' : '.amf.xml';
+    my $suffix = $format eq 'STL' ? '.stl' : '.zip.amf';
     
     my $output_file = $main::opt{output};
     {
@@ -2125,17 +2125,18 @@ sub make_thumbnail {
     # make method idempotent
     $self->thumbnail->clear;
     
-    my $mesh = $model->objects->[$obj_idx]->raw_mesh;
-    if ($mesh->facets_count <= 5000) {
+    # the projections are cached by the model object until its volumes change
+    my $model_object = $model->objects->[$obj_idx];
+    if ($model_object->facets_count <= 5000) {
         # remove polygons with area <= 1mm
         my $area_threshold = Slic3r::Geometry::scale 1;
         $self->thumbnail->append(
             grep $_->area >= $area_threshold,
-            @{ $mesh->horizontal_projection },   # horizontal_projection returns scaled expolygons
+            @{ $model_object->raw_horizontal_projection },   # raw_horizontal_projection returns scaled expolygons
         );
         $self->thumbnail->simplify(0.5);
     } else {
-        my $convex_hull = Slic3r::ExPolygon->new($mesh->convex_hull);
+        my $convex_hull = Slic3r::ExPolygon->new($model_object->raw_convex_hull);
         $self->thumbnail->append($convex_hull);
     }
     
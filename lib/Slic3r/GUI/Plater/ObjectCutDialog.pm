@@ -232,9 +232,8 @@ sub _update {
             # get section contour
             my @expolygons = ();
             foreach my $volume (@{$self->{model_object}->volumes}) {
-                next if !$volume->mesh;
                 next if $volume->modifier;
-                my $expp = $volume->mesh->slice([ $z + $volume->mesh->bounding_box->z_min ])->[0];
+                my $expp = $volume->mesh_copy->slice([ $z + $volume->bounding_box->z_min ])->[0];
                 push @expolygons, @$expp;
             }
             foreach my $expolygon (@expolygons) {
@@ -326,7 +326,7 @@ sub on_btn_load {
                 $new_volume->set_name(basename($input_file));
                 
                 # apply the same translation we applied to the object
-                $new_volume->mesh->translate(@{$self->{model_object}->origin_translation});
+                $new_volume->translate(@{$self->{model_object}->origin_translation});
                 
                 # set a default extruder value, since user can't add it manually
                 $new_volume->config->set_ifndef('extruder', 0);
@@ -443,7 +443,7 @@ sub _update {
     if ($itemData && $itemData->{type} eq 'volume') {
         my $d = Slic3r::Pointf3->new($m_x - $l_x, $m_y - $l_y, $m_z - $l_z);
         my $volume = $self->{model_object}->volumes->[$itemData->{volume_id}];
-        $volume->mesh->translate(@{$d});
+        $volume->translate(@{$d});
         $self->{last_coords}{x} = $m_x;
         $self->{last_coords}{y} = $m_y;
         $self->{last_coords}{z} = $m_z;
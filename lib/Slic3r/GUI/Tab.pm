@@ -522,7 +522,7 @@ sub build {
         layer_height first_layer_height
         perimeters spiral_vase
         top_solid_layers bottom_solid_layers
-        extra_perimeters ensure_vertical_shell_thickness avoid_crossing_perimeters thin_walls overhangs
+        extra_perimeters ensure_vertical_shell_thickness avoid_crossing_perimeters avoid_crossing_perimeters_visibility thin_walls overhangs
         seam_position external_perimeters_first
         fill_density fill_pattern external_fill_pattern
         infill_every_layers infill_only_where_needed
@@ -537,7 +537,7 @@ sub build {
         travel_speed
         first_layer_speed
         perimeter_acceleration infill_acceleration bridge_acceleration 
-        first_layer_acceleration default_acceleration
+        first_layer_acceleration default_acceleration max_jerk max_extruder_jerk
         skirts skirt_distance skirt_height min_skirt_length
         brim_width
         support_material support_material_threshold support_material_enforce_layers
@@ -587,6 +587,7 @@ sub build {
             $optgroup->append_single_option_line('extra_perimeters');
             $optgroup->append_single_option_line('ensure_vertical_shell_thickness');
             $optgroup->append_single_option_line('avoid_crossing_perimeters');
+            $optgroup->append_single_option_line('avoid_crossing_perimeters_visibility');
             $optgroup->append_single_option_line('thin_walls');
             $optgroup->append_single_option_line('overhangs');
         }
@@ -694,6 +695,8 @@ sub build {
             $optgroup->append_single_option_line('bridge_acceleration');
             $optgroup->append_single_option_line('first_layer_acceleration');
             $optgroup->append_single_option_line('default_acceleration');
+            $optgroup->append_single_option_line('max_jerk');
+            $optgroup->append_single_option_line('max_extruder_jerk');
         }
         {
             my $optgroup = $page->new_optgroup('Autospeed (advanced)');
@@ -911,6 +914,8 @@ sub _update {
     
     $self->get_field('gap_fill_speed')->toggle($have_perimeters && $have_infill);
     
+    $self->get_field('avoid_crossing_perimeters_visibility')->toggle($config->avoid_crossing_perimeters);
+    
     my $have_top_solid_infill = $config->top_solid_layers > 0;
     $self->get_field($_)->toggle($have_top_solid_infill)
         for qw(top_infill_extrusion_width top_solid_infill_speed);
@@ -5,18 +5,34 @@ use File::Basename qw(basename);
 use List::Util qw(first max any);
 use Slic3r::Geometry qw(X Y Z move_points);
 
+# Directory of the binary cache of the parsed and repaired models, disabled if undefined.
+our $cache_dir;
+
 sub read_from_file {
     my $class = shift;
     my ($input_file) = @_;
     
-    my $model = $input_file =~ /\.stl$/i            ? Slic3r::Model->load_stl(Slic3r::encode_path($input_file), basename($input_file))
-              : $input_file =~ /\.obj$/i            ? Slic3r::Model->load_obj(Slic3r::encode_path($input_file), basename($input_file))
-              : $input_file =~ /\.amf(\.xml)?$/i    ? Slic3r::Model->load_amf(Slic3r::encode_path($input_file))
-              : $input_file =~ /\.prus$/i           ? Slic3r::Model->load_prus(Slic3r::encode_path($input_file))
-              : die "Input file must have .stl, .obj or .amf(.xml) extension\n";
-    
-    die "The supplied file couldn't be read because it's empty.\n"
-        if $model->objects_count == 0;
+    # The cache is keyed by the hash of the input file.
+    my ($cache_file, $hash);
+    if (defined $cache_dir && -d Slic3r::encode_path($cache_dir)) {
+        $hash = Slic3r::Model->file_hash(Slic3r::encode_path($input_file));
+        $cache_file = Slic3r::encode_path("$cache_dir/$hash.model") if defined $hash;
+    }
+    my $model = (defined $cache_file && -e $cache_file) ? Slic3r::Model->load_cache($cache_file, $hash) : undef;
+    
+    if (!defined $model) {
+        $model = $input_file =~ /\.stl$/i            ? Slic3r::Model->load_stl(Slic3r::encode_path($input_file), basename($input_file))
+               : $input_file =~ /\.obj$/i            ? Slic3r::Model->load_obj(Slic3r::encode_path($input_file), basename($input_file))
+               : $input_file =~ /\.amf(\.xml)?$/i    ? Slic3r::Model->load_amf(Slic3r::encode_path($input_file))
+               : $input_file =~ /\.prus$/i           ? Slic3r::Model->load_prus(Slic3r::encode_path($input_file))
+               : die "Input file must have .stl, .obj or .amf(.xml) extension\n";
+        
+        die "The supplied file couldn't be read because it's empty.\n"
+            if $model->objects_count == 0;
+        
+        $model->store_cache($cache_file, $hash)
+            if defined $cache_file;
+    }
     
     $_->set_input_file($input_file) for @{$model->objects};
     return $model;
@@ -82,7 +98,7 @@ sub looks_like_multipart_object {
     return 0 if any { $_->volumes_count > 1 } @{$self->objects};
     return 0 if any { @{$_->config->get_keys} > 1 } @{$self->objects};
     
-    my %heights = map { $_ => 1 } map $_->mesh->bounding_box->z_min, map @{$_->volumes}, @{$self->objects};
+    my %heights = map { $_ => 1 } map $_->bounding_box->z_min, map @{$_->volumes}, @{$self->objects};
     return scalar(keys %heights) > 1;
 }
 
@@ -191,7 +207,7 @@ sub mesh_stats {
     my $self = shift;
     
     # TODO: sum values from all volumes
-    return $self->volumes->[0]->mesh->stats;
+    return $self->volumes->[0]->mesh_copy->stats;
 }
 
 sub print_info {
@@ -75,26 +75,35 @@ sub export_gcode {
     $self->status_cb->(90, "Exporting G-code" . ($output_file ? " to $output_file" : ""));
     
     {
-        # open output gcode file if we weren't supplied a file-handle
-        my ($fh, $tempfile);
-        if ($params{output_fh}) {
-            $fh = $params{output_fh};
-        } else {
-            $tempfile = "$output_file.tmp";
-            Slic3r::open(\$fh, ">", $tempfile)
-                or die "Failed to open $tempfile for writing\n";
-    
-            # enable UTF-8 output since user might have entered Unicode characters in fields like notes
-            binmode $fh, ':utf8';
-        }
+        my $tempfile = $params{output_fh} ? undef : "$output_file.tmp";
+        if ($self->_has_perl_gcode_filters) {
+            # open output gcode file if we weren't supplied a file-handle
+            my $fh;
+            if ($params{output_fh}) {
+                $fh = $params{output_fh};
+            } else {
+                Slic3r::open(\$fh, ">", $tempfile)
+                    or die "Failed to open $tempfile for writing\n";
+        
+                # enable UTF-8 output since user might have entered Unicode characters in fields like notes
+                binmode $fh, ':utf8';
+            }
 
-        Slic3r::Print::GCode->new(
-            print   => $self,
-            fh      => $fh,
-        )->export;
+            Slic3r::Print::GCode->new(
+                print   => $self,
+                fh      => $fh,
+            )->export;
 
-        # close our gcode file
-        close $fh;
+            # close our gcode file, the supplied file-handle is left open
+            close $fh if $tempfile;
+        } elsif ($tempfile) {
+            # the C++ exporter writes the file directly
+            $self->_export_gcode(Slic3r::encode_path($tempfile));
+        } else {
+            # the C++ exporter writes into the supplied file-handle, which is left open
+            my $fh = $params{output_fh};
+            $self->_export_gcode_cb(sub { print $fh $_[0] });
+        }
         if ($tempfile) {
             my $i;
             for ($i = 0; $i < 5; $i += 1)  {
@@ -121,6 +130,15 @@ sub export_gcode {
     }
 }
 
+# The spiral vase, arc fitting and pressure regulator G-code filters are only implemented in Perl,
+# the C++ G-code exporter is used if none of them is enabled.
+sub _has_perl_gcode_filters {
+    my ($self) = @_;
+    return $self->config->spiral_vase
+        || $self->config->gcode_arcs
+        || $self->config->pressure_advance > 0;
+}
+
 # Export SVG slices for the offline SLA printing.
 sub export_svg {
     my $self = shift;
@@ -194,7 +194,11 @@ sub export {
                 push @islands_p, @copy_islands_p;
             }
         }
-        $gcodegen->avoid_crossing_perimeters->init_external_mp(union_ex(\@islands_p));
+        $gcodegen->avoid_crossing_perimeters->init_external_mp(union_ex(\@islands_p),
+            $self->config->avoid_crossing_perimeters_visibility);
+        
+        # prepare the motion planners of all layers, so that change_layer() does not build them
+        $_->make_motion_planners for @{$self->objects};
     }
     
     # calculate wiping points if needed
@@ -314,6 +318,9 @@ sub export {
     print $fh $gcodegen->writer->update_progress($gcodegen->layer_count, $gcodegen->layer_count, 1);  # 100%
     print $fh $gcodegen->writer->postamble;
     
+    # release the motion planners prepared for the layers
+    $_->clear_motion_planners for @{$self->objects};
+    
     # get filament stats
     $self->print->clear_filament_stats;
     $self->print->total_used_filament(0);
@@ -346,6 +353,15 @@ sub export {
     printf $fh "; total filament cost = %.1f\n",
            $self->print->total_cost;
     
+    # sum of the layer times estimated from the moves, after the cooling slow down;
+    # the start / end G-code and the moves between the layers are not accounted for
+    if (defined $self->_cooling_buffer) {
+        my $print_time = sum(0, map $_->{print_time}, @{$self->_cooling_buffer->layer_stats});
+        my $seconds = int($print_time + 0.5);
+        printf $fh "; estimated printing time = %dh %dm %ds\n",
+            int($seconds / 3600), int($seconds / 60) % 60, $seconds % 60;
+    }
+    
     # append full config
     print $fh "\n";
     foreach my $config ($self->print->config, $self->print->default_object_config, $self->print->default_region_config) {
@@ -380,6 +396,10 @@ sub process_layer {
     my $object = $layer->object;
     $self->_gcodegen->config->apply_static($object->config);
     
+    # the CoolingBuffer estimates the layer time from the moves and formats the marked feedrates
+    $self->_cooling_buffer->record_moves
+        if defined $self->_cooling_buffer;
+    
     # check whether we're going to apply spiralvase logic
     if (defined $self->_spiral_vase) {
         $self->_spiral_vase->enable(
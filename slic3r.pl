@@ -37,6 +37,7 @@ my %cli_options = ();
         'no-plater'             => \$opt{no_plater},
         'gui-mode=s'            => \$opt{gui_mode},
         'datadir=s'             => \$opt{datadir},
+        'model-cache=s'         => \$opt{model_cache},
         'export-svg'            => \$opt{export_svg},
         'merge|m'               => \$opt{merge},
         'repair'                => \$opt{repair},
@@ -97,6 +98,9 @@ if ($opt{save}) {
 my $config = Slic3r::Config->new_from_defaults;
 $config->apply($cli_config);
 
+$Slic3r::Model::cache_dir = Slic3r::decode_path($opt{model_cache})
+    if defined $opt{model_cache};
+
 # launch GUI
 my $gui;
 if ((!@ARGV || $opt{gui}) && !$opt{save} && eval "require Slic3r::GUI; 1") {
@@ -266,6 +270,8 @@ Usage: slic3r.pl [ OPTIONS ] [ file.stl ] [ file2.stl ] ...
                         directory is specified for this option, the output will
                         be saved under that directory, and the filename will be
                         generated by --output-filename-format.
+    --model-cache <dir> Cache the loaded and repaired models in the specified directory
+                        and load them from there when the same input file is sliced again.
   
   Non-slicing actions (no G-code will be generated):
     --repair            Repair given STL files and save them as <name>_fixed.obj
@@ -363,6 +369,10 @@ $j
     --default-acceleration
                         Acceleration will be reset to this value after the specific settings above
                         have been applied. (mm/s^2, set zero to disable; default: $config->{default_acceleration})
+    --max-jerk          Maximum velocity change of the XYZ axes set in the firmware, used to estimate
+                        the layer times. (mm/s, set zero for 20 mm/s; default: $config->{max_jerk})
+    --max-extruder-jerk Maximum velocity change of the extruder set in the firmware, used to estimate
+                        the retraction times. (mm/s, set zero for 5 mm/s; default: $config->{max_extruder_jerk})
     
   Accuracy options:
     --layer-height      Layer height in mm (default: $config->{layer_height})
@@ -407,6 +417,8 @@ $j
     --extra-perimeters  Add more perimeters when needed (default: yes)
     --ensure-vertical-shell-thickness Add solid infill near sloping surfaces to guarantee the vertical shell thickness (top+bottom solid layers). (default: no)
     --avoid-crossing-perimeters Optimize travel moves so that no perimeters are crossed (default: no)
+    --avoid-crossing-perimeters-visibility
+                        Plan these travel moves around the island corners (default: no)
     --thin-walls        Detect single-width walls (default: yes)
     --overhangs         Experimental option to use bridge flow, speed and fan for overhangs
                         (default: yes)
@@ -1,4 +1,4 @@
-use Test::More tests => 1;
+use Test::More tests => 4;
 use strict;
 use warnings;
 
@@ -9,6 +9,7 @@ BEGIN {
 
 use List::Util qw(first sum);
 use Slic3r;
+use Slic3r::Geometry::Clipper qw(intersection_pl);
 use Slic3r::Test;
 
 {
@@ -18,4 +19,41 @@ use Slic3r::Test;
     ok my $gcode = Slic3r::Test::gcode($print), "no crash with avoid_crossing_perimeters and multiple objects";
 }
 
+{
+    # A travel move may leave the island it starts in and enter the island it ends in,
+    # it shall not pass through any other island nor through the hole of the island it stays in.
+    my $config = Slic3r::Config->new_from_defaults;
+    $config->set('avoid_crossing_perimeters', 1);
+    my %travel_length = ();
+    foreach my $visibility (0, 1) {
+        $config->set('avoid_crossing_perimeters_visibility', $visibility);
+        my $print = Slic3r::Test::init_print('cube_with_hole', config => $config, duplicate => 2);
+        my $gcode = Slic3r::Test::gcode($print);
+        my $object = $print->print->objects->[0];
+        my @islands = ();
+        foreach my $copy (@{$object->_shifted_copies}) {
+            foreach my $expolygon (@{$object->get_layer(0)->slices}) {
+                my $island = $expolygon->clone;
+                $island->translate(@$copy);
+                push @islands, $island;
+            }
+        }
+        my $crossings = 0;
+        $travel_length{$visibility} = 0;
+        Slic3r::GCode::Reader->new->parse($gcode, sub {
+            my ($self, $cmd, $args, $info) = @_;
+            return if !$info->{travel} || !$info->{dist_XY};
+            my $travel = Slic3r::Polyline->new_scale([ $self->X, $self->Y ], [ $info->{new_X}, $info->{new_Y} ]);
+            $travel_length{$visibility} += $info->{dist_XY};
+            foreach my $island (@islands) {
+                my $ends = grep $island->contains_point($_), $travel->first_point, $travel->last_point;
+                next if $ends == 1;
+                $crossings += @{ intersection_pl([ $travel ], $ends ? $island->holes : [ @$island ]) };
+            }
+        });
+        is $crossings, 0, "no travel move crosses the islands, visibility graph: $visibility";
+    }
+    ok $travel_length{1} <= $travel_length{0}, 'travel moves over the visibility graph are not longer than over the Voronoi graph';
+}
+
 __END__
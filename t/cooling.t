@@ -2,7 +2,7 @@ use Test::More;
 use strict;
 use warnings;
 
-plan tests => 12;
+plan tests => 21;
 
 BEGIN {
     use FindBin;
@@ -156,4 +156,131 @@ $config->set('disable_fan_first_layers', 0);
     ok $all_below, 'slowdown_below_layer_time is honored';
 }
 
+{
+    my $config = Slic3r::Config->new_from_defaults;
+    $config->set('cooling', 1);
+    $config->set('disable_fan_first_layers', 0);
+    $config->set('slowdown_below_layer_time', 20);
+    $config->set('min_print_speed', 10);
+    
+    my $buffer = buffer($config);
+    # The first layer takes half of slowdown_below_layer_time, the extrusions are slowed down by half.
+    $buffer->gcodegen->set_elapsed_time(10);
+    my $gcode = $buffer->append(
+        "G1 F3000;_EXTRUDE_SET_SPEED\n" .
+        "G1 X10 E1\n" .
+        "G1 F1000;_EXTRUDE_SET_SPEED\n" .
+        "G1 X20 E2\n" .
+        "G1 F2400;_EXTRUDE_SET_SPEED;_WIPE\n" .
+        "G1 X30 E1.5\n" .
+        ";_BRIDGE_FAN_START\n" .
+        "G1 F900;_EXTRUDE_SET_SPEED\n" .
+        "G1 X40 E2.5\n" .
+        ";_BRIDGE_FAN_END\n" .
+        "G1 X0 F7800\n",
+        0, 0, 0.4
+    );
+    $buffer->gcodegen->set_elapsed_time(30);
+    $gcode .= $buffer->append("G1 F3000;_EXTRUDE_SET_SPEED\nG1 X10 E3\n", 0, 1, 0.8);
+    $gcode .= $buffer->flush;
+    
+    my @F = $gcode =~ /F(\d+(?:\.\d+)?)/g;
+    is_deeply \@F, [1500, 600, 2400, 900, 7800, 3000],
+        'marked feedrates are scaled down to min_print_speed, wipes, bridges, travels and long layers are not';
+    unlike $gcode, qr/;_/, 'cooling markers are removed';
+    is_deeply [ map [ @$_{qw(layer_id elapsed_time print_time speed_factor)} ], @{$buffer->layer_stats} ],
+        [ [0, 10, 20, 0.5], [1, 30, 30, 1] ],
+        'per-layer timing stats';
+}
+
+# The layer times estimated from the moves recorded by the writer.
+sub recorded_buffer {
+    my ($config) = @_;
+    my $buffer = buffer($config);
+    $buffer->gcodegen->set_extruders([0]);
+    $buffer->gcodegen->writer->set_extruder(0);
+    $buffer->record_moves;
+    return $buffer;
+}
+
+{
+    my $config = Slic3r::Config->new_from_defaults;
+    $config->set('cooling', 1);
+    $config->set('travel_speed', 130);
+    $config->set('max_jerk', 20);
+    
+    # From rest, the move starts and ends at the jerk speed, the acceleration to 130 mm/s
+    # and the deceleration take (130^2 - 20^2) / (2 * acceleration) mm each.
+    foreach my $acceleration (1000, 0) {
+        $config->set('default_acceleration', $acceleration);
+        my $buffer = recorded_buffer($config);
+        $buffer->append($buffer->gcodegen->writer->travel_to_xy(Slic3r::Pointf->new(100, 0)), 0, 0, 0.4);
+        $buffer->flush;
+        # Without default_acceleration, the firmware default of 1500 mm/s^2 is assumed.
+        my $a = $acceleration || 1500;
+        my $time = 2 * (130 - 20) / $a + (100 - (130**2 - 20**2) / $a) / 130;
+        ok abs($buffer->layer_stats->[0]{elapsed_time} - $time) < 0.001,
+            "time of a trapezoidal move with acceleration $a";
+    }
+    
+    {
+        # The direction changes by 90 degrees, the junction speed is limited to 20 / sqrt(2) mm/s.
+        $config->set('default_acceleration', 1000);
+        my $buffer = recorded_buffer($config);
+        my $writer = $buffer->gcodegen->writer;
+        $buffer->append(
+            $writer->travel_to_xy(Slic3r::Pointf->new(100, 0)) . $writer->travel_to_xy(Slic3r::Pointf->new(100, 100)),
+            0, 0, 0.4);
+        $buffer->flush;
+        my $junction = 20 / sqrt(2);
+        my $time = 2 * ((130 - 20) / 1000 + (130 - $junction) / 1000
+            + (100 - (130**2 - 20**2) / 2000 - (130**2 - $junction**2) / 2000) / 130);
+        ok abs($buffer->layer_stats->[0]{elapsed_time} - $time) < 0.001, 'junction speed is limited by the jerk';
+    }
+}
+
+{
+    my $config = Slic3r::Config->new_from_defaults;
+    $config->set('cooling', 1);
+    $config->set('default_acceleration', 1000);
+    $config->set('disable_fan_first_layers', 0);
+    
+    # A 100 mm square extruded at 30 mm/s takes a bit more than 13.3 s.
+    my $square = sub {
+        my ($buffer) = @_;
+        my $writer = $buffer->gcodegen->writer;
+        my $gcode = $writer->set_speed(1800, '', ';_EXTRUDE_SET_SPEED');
+        $gcode .= $writer->extrude_to_xy(Slic3r::Pointf->new(@$_), 1) for [100, 0], [100, 100], [0, 100], [0, 0];
+        $buffer->append($gcode, 0, 0, 0.4);
+        return $buffer->flush;
+    };
+    
+    $config->set('slowdown_below_layer_time', 13);
+    my $buffer = recorded_buffer($config);
+    my $gcode = $square->($buffer);
+    ok $gcode =~ /^G1 F1800$/m && $buffer->layer_stats->[0]{speed_factor} == 1,
+        'no slowdown if the estimated layer time is above slowdown_below_layer_time';
+    
+    $config->set('slowdown_below_layer_time', 14);
+    $buffer = recorded_buffer($config);
+    $gcode = $square->($buffer);
+    my ($F) = $gcode =~ /^G1 F([0-9.]+)$/m;
+    my $stats = $buffer->layer_stats->[0];
+    ok $F < 1800 && abs($F - 1800 * $stats->{speed_factor}) < 0.01 && abs($stats->{print_time} - 14) < 0.001,
+        'the extrusions are slowed down to stretch the layer to slowdown_below_layer_time';
+    
+    # A G-code filter duplicated a marked line, there is no feedrate recorded for the copy.
+    $buffer = recorded_buffer($config);
+    my $writer = $buffer->gcodegen->writer;
+    my $set_speed = $writer->set_speed(1800, '', ';_EXTRUDE_SET_SPEED');
+    $gcode = $set_speed;
+    $gcode .= $writer->extrude_to_xy(Slic3r::Pointf->new(@$_), 1) for [100, 0], [100, 100];
+    $gcode .= $set_speed;
+    $gcode .= $writer->extrude_to_xy(Slic3r::Pointf->new(@$_), 1) for [0, 100], [0, 0];
+    $gcode = $buffer->append($gcode, 0, 0, 0.4);
+    $gcode .= $buffer->flush;
+    is_deeply [ $gcode =~ /^G1 F(.*)$/mg ], [1800, 1800],
+        'marked feedrates are not slowed down if the marked lines do not match the recorded moves';
+}
+
 __END__
@@ -1,4 +1,4 @@
-use Test::More tests => 25;
+use Test::More tests => 28;
 use strict;
 use warnings;
 
@@ -242,4 +242,36 @@ use Slic3r::Test;
     ok !$has_m204, 'M204 is not generated for repetier firmware';
 }
 
+{
+    # The native exporter produces the same G-code as the Perl exporter, for several objects and extruders.
+    my $config = Slic3r::Config->new_from_defaults;
+    $config->set('infill_extruder', 2);
+    $config->set('skirts', 1);
+    $config->set('brim_width', 3);
+    $config->set('notes', "Plate \x{2013} two objects");
+    # Both exporters slow the layers down by the times estimated from the recorded moves.
+    $config->set('cooling', 1);
+    $config->set('slowdown_below_layer_time', 30);
+    
+    my $export = sub {
+        my ($native) = @_;
+        my $model = Slic3r::Model->merge(Slic3r::Test::model('20mm_cube'), Slic3r::Test::model('cube_with_hole'));
+        my $print = Slic3r::Test::init_print($model, config => $config)->print;
+        my $fh = IO::Scalar->new(\my $gcode);
+        if ($native) {
+            $print->export_gcode(output_fh => $fh, quiet => 1);
+        } else {
+            $print->process;
+            Slic3r::Print::GCode->new(print => $print, fh => $fh)->export;
+        }
+        ok $fh->opened, 'the supplied file handle is left open' if $native;
+        $fh->close;
+        $gcode =~ s/^; generated by.*\n//mg;
+        return $gcode;
+    };
+    my $gcode = $export->(1);
+    ok $gcode =~ /^; estimated printing time = \d+h \d+m \d+s$/m, 'estimated printing time is written';
+    ok $gcode eq $export->(0), 'native G-code export is identical to the Perl exporter';
+}
+
 __END__
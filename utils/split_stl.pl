@@ -30,7 +30,7 @@ my %opt = ();
     $basename =~ s/\.stl$//i;
     
     my $part_count = 0;
-    my $mesh = $model->objects->[0]->volumes->[0]->mesh;
+    my $mesh = $model->objects->[0]->volumes->[0]->mesh_copy;
     foreach my $new_mesh (@{$mesh->split}) {
         $new_mesh->repair;
         
@@ -30,8 +30,6 @@
 
 static void stl_match_neighbors_exact(stl_file *stl,
                                       stl_hash_edge *edge_a, stl_hash_edge *edge_b);
-static void stl_match_neighbors_nearby(stl_file *stl,
-                                       stl_hash_edge *edge_a, stl_hash_edge *edge_b);
 static void stl_record_neighbors(stl_file *stl,
                                  stl_hash_edge *edge_a, stl_hash_edge *edge_b);
 static void stl_initialize_facet_check_exact(stl_file *stl);
@@ -474,7 +472,7 @@ stl_match_neighbors_exact(stl_file *stl,
   stl_record_neighbors(stl, edge_a, edge_b);
 }
 
-static void
+void
 stl_match_neighbors_nearby(stl_file *stl,
                            stl_hash_edge *edge_a, stl_hash_edge *edge_b) {
   int facet1;
@@ -403,205 +403,204 @@ void EdgeGrid::Grid::create_from_m_contours(coord_t resolution)
 	}
 }
 
-#if 0
 // Divide, round to a grid coordinate.
 // Divide x/y, round down. y is expected to be positive.
-static inline coord_t div_floor(coord_t x, coord_t y)
+static inline int64_t div_floor(int64_t x, int64_t y)
 {
 	assert(y > 0);
 	return ((x < 0) ? (x - y + 1) : x) / y;
 }
 
-// Walk the polyline, test whether any lines of this polyline does not intersect
+// Walk the cells along the line segment, the same way create_from_m_contours() rasterizes the edges.
+// The end points may be outside of the grid, the cells outside of the grid are skipped.
+template<typename VISITOR>
+bool EdgeGrid::Grid::visit_cells_intersecting_line(const Point &p1src, const Point &p2src, VISITOR &visitor) const
+{
+	if (m_cells.empty())
+		return true;
+	// End points relative to the grid origin.
+	int64_t x1 = int64_t(p1src.x) - m_bbox.min.x;
+	int64_t y1 = int64_t(p1src.y) - m_bbox.min.y;
+	int64_t x2 = int64_t(p2src.x) - m_bbox.min.x;
+	int64_t y2 = int64_t(p2src.y) - m_bbox.min.y;
+	// Get the cells of the end points.
+	int64_t ix  = div_floor(x1, m_resolution);
+	int64_t iy  = div_floor(y1, m_resolution);
+	int64_t ixb = div_floor(x2, m_resolution);
+	int64_t iyb = div_floor(y2, m_resolution);
+	const int64_t cols = int64_t(m_cols);
+	const int64_t rows = int64_t(m_rows);
+	auto visit = [this, &visitor, cols, rows](int64_t ix, int64_t iy) {
+		return ix < 0 || iy < 0 || ix >= cols || iy >= rows || visitor(m_cells[iy * cols + ix]);
+	};
+	if (! visit(ix, iy))
+		return false;
+	// Raster the rest of the line.
+	int64_t dx = std::abs(x2 - x1);
+	int64_t dy = std::abs(y2 - y1);
+	int     sx = (x1 < x2) ? 1 : -1;
+	int     sy = (y1 < y2) ? 1 : -1;
+	// Distances to the next vertical and horizontal cell boundary, multiplied by dy and dx respectively,
+	// so that they compare as the parameters of the line.
+	int64_t ex = ((sx > 0) ? (ix + 1) * m_resolution - x1 : x1 - ix * m_resolution) * dy;
+	int64_t ey = ((sy > 0) ? (iy + 1) * m_resolution - y1 : y1 - iy * m_resolution) * dx;
+	while (ix != ixb || iy != iyb) {
+		if (dy == 0 || (dx > 0 && ex < ey)) {
+			ey -= ex;
+			ex = dy * m_resolution;
+			ix += sx;
+		} else if (dx == 0 || ey < ex) {
+			ex -= ey;
+			ey = dx * m_resolution;
+			iy += sy;
+		} else {
+			// The line passes through a corner of a cell. Visit the cells sharing the corner,
+			// as the edges stored there may touch the line at the corner.
+			if (! visit(ix + sx, iy) || ! visit(ix, iy + sy))
+				return false;
+			ex = dy * m_resolution;
+			ey = dx * m_resolution;
+			ix += sx;
+			iy += sy;
+		}
+		if ((ix - ixb) * sx > 0 || (iy - iyb) * sy > 0)
+			// The end point lies on a cell boundary and it has been reached.
+			break;
+		if (! visit(ix, iy))
+			return false;
+	}
+	return true;
+}
+
+// Sign of the cross product (b - a) x (c - a), evaluated exactly.
+static inline int orientation(const Point &a, const Point &b, const Point &c)
+{
+	int64_t det = (int64_t(b.x) - a.x) * (int64_t(c.y) - a.y) - (int64_t(b.y) - a.y) * (int64_t(c.x) - a.x);
+	return (det > 0) - (det < 0);
+}
+
+// Do the line segments (p1a, p2a) and (p1b, p2b) intersect or touch?
+static inline bool segments_intersect(const Point &p1a, const Point &p2a, const Point &p1b, const Point &p2b)
+{
+	// Do the bounding boxes intersect?
+	if (std::max(p1a.x, p2a.x) < std::min(p1b.x, p2b.x) || std::max(p1b.x, p2b.x) < std::min(p1a.x, p2a.x) ||
+		std::max(p1a.y, p2a.y) < std::min(p1b.y, p2b.y) || std::max(p1b.y, p2b.y) < std::min(p1a.y, p2a.y))
+		return false;
+	// The end points of each segment shall not lie strictly on a single side of the other segment.
+	// Collinear segments with overlapping bounding boxes overlap.
+	return orientation(p1a, p2a, p1b) * orientation(p1a, p2a, p2b) <= 0 &&
+		   orientation(p1b, p2b, p1a) * orientation(p1b, p2b, p2a) <= 0;
+}
+
+// Do the line segments (p1a, p2a) and (p1b, p2b) cross in a single point interior to both of them?
+static inline bool segments_cross(const Point &p1a, const Point &p2a, const Point &p1b, const Point &p2b)
+{
+	return orientation(p1a, p2a, p1b) * orientation(p1a, p2a, p2b) < 0 &&
+		   orientation(p1b, p2b, p1a) * orientation(p1b, p2b, p2a) < 0;
+}
+
+bool EdgeGrid::Grid::intersect(const Line &line) const
+{
+	bool found = false;
+	auto visitor = [this, &line, &found](const Cell &cell) {
+		for (size_t i = cell.begin; i != cell.end; ++ i)
+			if (segments_intersect(line.a, line.b, this->edge_start(m_cell_data[i]), this->edge_end(m_cell_data[i]))) {
+				found = true;
+				return false;
+			}
+		return true;
+	};
+	this->visit_cells_intersecting_line(line.a, line.b, visitor);
+	return found;
+}
+
+// Walk the polyline, test whether any lines of this polyline intersect
 // any line stored into the grid.
-bool EdgeGrid::Grid::intersect(const MultiPoint &polyline, bool closed)
+bool EdgeGrid::Grid::intersect(const MultiPoint &polyline, bool closed) const
 {
 	size_t n = polyline.points.size();
-	if (closed)
-		++ n;
+	if (! closed && n > 0)
+		-- n;
 	for (size_t i = 0; i < n; ++ i) {
 		size_t j = i + 1;
 		if (j == polyline.points.size())
 			j = 0;
-		Point p1src = polyline.points[i];
-		Point p2src = polyline.points[j];
-		Point p1 = p1src;
-		Point p2 = p2src;
-		// Discretize the line segment p1, p2.
-		p1.x -= m_bbox.min.x;
-		p1.y -= m_bbox.min.y;
-		p2.x -= m_bbox.min.x;
-		p2.y -= m_bbox.min.y;
-		// Get the cells of the end points.
-		coord_t ix = div_floor(p1.x, m_resolution);
-		coord_t iy = div_floor(p1.y, m_resolution);
-		coord_t ixb = div_floor(p2.x, m_resolution);
-		coord_t iyb = div_floor(p2.y, m_resolution);
-//		assert(ix >= 0 && ix < m_cols);
-//		assert(iy >= 0 && iy < m_rows);
-//		assert(ixb >= 0 && ixb < m_cols);
-//		assert(iyb >= 0 && iyb < m_rows);
-		// Account for the end points.
-		if (line_cell_intersect(p1src, p2src, m_cells[iy*m_cols + ix]))
+		if (this->intersect(Line(polyline.points[i], polyline.points[j])))
 			return true;
-		if (ix == ixb && iy == iyb)
-			// Both ends fall into the same cell.
-			continue;
-		// Raster the centeral part of the line.
-		coord_t dx = std::abs(p2.x - p1.x);
-		coord_t dy = std::abs(p2.y - p1.y);
-		if (p1.x < p2.x) {
-			int64_t ex = int64_t((ix + 1)*m_resolution - p1.x) * int64_t(dy);
-			if (p1.y < p2.y) {
-				int64_t ey = int64_t((iy + 1)*m_resolution - p1.y) * int64_t(dx);
-				do {
-					assert(ix <= ixb && iy <= iyb);
-					if (ex < ey) {
-						ey -= ex;
-						ex = int64_t(dy) * m_resolution;
-						ix += 1;
-					}
-					else if (ex == ey) {
-						ex = int64_t(dy) * m_resolution;
-						ey = int64_t(dx) * m_resolution;
-						ix += 1;
-						iy += 1;
-					}
-					else {
-						assert(ex > ey);
-						ex -= ey;
-						ey = int64_t(dx) * m_resolution;
-						iy += 1;
-					}
-					if (line_cell_intersect(p1src, p2src, m_cells[iy*m_cols + ix]))
-						return true;
-				} while (ix != ixb || iy != iyb);
-			}
-			else {
-				int64_t ey = int64_t(p1.y - iy*m_resolution) * int64_t(dx);
-				do {
-					assert(ix <= ixb && iy >= iyb);
-					if (ex <= ey) {
-						ey -= ex;
-						ex = int64_t(dy) * m_resolution;
-						ix += 1;
-					}
-					else {
-						ex -= ey;
-						ey = int64_t(dx) * m_resolution;
-						iy -= 1;
-					}
-					if (line_cell_intersect(p1src, p2src, m_cells[iy*m_cols + ix]))
-						return true;
-				} while (ix != ixb || iy != iyb);
-			}
-		}
-		else {
-			int64_t ex = int64_t(p1.x - ix*m_resolution) * int64_t(dy);
-			if (p1.y < p2.y) {
-				int64_t ey = int64_t((iy + 1)*m_resolution - p1.y) * int64_t(dx);
-				do {
-					assert(ix >= ixb && iy <= iyb);
-					if (ex < ey) {
-						ey -= ex;
-						ex = int64_t(dy) * m_resolution;
-						ix -= 1;
-					}
-					else {
-						assert(ex >= ey);
-						ex -= ey;
-						ey = int64_t(dx) * m_resolution;
-						iy += 1;
-					}
-					if (line_cell_intersect(p1src, p2src, m_cells[iy*m_cols + ix]))
-						return true;
-				} while (ix != ixb || iy != iyb);
+	}
+	return false;
+}
+
+// Does the point lie on the line segment (a, b), but not at its end points?
+static inline bool point_inside_segment(const Point &a, const Point &b, const Point &pt)
+{
+	return orientation(a, b, pt) == 0 &&
+		(int64_t(pt.x) - a.x) * (int64_t(b.x) - a.x) + (int64_t(pt.y) - a.y) * (int64_t(b.y) - a.y) > 0 &&
+		(int64_t(pt.x) - b.x) * (int64_t(a.x) - b.x) + (int64_t(pt.y) - b.y) * (int64_t(a.y) - b.y) > 0;
+}
+
+// Does the direction from the contour vertex pt towards the point dir lie strictly outside the region at the vertex?
+// The region lies on the left side of the contour edges (prev, pt) and (pt, next), as the contours are oriented
+// counter-clockwise and the holes clockwise.
+static inline bool direction_outside(const Point &prev, const Point &pt, const Point &next, const Point &dir)
+{
+	int turn = orientation(prev, pt, next);
+	if (turn > 0)
+		// Convex vertex, the region is the sector from the next edge counter-clockwise to the previous edge.
+		return orientation(pt, next, dir) < 0 || orientation(pt, dir, prev) < 0;
+	if (turn < 0)
+		// Reflex vertex, the outside is the sector from the previous edge counter-clockwise to the next edge.
+		return orientation(pt, prev, dir) > 0 && orientation(pt, dir, next) > 0;
+	// Straight vertex, the region is the half plane on the left. A spike is ignored.
+	return (int64_t(prev.x) - pt.x) * (int64_t(next.x) - pt.x) + (int64_t(prev.y) - pt.y) * (int64_t(next.y) - pt.y) < 0 &&
+		orientation(pt, next, dir) < 0;
+}
+
+bool EdgeGrid::Grid::crosses(const Line &line) const
+{
+	bool found = false;
+	auto visitor = [this, &line, &found](const Cell &cell) {
+		for (size_t i = cell.begin; i != cell.end; ++ i) {
+			const std::pair<size_t, size_t> &edge = m_cell_data[i];
+			const Point &pt = this->edge_start(edge);
+			if (segments_cross(line.a, line.b, pt, this->edge_end(edge))) {
+				found = true;
+				return false;
 			}
-			else {
-				int64_t ey = int64_t(p1.y - iy*m_resolution) * int64_t(dx);
-				do {
-					assert(ix >= ixb && iy >= iyb);
-					if (ex < ey) {
-						ey -= ex;
-						ex = int64_t(dy) * m_resolution;
-						ix -= 1;
-					}
-					else if (ex == ey) {
-						if (dx > 0) {
-							ex = int64_t(dy) * m_resolution;
-							ix -= 1;
-						}
-						if (dy > 0) {
-							ey = int64_t(dx) * m_resolution;
-							iy -= 1;
-						}
-					}
-					else {
-						assert(ex > ey);
-						ex -= ey;
-						ey = int64_t(dx) * m_resolution;
-						iy -= 1;
-					}
-					if (line_cell_intersect(p1src, p2src, m_cells[iy*m_cols + ix]))
-						return true;
-				} while (ix != ixb || iy != iyb);
+			// The line may also leave the region through a vertex without crossing any edge, for example passing
+			// from a corner of a hole to the opposite corner. Each vertex is tested as the start of its edge,
+			// which is stored into the cell containing the vertex, and the line visits that cell.
+			if (point_inside_segment(line.a, line.b, pt)) {
+				const Slic3r::Points &contour = *m_contours[edge.first];
+				const Point &prev = contour[(edge.second == 0) ? contour.size() - 1 : edge.second - 1];
+				if (direction_outside(prev, pt, this->edge_end(edge), line.a) || direction_outside(prev, pt, this->edge_end(edge), line.b)) {
+					found = true;
+					return false;
+				}
 			}
 		}
-	}
-	return false;
+		return true;
+	};
+	this->visit_cells_intersecting_line(line.a, line.b, visitor);
+	return found;
 }
 
-bool EdgeGrid::Grid::line_cell_intersect(const Point &p1a, const Point &p2a, const Cell &cell)
+size_t EdgeGrid::Grid::count_crossings(const Line &line) const
 {
-	BoundingBox bbox(p1a, p1a);
-	bbox.merge(p2a);
-	int64_t va_x = p2a.x - p1a.x;
-	int64_t va_y = p2a.y - p1a.y;
-	for (size_t i = cell.begin; i != cell.end; ++ i) {
-		const std::pair<size_t, size_t> &cell_data = m_cell_data[i];
-		// Contour indexed by the ith line of this cell.
-		const Slic3r::Points &contour = *m_contours[cell_data.first];
-		// Point indices in contour indexed by the ith line of this cell.
-		size_t idx1 = cell_data.second;
-		size_t idx2 = idx1 + 1;
-		if (idx2 == contour.size())
-			idx2 = 0;
-		// The points of the ith line of this cell and its bounding box.
-		const Point &p1b = contour[idx1];
-		const Point &p2b = contour[idx2];
-		BoundingBox bbox2(p1b, p1b);
-		bbox2.merge(p2b);
-		// Do the bounding boxes intersect?
-		if (! bbox.overlap(bbox2))
-			continue;
-		// Now intersect the two line segments using exact arithmetics.
-		int64_t w1_x = p1b.x - p1a.x;
-		int64_t w1_y = p1b.y - p1a.y;
-		int64_t w2_x = p2b.x - p1a.x;
-		int64_t w2_y = p2b.y - p1a.y;
-		int64_t side1 = va_x * w1_y - va_y * w1_x;
-		int64_t side2 = va_x * w2_y - va_y * w2_x;
-		if (side1 == side2 && side1 != 0)
-			// The line segments don't intersect.
-			continue;
-		w1_x = p1a.x - p1b.x;
-		w1_y = p1a.y - p1b.y;
-		w2_x = p2a.x - p1b.x;
-		w2_y = p2a.y - p1b.y;
-		int64_t vb_x = p2b.x - p1b.x;
-		int64_t vb_y = p2b.y - p1b.y;
-		side1 = vb_x * w1_y - vb_y * w1_x;
-		side2 = vb_x * w2_y - vb_y * w2_x;
-		if (side1 == side2 && side1 != 0)
-			// The line segments don't intersect.
-			continue;
-		// The line segments intersect.
+	// An edge is stored into all the cells it passes, collect the edges to count each of them once.
+	std::vector<std::pair<size_t, size_t>> edges;
+	auto visitor = [this, &line, &edges](const Cell &cell) {
+		for (size_t i = cell.begin; i != cell.end; ++ i)
+			if (segments_cross(line.a, line.b, this->edge_start(m_cell_data[i]), this->edge_end(m_cell_data[i])))
+				edges.push_back(m_cell_data[i]);
 		return true;
-	}
-	// The line segment (p1a, p2a) does not intersect any of the line segments inside this cell.
-	return false;
+	};
+	this->visit_cells_intersecting_line(line.a, line.b, visitor);
+	std::sort(edges.begin(), edges.end());
+	return std::unique(edges.begin(), edges.end()) - edges.begin();
 }
 
+#if 0
 // Test, whether a point is inside a contour.
 bool EdgeGrid::Grid::inside(const Point &pt_src)
 {
@@ -25,15 +25,24 @@ public:
 	void create(const ExPolygons &expolygons, coord_t resolution);
 	void create(const ExPolygonCollection &expolygons, coord_t resolution);
 
-#if 0
 	// Test, whether the edges inside the grid intersect with the polygons provided.
-	bool intersect(const MultiPoint &polyline, bool closed);
-	bool intersect(const Polygon &polygon) { return intersect(static_cast<const MultiPoint&>(polygon), true); }
-	bool intersect(const Polygons &polygons) { for (size_t i = 0; i < polygons.size(); ++ i) if (intersect(polygons[i])) return true; return false; }
-	bool intersect(const ExPolygon &expoly) { if (intersect(expoly.contour)) return true; for (size_t i = 0; i < expoly.holes.size(); ++ i) if (intersect(expoly.holes[i])) return true; return false; }
-	bool intersect(const ExPolygons &expolygons) { for (size_t i = 0; i < expolygons.size(); ++ i) if (intersect(expolygons[i])) return true; return false; }
-	bool intersect(const ExPolygonCollection &expolygons) { return intersect(expolygons.expolygons); }
+	// Touching an edge counts as an intersection.
+	bool intersect(const Line &line) const;
+	bool intersect(const MultiPoint &polyline, bool closed) const;
+	bool intersect(const Polygon &polygon) const { return intersect(static_cast<const MultiPoint&>(polygon), true); }
+	bool intersect(const Polygons &polygons) const { for (size_t i = 0; i < polygons.size(); ++ i) if (intersect(polygons[i])) return true; return false; }
+	bool intersect(const ExPolygon &expoly) const { if (intersect(expoly.contour)) return true; for (size_t i = 0; i < expoly.holes.size(); ++ i) if (intersect(expoly.holes[i])) return true; return false; }
+	bool intersect(const ExPolygons &expolygons) const { for (size_t i = 0; i < expolygons.size(); ++ i) if (intersect(expolygons[i])) return true; return false; }
+	bool intersect(const ExPolygonCollection &expolygons) const { return intersect(expolygons.expolygons); }
+
+	// Test, whether the line segment crosses an edge inside the grid in a single point interior to both of them,
+	// or whether it passes through a contour vertex to the outside of the region on the left of the contours.
+	// Touching or overlapping an edge does not count, so a segment connecting the contour points may run along the contours.
+	bool crosses(const Line &line) const;
+	// Number of the edges inside the grid crossed by the line segment the same way, each edge counted once.
+	size_t count_crossings(const Line &line) const;
 
+#if 0
 	// Test, whether a point is inside a contour.
 	bool inside(const Point &pt);
 #endif
@@ -68,9 +77,13 @@ protected:
 	};
 
 	void create_from_m_contours(coord_t resolution);
-#if 0
-	bool line_cell_intersect(const Point &p1, const Point &p2, const Cell &cell);
-#endif
+	// Call visitor(cell) for the cells inside the grid, which are intersected by the line segment (p1, p2).
+	// The walk stops and false is returned as soon as the visitor returns false.
+	template<typename VISITOR> bool visit_cells_intersecting_line(const Point &p1, const Point &p2, VISITOR &visitor) const;
+	// End points of an edge referenced by m_cell_data.
+	const Point& edge_start(const std::pair<size_t, size_t> &edge) const { return (*m_contours[edge.first])[edge.second]; }
+	const Point& edge_end(const std::pair<size_t, size_t> &edge) const
+		{ const Slic3r::Points &contour = *m_contours[edge.first]; return contour[(edge.second + 1 == contour.size()) ? 0 : edge.second + 1]; }
 	bool cell_inside_or_crossing(int r, int c) const
 	{
 		if (r < 0 || r >= m_rows ||
@@ -1,4 +1,5 @@
 #include "ExtrusionEntityCollection.hpp"
+#include "Geometry.hpp"
 #include <algorithm>
 #include <cmath>
 #include <map>
@@ -105,15 +106,9 @@ ExtrusionEntityCollection::chained_path_from(Point start_near, ExtrusionEntityCo
     retval->entities.reserve(this->entities.size());
     retval->orig_indices.reserve(this->entities.size());
     
-    // if we're asked to return the original indices, build a map
-    std::map<ExtrusionEntity*,size_t> indices_map;
-    
     ExtrusionEntitiesPtr my_paths;
-    for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it) {
-        ExtrusionEntity* entity = (*it)->clone();
-        my_paths.push_back(entity);
-        if (orig_indices != NULL) indices_map[entity] = it - this->entities.begin();
-    }
+    for (ExtrusionEntitiesPtr::const_iterator it = this->entities.begin(); it != this->entities.end(); ++it)
+        my_paths.push_back((*it)->clone());
     
     Points endpoints;
     for (ExtrusionEntitiesPtr::iterator it = my_paths.begin(); it != my_paths.end(); ++it) {
@@ -125,19 +120,20 @@ ExtrusionEntityCollection::chained_path_from(Point start_near, ExtrusionEntityCo
         }
     }
     
-    while (!my_paths.empty()) {
+    Geometry::NearestPointLookup lookup(endpoints);
+    while (!lookup.empty()) {
         // find nearest point
-        int start_index = start_near.nearest_point_index(endpoints);
+        int start_index = lookup.nearest(start_near);
         int path_index = start_index/2;
-        ExtrusionEntity* entity = my_paths.at(path_index);
+        ExtrusionEntity* entity = my_paths[path_index];
         // never reverse loops, since it's pointless for chained path and callers might depend on orientation
         if (start_index % 2 && !no_reverse && entity->can_reverse()) {
             entity->reverse();
         }
-        retval->entities.push_back(my_paths.at(path_index));
-        if (orig_indices != NULL) orig_indices->push_back(indices_map[entity]);
-        my_paths.erase(my_paths.begin() + path_index);
-        endpoints.erase(endpoints.begin() + 2*path_index, endpoints.begin() + 2*path_index + 2);
+        retval->entities.push_back(entity);
+        if (orig_indices != NULL) orig_indices->push_back(path_index);
+        lookup.remove(2*path_index);
+        lookup.remove(2*path_index + 1);
         start_near = retval->entities.back()->last_point();
     }
 }
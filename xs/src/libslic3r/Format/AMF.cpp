@@ -1,7 +1,15 @@
 #include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
 #include <map>
 #include <string>
 #include <expat/expat.h>
+#include <zlib.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/path.hpp>
+#include <tbb/parallel_for.h>
 
 #include "../libslic3r.h"
 #include "../Model.hpp"
@@ -19,6 +27,82 @@
 namespace Slic3r
 {
 
+// Parses a decimal number to the same double as strtod() does, but without the locale lookups and
+// mostly without its cost. Numbers of up to 19 significant digits with a decimal exponent below 22
+// are exact after a single multiplication or division by an exactly representable power of ten
+// (Clinger's fast path), the others are passed to strtod().
+static double parse_double(const char *str)
+{
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *p = str;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        ++ p;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+')
+        ++ p;
+    uint64_t mantissa = 0;
+    int      digits   = 0;
+    int      exponent = 0;
+    bool     valid    = false;
+    for (; *p >= '0' && *p <= '9'; ++ p, valid = true)
+        if (mantissa != 0 || *p != '0') {
+            if (++ digits > 19)
+                return strtod(str, nullptr);
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+    if (*p == '.')
+        for (++ p; *p >= '0' && *p <= '9'; ++ p, valid = true) {
+            -- exponent;
+            if (mantissa != 0 || *p != '0') {
+                if (++ digits > 19)
+                    return strtod(str, nullptr);
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+        }
+    if (! valid)
+        return strtod(str, nullptr);
+    if (*p == 'e' || *p == 'E') {
+        const char *e = p + 1;
+        bool exp_negative = *e == '-';
+        if (*e == '-' || *e == '+')
+            ++ e;
+        if (*e < '0' || *e > '9')
+            return strtod(str, nullptr);
+        int exp = 0;
+        for (; *e >= '0' && *e <= '9' && exp < 10000; ++ e)
+            exp = exp * 10 + (*e - '0');
+        exponent += exp_negative ? - exp : exp;
+        p = e;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        ++ p;
+    if (*p != 0 || mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+        return strtod(str, nullptr);
+    double value = double(mantissa);
+    value = (exponent < 0) ? value / pow10[- exponent] : value * pow10[exponent];
+    return negative ? - value : value;
+}
+
+// Parses a non-negative vertex index, returns -1 if str is not a number.
+static int parse_index(const char *str)
+{
+    const char *p = str;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        ++ p;
+    if (*p < '0' || *p > '9')
+        return -1;
+    int64_t value = 0;
+    for (; *p >= '0' && *p <= '9'; ++ p)
+        if ((value = value * 10 + (*p - '0')) > INT32_MAX)
+            return -1;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        ++ p;
+    return (*p == 0) ? int(value) : -1;
+}
+
 struct AMFParserContext
 {
     AMFParserContext(XML_Parser parser, Model *model) :
@@ -40,6 +124,7 @@ struct AMFParserContext
     void startElement(const char *name, const char **atts);
     void endElement(const char *name);
     void endDocument();
+    void build_meshes();
     void characters(const XML_Char *s, int len);
 
     static void XMLCALL startElement(void *userData, const char *name, const char **atts)
@@ -125,6 +210,16 @@ struct AMFParserContext
         std::vector<Instance>   instances;
     };
 
+    // Volume parsed, whose mesh is built and repaired by build_meshes() once the whole file is read.
+    struct Volume {
+        Volume(ModelVolume *volume, size_t object_idx) : volume(volume), object_idx(object_idx) {}
+        ModelVolume            *volume;
+        // Index into m_objects_vertices.
+        size_t                  object_idx;
+        // Triplets of indices into m_objects_vertices[object_idx].
+        std::vector<int>        facets;
+    };
+
     // Current Expat XML parser instance.
     XML_Parser               m_parser;
     // Model to receive objects extracted from an AMF file.
@@ -135,12 +230,12 @@ struct AMFParserContext
     ModelObject             *m_object;
     // Map from obect name to object idx & instances.
     std::map<std::string, Object> m_object_instances_map;
-    // Vertices parsed for the current m_object.
-    std::vector<float>       m_object_vertices;
+    // Vertices parsed for each amf/object, the last one belongs to the current m_object.
+    std::vector<std::vector<float>> m_objects_vertices;
     // Current volume allocated for an amf/object/mesh/volume subtree.
     ModelVolume             *m_volume;
-    // Faces collected for the current m_volume.
-    std::vector<int>         m_volume_facets;
+    // All the volumes parsed, the last one is the current m_volume.
+    std::vector<Volume>      m_volumes;
     // Current material allocated for an amf/metadata subtree.
     ModelMaterial           *m_material;
     // Current instance allocated for an amf/constellation/instance subtree.
@@ -175,7 +270,7 @@ void AMFParserContext::startElement(const char *name, const char **atts)
             if (object_id == nullptr)
                 this->stop();
             else {
-				assert(m_object_vertices.empty());
+                m_objects_vertices.emplace_back();
                 m_object = m_model.add_object();
                 m_object_instances_map[object_id].idx = int(m_model.objects.size())-1;
                 node_type_new = NODE_TYPE_OBJECT;
@@ -216,6 +311,7 @@ void AMFParserContext::startElement(const char *name, const char **atts)
 			else if (strcmp(name, "volume") == 0) {
 				assert(! m_volume);
 				m_volume = m_object->add_volume(TriangleMesh());
+				m_volumes.emplace_back(m_volume, m_objects_vertices.size() - 1);
 				node_type_new = NODE_TYPE_VOLUME;
 			}
         } else if (m_path[2] == NODE_TYPE_INSTANCE) {
@@ -294,6 +390,7 @@ void AMFParserContext::characters(const XML_Char *s, int len)
                 case NODE_TYPE_VERTEX3: m_value[2].append(s, len); break;
                 default: break;
             }
+            break;
         case 7:
             switch (m_path.back()) {
                 case NODE_TYPE_COORDINATE_X: m_value[0].append(s, len); break;
@@ -301,6 +398,7 @@ void AMFParserContext::characters(const XML_Char *s, int len)
                 case NODE_TYPE_COORDINATE_Z: m_value[2].append(s, len); break;
                 default: break;
             }
+            break;
         default:
             break;
         }
@@ -314,76 +412,73 @@ void AMFParserContext::endElement(const char *name)
     // Constellation transformation:
     case NODE_TYPE_DELTAX:
         assert(m_instance);
-        m_instance->deltax = float(atof(m_value[0].c_str()));
+        m_instance->deltax = float(parse_double(m_value[0].c_str()));
         m_instance->deltax_set = true;
         m_value[0].clear();
         break;
     case NODE_TYPE_DELTAY:
         assert(m_instance);
-        m_instance->deltay = float(atof(m_value[0].c_str()));
+        m_instance->deltay = float(parse_double(m_value[0].c_str()));
         m_instance->deltay_set = true;
         m_value[0].clear();
         break;
     case NODE_TYPE_RZ:
         assert(m_instance);
-        m_instance->rz = float(atof(m_value[0].c_str()));
+        m_instance->rz = float(parse_double(m_value[0].c_str()));
         m_instance->rz_set = true;
         m_value[0].clear();
         break;
     case NODE_TYPE_SCALE:
         assert(m_instance);
-        m_instance->scale = float(atof(m_value[0].c_str()));
+        m_instance->scale = float(parse_double(m_value[0].c_str()));
         m_instance->scale_set = true;
         m_value[0].clear();
         break;
 
     // Object vertices:
     case NODE_TYPE_VERTEX:
+    {
         assert(m_object);
         // Parse the vertex data
-        m_object_vertices.emplace_back(atof(m_value[0].c_str()));
-        m_object_vertices.emplace_back(atof(m_value[1].c_str()));
-        m_object_vertices.emplace_back(atof(m_value[2].c_str()));
+        std::vector<float> &vertices = m_objects_vertices.back();
+        vertices.emplace_back(float(parse_double(m_value[0].c_str())));
+        vertices.emplace_back(float(parse_double(m_value[1].c_str())));
+        vertices.emplace_back(float(parse_double(m_value[2].c_str())));
         m_value[0].clear();
         m_value[1].clear();
         m_value[2].clear();
         break;
+    }
 
     // Faces of the current volume:
     case NODE_TYPE_TRIANGLE:
+    {
         assert(m_object && m_volume);
-        m_volume_facets.push_back(atoi(m_value[0].c_str()));
-        m_volume_facets.push_back(atoi(m_value[1].c_str()));
-        m_volume_facets.push_back(atoi(m_value[2].c_str()));
+        // The vertices of an object precede its volumes, therefore the indices are validated right away.
+        int num_vertices = int(m_objects_vertices.back().size() / 3);
+        std::vector<int> &facets = m_volumes.back().facets;
+        for (size_t i = 0; i < 3; ++ i) {
+            int idx = parse_index(m_value[i].c_str());
+            if (idx < 0 || idx >= num_vertices) {
+                printf("AMF parser: Invalid vertex index %s\n", m_value[i].c_str());
+                this->stop();
+                break;
+            }
+            facets.push_back(idx);
+        }
         m_value[0].clear();
         m_value[1].clear();
         m_value[2].clear();
         break;
+    }
 
-    // Closing the current volume. Create an STL from m_volume_facets pointing to m_object_vertices.
     case NODE_TYPE_VOLUME:
-    {
 		assert(m_object && m_volume);
-        stl_file &stl = m_volume->mesh.stl;
-        stl.stats.type = inmemory;
-        stl.stats.number_of_facets = int(m_volume_facets.size() / 3);
-        stl.stats.original_num_facets = stl.stats.number_of_facets;
-        stl_allocate(&stl);
-        for (size_t i = 0; i < m_volume_facets.size();) {
-            stl_facet &facet = stl.facet_start[i/3];
-            for (unsigned int v = 0; v < 3; ++ v)
-                memcpy(&facet.vertex[v].x, &m_object_vertices[m_volume_facets[i ++] * 3], 3 * sizeof(float));
-        }
-        stl_get_size(&stl);
-        m_volume->mesh.repair();
-        m_volume_facets.clear();
         m_volume = nullptr;
         break;
-    }
 
     case NODE_TYPE_OBJECT:
         assert(m_object);
-        m_object_vertices.clear();
         m_object = nullptr;
         break;
 
@@ -450,8 +545,42 @@ void AMFParserContext::endElement(const char *name)
     m_path.pop_back();
 }
 
+// Create the meshes of the volumes from the facets pointing to the vertices of their objects.
+// The expat parser is sequential, but the meshes are built and repaired in parallel.
+void AMFParserContext::build_meshes()
+{
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, m_volumes.size(), 1),
+        [this](const tbb::blocked_range<size_t> &range) {
+            for (size_t i_volume = range.begin(); i_volume < range.end(); ++ i_volume) {
+                Volume                   &volume   = m_volumes[i_volume];
+                const std::vector<float> &vertices = m_objects_vertices[volume.object_idx];
+                TriangleMesh mesh;
+                stl_file &stl = mesh.stl;
+                stl.stats.type = inmemory;
+                stl.stats.number_of_facets = int(volume.facets.size() / 3);
+                stl.stats.original_num_facets = stl.stats.number_of_facets;
+                stl_allocate(&stl);
+                for (size_t i = 0; i < volume.facets.size();) {
+                    stl_facet &facet = stl.facet_start[i/3];
+                    for (unsigned int v = 0; v < 3; ++ v)
+                        memcpy(&facet.vertex[v].x, &vertices[volume.facets[i ++] * 3], 3 * sizeof(float));
+                }
+                stl_get_size(&stl);
+                mesh.repair();
+                volume.volume->set_mesh(mesh);
+                volume.facets.clear();
+                volume.facets.shrink_to_fit();
+            }
+        });
+    m_volumes.clear();
+    m_objects_vertices.clear();
+}
+
 void AMFParserContext::endDocument()
 {
+    this->build_meshes();
+
     for (const auto &object : m_object_instances_map) {
         if (object.second.idx == -1) {
             printf("Undefined object %s referenced in constellation\n", object.first.c_str());
@@ -468,7 +597,169 @@ void AMFParserContext::endDocument()
     }
 }
 
+// Minimal reader and writer of zip archives holding a single deflated AMF file, as written by the
+// other AMF producers. Multi disk and zip64 archives are not supported.
+static const uint32_t ZIP_LOCAL_HEADER_SIGNATURE     = 0x04034b50;
+static const uint32_t ZIP_CENTRAL_HEADER_SIGNATURE   = 0x02014b50;
+static const uint32_t ZIP_END_OF_DIRECTORY_SIGNATURE = 0x06054b50;
+static const size_t   ZIP_LOCAL_HEADER_SIZE          = 30;
+static const size_t   ZIP_CENTRAL_HEADER_SIZE        = 46;
+static const size_t   ZIP_END_OF_DIRECTORY_SIZE      = 22;
+static const uint16_t ZIP_METHOD_STORED              = 0;
+static const uint16_t ZIP_METHOD_DEFLATED            = 8;
+
+static inline uint16_t zip_get_u16(const unsigned char *p) { return uint16_t(p[0] | (p[1] << 8)); }
+static inline uint32_t zip_get_u32(const unsigned char *p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24); }
+static inline void     zip_put_u16(std::string &out, uint16_t v) { out += char(v & 0xff); out += char(v >> 8); }
+static inline void     zip_put_u32(std::string &out, uint32_t v) { zip_put_u16(out, uint16_t(v & 0xffff)); zip_put_u16(out, uint16_t(v >> 16)); }
+
+struct ZipEntry
+{
+    ZipEntry() : method(0), crc32(0), compressed_size(0), uncompressed_size(0), data_offset(0) {}
+    uint16_t method;
+    uint32_t crc32;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    long     data_offset;
+};
+
+// Locate the first *.amf file of a zip archive, or its first file if there is no *.amf file.
+static bool zip_find_amf_entry(FILE *file, ZipEntry &entry)
+{
+    if (::fseek(file, 0, SEEK_END) != 0)
+        return false;
+    long file_size = ::ftell(file);
+    // The end of central directory record is followed by a comment of up to 64kB.
+    long tail_size = std::min<long>(file_size, ZIP_END_OF_DIRECTORY_SIZE + 0xffff);
+    if (tail_size < long(ZIP_END_OF_DIRECTORY_SIZE))
+        return false;
+    std::vector<unsigned char> tail(tail_size);
+    if (::fseek(file, file_size - tail_size, SEEK_SET) != 0 || ::fread(tail.data(), 1, tail_size, file) != size_t(tail_size))
+        return false;
+    const unsigned char *eocd = nullptr;
+    for (long i = tail_size - long(ZIP_END_OF_DIRECTORY_SIZE); i >= 0 && eocd == nullptr; -- i)
+        if (zip_get_u32(tail.data() + i) == ZIP_END_OF_DIRECTORY_SIGNATURE)
+            eocd = tail.data() + i;
+    if (eocd == nullptr)
+        return false;
+    uint16_t num_entries    = zip_get_u16(eocd + 10);
+    uint32_t directory_size = zip_get_u32(eocd + 12);
+    uint32_t directory_pos  = zip_get_u32(eocd + 16);
+    std::vector<unsigned char> directory(directory_size);
+    if (long(directory_pos) + long(directory_size) > file_size || 
+        ::fseek(file, directory_pos, SEEK_SET) != 0 || ::fread(directory.data(), 1, directory_size, file) != directory_size)
+        return false;
+    const unsigned char *found = nullptr;
+    for (size_t i = 0, pos = 0; i < num_entries && pos + ZIP_CENTRAL_HEADER_SIZE <= directory.size(); ++ i) {
+        const unsigned char *header = directory.data() + pos;
+        if (zip_get_u32(header) != ZIP_CENTRAL_HEADER_SIGNATURE)
+            return false;
+        size_t name_len = zip_get_u16(header + 28);
+        if (pos + ZIP_CENTRAL_HEADER_SIZE + name_len > directory.size())
+            return false;
+        std::string name((const char*)header + ZIP_CENTRAL_HEADER_SIZE, name_len);
+        if (! name.empty() && name.back() != '/') {
+            bool amf = boost::iends_with(name, ".amf");
+            if (found == nullptr || amf)
+                found = header;
+            if (amf)
+                break;
+        }
+        pos += ZIP_CENTRAL_HEADER_SIZE + name_len + zip_get_u16(header + 30) + zip_get_u16(header + 32);
+    }
+    if (found == nullptr)
+        return false;
+    entry.method            = zip_get_u16(found + 10);
+    entry.crc32             = zip_get_u32(found + 16);
+    entry.compressed_size   = zip_get_u32(found + 20);
+    entry.uncompressed_size = zip_get_u32(found + 24);
+    // The local header may differ from the central one in the length of its extra field.
+    unsigned char local[ZIP_LOCAL_HEADER_SIZE];
+    long local_pos = long(zip_get_u32(found + 42));
+    if (::fseek(file, local_pos, SEEK_SET) != 0 || ::fread(local, 1, ZIP_LOCAL_HEADER_SIZE, file) != ZIP_LOCAL_HEADER_SIZE ||
+        zip_get_u32(local) != ZIP_LOCAL_HEADER_SIGNATURE)
+        return false;
+    entry.data_offset = local_pos + long(ZIP_LOCAL_HEADER_SIZE) + zip_get_u16(local + 26) + zip_get_u16(local + 28);
+    return entry.data_offset + long(entry.compressed_size) <= file_size;
+}
+
+static bool amf_parse_chunk(XML_Parser parser, const char *data, size_t len, bool done)
+{
+    if (XML_Parse(parser, data, int(len), done) == XML_STATUS_ERROR) {
+        printf("AMF parser: Parse error at line %ul:\n%s\n",
+              XML_GetCurrentLineNumber(parser),
+              XML_ErrorString(XML_GetErrorCode(parser)));
+        return false;
+    }
+    return true;
+}
+
+// Feed the XML parser with a zip archive entry, inflated on the fly.
+static bool amf_parse_zip_entry(XML_Parser parser, FILE *file, const ZipEntry &entry)
+{
+    if (entry.method != ZIP_METHOD_STORED && entry.method != ZIP_METHOD_DEFLATED) {
+        printf("AMF parser: Unsupported zip compression method %d\n", int(entry.method));
+        return false;
+    }
+    if (::fseek(file, entry.data_offset, SEEK_SET) != 0)
+        return false;
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (entry.method == ZIP_METHOD_DEFLATED && inflateInit2(&stream, - MAX_WBITS) != Z_OK)
+        return false;
+    const size_t buffer_size = 65536;
+    std::vector<char> buffer_in(buffer_size);
+    std::vector<char> buffer_out(buffer_size);
+    uint32_t remaining = entry.compressed_size;
+    uLong    crc       = crc32(0, nullptr, 0);
+    bool     result    = true;
+    bool     end       = false;
+    while (result && ! end) {
+        size_t len = ::fread(buffer_in.data(), 1, std::min<size_t>(remaining, buffer_size), file);
+        if (len == 0 && remaining > 0) {
+            printf("AMF parser: Read error\n");
+            result = false;
+            break;
+        }
+        remaining -= uint32_t(len);
+        if (entry.method == ZIP_METHOD_STORED) {
+            crc = crc32(crc, (const Bytef*)buffer_in.data(), uInt(len));
+            result = amf_parse_chunk(parser, buffer_in.data(), len, false);
+            end = remaining == 0;
+            continue;
+        }
+        stream.next_in  = (Bytef*)buffer_in.data();
+        stream.avail_in = uInt(len);
+        do {
+            stream.next_out  = (Bytef*)buffer_out.data();
+            stream.avail_out = uInt(buffer_size);
+            int ret = inflate(&stream, Z_NO_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                printf("AMF parser: Corrupted zip archive\n");
+                result = false;
+                break;
+            }
+            size_t out_len = buffer_size - stream.avail_out;
+            crc = crc32(crc, (const Bytef*)buffer_out.data(), uInt(out_len));
+            result = amf_parse_chunk(parser, buffer_out.data(), out_len, false);
+            end = ret == Z_STREAM_END;
+        } while (result && ! end && stream.avail_out == 0);
+        if (result && ! end && remaining == 0) {
+            printf("AMF parser: Truncated zip archive\n");
+            result = false;
+        }
+    }
+    if (entry.method == ZIP_METHOD_DEFLATED)
+        inflateEnd(&stream);
+    if (result && crc != entry.crc32) {
+        printf("AMF parser: Zip archive checksum mismatch\n");
+        result = false;
+    }
+    return result && amf_parse_chunk(parser, nullptr, 0, true);
+}
+
 // Load an AMF file into a provided model.
+// The AMF file may be a plain XML file or a zip archive containing it.
 bool load_amf(const char *path, Model *model)
 {
     XML_Parser parser = XML_ParserCreate(nullptr); // encoding
@@ -477,8 +768,9 @@ bool load_amf(const char *path, Model *model)
         return false;
     }
 
-    FILE *pFile = ::fopen(path, "rt");
+    FILE *pFile = ::fopen(path, "rb");
     if (pFile == nullptr) {
+        XML_ParserFree(parser);
         printf("Cannot open file %s\n", path);
         return false;
     }
@@ -488,24 +780,31 @@ bool load_amf(const char *path, Model *model)
     XML_SetElementHandler(parser, AMFParserContext::startElement, AMFParserContext::endElement);
     XML_SetCharacterDataHandler(parser, AMFParserContext::characters);
 
-    char buff[8192];
+    unsigned char magic[4];
+    bool zipped = ::fread(magic, 1, 4, pFile) == 4 && zip_get_u32(magic) == ZIP_LOCAL_HEADER_SIGNATURE;
     bool result = false;
-    for (;;) {
-        int len = (int)fread(buff, 1, 8192, pFile);
-        if (ferror(pFile)) {
-            printf("AMF parser: Read error\n");
-            break;
-        }
-        int done = feof(pFile);
-        if (XML_Parse(parser, buff, len, done) == XML_STATUS_ERROR) {
-            printf("AMF parser: Parse error at line %ul:\n%s\n",
-                  XML_GetCurrentLineNumber(parser),
-                  XML_ErrorString(XML_GetErrorCode(parser)));
-            break;
-        }
-        if (done) {
-            result = true;
-            break;
+    if (zipped) {
+        ZipEntry entry;
+        if (zip_find_amf_entry(pFile, entry))
+            result = amf_parse_zip_entry(parser, pFile, entry);
+        else
+            printf("AMF parser: Invalid zip archive %s\n", path);
+    } else {
+        ::rewind(pFile);
+        std::vector<char> buff(65536);
+        for (;;) {
+            size_t len = ::fread(buff.data(), 1, buff.size(), pFile);
+            if (ferror(pFile)) {
+                printf("AMF parser: Read error\n");
+                break;
+            }
+            bool done = feof(pFile) != 0;
+            if (! amf_parse_chunk(parser, buff.data(), len, done))
+                break;
+            if (done) {
+                result = true;
+                break;
+            }
         }
     }
 
@@ -517,90 +816,257 @@ bool load_amf(const char *path, Model *model)
     return result;
 }
 
-bool store_amf(const char *path, Model *model)
+// Sink of store_amf(), writing either the plain XML or a zip archive with a single deflated entry.
+class AMFWriter
+{
+public:
+    // An empty entry_name writes a plain XML file.
+    AMFWriter(FILE *file, const std::string &entry_name) :
+        m_file(file), m_entry_name(entry_name), m_buffer(65536), m_buffer_len(0),
+        m_crc32(crc32(0, nullptr, 0)), m_uncompressed_size(0), m_compressed_size(0), m_error(false)
+    {
+        memset(&m_stream, 0, sizeof(m_stream));
+        time_t     now = time(nullptr);
+        struct tm *t   = localtime(&now);
+        m_dos_time = uint16_t((t->tm_hour << 11) | (t->tm_min << 5) | (t->tm_sec / 2));
+        m_dos_date = uint16_t(((std::max(t->tm_year, 80) - 80) << 9) | ((t->tm_mon + 1) << 5) | t->tm_mday);
+        if (this->zipped()) {
+            // The CRC and sizes of the local header are filled in by close().
+            std::string header = this->zip_header(ZIP_LOCAL_HEADER_SIGNATURE);
+            m_error = deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, - MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK ||
+                ::fwrite(header.data(), 1, header.size(), m_file) != header.size();
+            m_compressed_output.assign(m_buffer.size(), 0);
+        }
+    }
+    ~AMFWriter() { if (this->zipped()) deflateEnd(&m_stream); }
+
+    void printf(const char *format, ...)
+    {
+        for (;;) {
+            va_list args;
+            va_start(args, format);
+            size_t space = m_buffer.size() - m_buffer_len;
+            int    len   = vsnprintf(m_buffer.data() + m_buffer_len, space, format, args);
+            va_end(args);
+            if (len < 0) {
+                m_error = true;
+                return;
+            }
+            if (size_t(len) < space) {
+                m_buffer_len += len;
+                return;
+            }
+            // Did not fit, flush and try again with a buffer large enough.
+            this->flush(false);
+            if (size_t(len) >= m_buffer.size())
+                m_buffer.resize(len + 1);
+        }
+    }
+
+    void write(const char *data, size_t len)
+    {
+        if (m_buffer_len + len > m_buffer.size())
+            this->flush(false);
+        if (len > m_buffer.size())
+            m_buffer.resize(len);
+        memcpy(m_buffer.data() + m_buffer_len, data, len);
+        m_buffer_len += len;
+    }
+
+    // Returns false on an I/O error.
+    bool close()
+    {
+        this->flush(true);
+        if (this->zipped() && ! m_error) {
+            if (m_uncompressed_size > 0xffffffffu || m_compressed_size > 0xffffffffu) {
+                ::printf("AMF writer: Zip archives larger than 4GB are not supported\n");
+                return false;
+            }
+            uint32_t    directory_pos = uint32_t(ZIP_LOCAL_HEADER_SIZE + m_entry_name.size() + m_compressed_size);
+            std::string directory     = this->zip_header(ZIP_CENTRAL_HEADER_SIGNATURE);
+            std::string end;
+            zip_put_u32(end, ZIP_END_OF_DIRECTORY_SIGNATURE);
+            zip_put_u16(end, 0);                                    // number of this disk
+            zip_put_u16(end, 0);                                    // disk with the central directory
+            zip_put_u16(end, 1);                                    // entries on this disk
+            zip_put_u16(end, 1);                                    // entries in total
+            zip_put_u32(end, uint32_t(directory.size()));
+            zip_put_u32(end, directory_pos);
+            zip_put_u16(end, 0);                                    // comment length
+            std::string local = this->zip_header(ZIP_LOCAL_HEADER_SIGNATURE);
+            m_error = ::fwrite(directory.data(), 1, directory.size(), m_file) != directory.size() ||
+                      ::fwrite(end.data(), 1, end.size(), m_file) != end.size() ||
+                      ::fseek(m_file, 0, SEEK_SET) != 0 ||
+                      ::fwrite(local.data(), 1, local.size(), m_file) != local.size();
+        }
+        return ! m_error;
+    }
+
+private:
+    bool zipped() const { return ! m_entry_name.empty(); }
+
+    void flush(bool finish)
+    {
+        if (m_error)
+            return;
+        if (! this->zipped()) {
+            m_error = ::fwrite(m_buffer.data(), 1, m_buffer_len, m_file) != m_buffer_len;
+            m_buffer_len = 0;
+            return;
+        }
+        m_crc32 = crc32(m_crc32, (const Bytef*)m_buffer.data(), uInt(m_buffer_len));
+        m_uncompressed_size += m_buffer_len;
+        m_stream.next_in  = (Bytef*)m_buffer.data();
+        m_stream.avail_in = uInt(m_buffer_len);
+        int ret;
+        do {
+            m_stream.next_out  = (Bytef*)m_compressed_output.data();
+            m_stream.avail_out = uInt(m_compressed_output.size());
+            ret = deflate(&m_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+            size_t len = m_compressed_output.size() - m_stream.avail_out;
+            m_compressed_size += len;
+            if (ret == Z_STREAM_ERROR || ::fwrite(m_compressed_output.data(), 1, len, m_file) != len) {
+                m_error = true;
+                break;
+            }
+        } while (m_stream.avail_out == 0 || (finish && ret != Z_STREAM_END));
+        m_buffer_len = 0;
+    }
+
+    // Local or central directory header of the single entry, the sizes are valid once all data is written.
+    std::string zip_header(uint32_t signature) const
+    {
+        bool central = signature == ZIP_CENTRAL_HEADER_SIGNATURE;
+        std::string out;
+        zip_put_u32(out, signature);
+        if (central)
+            zip_put_u16(out, 20);                                   // version made by
+        zip_put_u16(out, 20);                                       // version needed to extract
+        zip_put_u16(out, 0);                                        // flags
+        zip_put_u16(out, ZIP_METHOD_DEFLATED);
+        zip_put_u16(out, m_dos_time);
+        zip_put_u16(out, m_dos_date);
+        zip_put_u32(out, uint32_t(m_crc32));
+        zip_put_u32(out, uint32_t(m_compressed_size));
+        zip_put_u32(out, uint32_t(m_uncompressed_size));
+        zip_put_u16(out, uint16_t(m_entry_name.size()));
+        zip_put_u16(out, 0);                                        // extra field length
+        if (central) {
+            zip_put_u16(out, 0);                                    // comment length
+            zip_put_u16(out, 0);                                    // disk number
+            zip_put_u16(out, 0);                                    // internal attributes
+            zip_put_u32(out, 0);                                    // external attributes
+            zip_put_u32(out, 0);                                    // offset of the local header
+        }
+        out += m_entry_name;
+        return out;
+    }
+
+    FILE               *m_file;
+    std::string         m_entry_name;
+    std::vector<char>   m_buffer;
+    size_t              m_buffer_len;
+    std::vector<char>   m_compressed_output;
+    z_stream            m_stream;
+    uLong               m_crc32;
+    uint64_t            m_uncompressed_size;
+    uint64_t            m_compressed_size;
+    // Modification time of the entry in the MS-DOS format.
+    uint16_t            m_dos_time;
+    uint16_t            m_dos_date;
+    bool                m_error;
+};
+
+bool store_amf(const char *path, Model *model, bool compress)
 {
     FILE *file = ::fopen(path, "wb");
     if (file == nullptr)
         return false;
 
-    fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
-    fprintf(file, "<amf unit=\"millimeter\">\n");
-    fprintf(file, "<metadata type=\"cad\">Slic3r %s</metadata>\n", SLIC3R_VERSION);
+    // The archive entry is named after the archive, without its .zip suffix if it is named *.zip.amf
+    std::string entry_name;
+    if (compress) {
+        entry_name = boost::filesystem::path(path).filename().string();
+        if (entry_name.size() > 8 && boost::iends_with(entry_name, ".zip.amf"))
+            entry_name.erase(entry_name.size() - 8, 4);
+    }
+    AMFWriter out(file, entry_name);
+
+    out.printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    out.printf("<amf unit=\"millimeter\">\n");
+    out.printf("<metadata type=\"cad\">Slic3r %s</metadata>\n", SLIC3R_VERSION);
     for (const auto &material : model->materials) {
         if (material.first.empty())
             continue;
         // note that material-id must never be 0 since it's reserved by the AMF spec
-        fprintf(file, "  <material id=\"%s\">\n", material.first.c_str());
+        out.printf("  <material id=\"%s\">\n", material.first.c_str());
         for (const auto &attr : material.second->attributes)
-             fprintf(file, "    <metadata type=\"%s\">%s</metadata>\n", attr.first.c_str(), attr.second.c_str());
+             out.printf("    <metadata type=\"%s\">%s</metadata>\n", attr.first.c_str(), attr.second.c_str());
         for (const std::string &key : material.second->config.keys())
-             fprintf(file, "    <metadata type=\"slic3r.%s\">%s</metadata>\n", key.c_str(), material.second->config.serialize(key).c_str());
-        fprintf(file, "  </material>\n");
+             out.printf("    <metadata type=\"slic3r.%s\">%s</metadata>\n", key.c_str(), material.second->config.serialize(key).c_str());
+        out.printf("  </material>\n");
     }
     std::string instances;
     for (size_t object_id = 0; object_id < model->objects.size(); ++ object_id) {
         ModelObject *object = model->objects[object_id];
-        fprintf(file, "  <object id=\"" PRINTF_ZU "\">\n", object_id);
+        out.printf("  <object id=\"" PRINTF_ZU "\">\n", object_id);
         for (const std::string &key : object->config.keys())
-             fprintf(file, "    <metadata type=\"slic3r.%s\">%s</metadata>\n", key.c_str(), object->config.serialize(key).c_str());
+             out.printf("    <metadata type=\"slic3r.%s\">%s</metadata>\n", key.c_str(), object->config.serialize(key).c_str());
         if (! object->name.empty())
-            fprintf(file, "    <metadata type=\"name\">%s</metadata>\n", object->name.c_str());
+            out.printf("    <metadata type=\"name\">%s</metadata>\n", object->name.c_str());
         std::vector<double> layer_height_profile = object->layer_height_profile_valid ? object->layer_height_profile : std::vector<double>();
         if (layer_height_profile.size() >= 4 && (layer_height_profile.size() % 2) == 0) {
             // Store the layer height profile as a single semicolon separated list.
-            fprintf(file, "    <metadata type=\"slic3r.layer_height_profile\">");
-            fprintf(file, "%f", layer_height_profile.front());
+            out.printf("    <metadata type=\"slic3r.layer_height_profile\">");
+            out.printf("%f", layer_height_profile.front());
             for (size_t i = 1; i < layer_height_profile.size(); ++ i)
-                fprintf(file, ";%f", layer_height_profile[i]);
-            fprintf(file, "\n    </metadata>\n");
+                out.printf(";%f", layer_height_profile[i]);
+            out.printf("\n    </metadata>\n");
         }
         //FIXME Store the layer height ranges (ModelObject::layer_height_ranges)
-        fprintf(file, "    <mesh>\n");
-        fprintf(file, "      <vertices>\n");
+        out.printf("    <mesh>\n");
+        out.printf("      <vertices>\n");
         std::vector<int> vertices_offsets;
         int              num_vertices = 0;
         for (ModelVolume *volume : object->volumes) {
             vertices_offsets.push_back(num_vertices);
-            if (! volume->mesh.repaired) 
+            if (! volume->repaired) 
                 CONFESS("store_amf() requires repair()");
-            auto &stl = volume->mesh.stl;
-            if (stl.v_shared == nullptr)
-                stl_generate_shared_vertices(&stl);
-            for (size_t i = 0; i < stl.stats.shared_vertices; ++ i) {
-                fprintf(file, "         <vertex>\n");
-                fprintf(file, "           <coordinates>\n");
-                fprintf(file, "             <x>%f</x>\n", stl.v_shared[i].x);
-                fprintf(file, "             <y>%f</y>\n", stl.v_shared[i].y);
-                fprintf(file, "             <z>%f</z>\n", stl.v_shared[i].z);
-                fprintf(file, "           </coordinates>\n");
-                fprintf(file, "         </vertex>\n");
+            for (const stl_vertex &v : volume->its.vertices) {
+                out.printf("         <vertex>\n");
+                out.printf("           <coordinates>\n");
+                out.printf("             <x>%f</x>\n", v.x);
+                out.printf("             <y>%f</y>\n", v.y);
+                out.printf("             <z>%f</z>\n", v.z);
+                out.printf("           </coordinates>\n");
+                out.printf("         </vertex>\n");
             }
-            num_vertices += stl.stats.shared_vertices;
+            num_vertices += int(volume->its.vertices.size());
         }
-        fprintf(file, "      </vertices>\n");
+        out.printf("      </vertices>\n");
         for (size_t i_volume = 0; i_volume < object->volumes.size(); ++ i_volume) {
             ModelVolume *volume = object->volumes[i_volume];
             int vertices_offset = vertices_offsets[i_volume];
             if (volume->material_id().empty())
-                fprintf(file, "      <volume>\n");
+                out.printf("      <volume>\n");
             else
-                fprintf(file, "      <volume materialid=\"%s\">\n", volume->material_id().c_str());
+                out.printf("      <volume materialid=\"%s\">\n", volume->material_id().c_str());
             for (const std::string &key : volume->config.keys())
-                fprintf(file, "        <metadata type=\"slic3r.%s\">%s</metadata>\n", key.c_str(), volume->config.serialize(key).c_str());
+                out.printf("        <metadata type=\"slic3r.%s\">%s</metadata>\n", key.c_str(), volume->config.serialize(key).c_str());
             if (! volume->name.empty())
-                fprintf(file, "        <metadata type=\"name\">%s</metadata>\n", volume->name.c_str());
+                out.printf("        <metadata type=\"name\">%s</metadata>\n", volume->name.c_str());
             if (volume->modifier)
-                fprintf(file, "        <metadata type=\"slic3r.modifier\">1</metadata>\n");
-            for (int i = 0; i < volume->mesh.stl.stats.number_of_facets; ++ i) {
-                fprintf(file, "        <triangle>\n");
+                out.printf("        <metadata type=\"slic3r.modifier\">1</metadata>\n");
+            for (const v_indices_struct &facet : volume->its.indices) {
+                out.printf("        <triangle>\n");
                 for (int j = 0; j < 3; ++ j)
-                    fprintf(file, "          <v%d>%d</v%d>\n", j+1, volume->mesh.stl.v_indices[i].vertex[j] + vertices_offset, j+1);
-                fprintf(file, "        </triangle>\n");
+                    out.printf("          <v%d>%d</v%d>\n", j+1, facet.vertex[j] + vertices_offset, j+1);
+                out.printf("        </triangle>\n");
             }
-            fprintf(file, "      </volume>\n");
+            out.printf("      </volume>\n");
         }
-        fprintf(file, "    </mesh>\n");
-        fprintf(file, "  </object>\n");
+        out.printf("    </mesh>\n");
+        out.printf("  </object>\n");
         if (! object->instances.empty()) {
             for (ModelInstance *instance : object->instances) {
                 char buf[512];
@@ -622,13 +1088,14 @@ bool store_amf(const char *path, Model *model)
         }
     }
     if (! instances.empty()) {
-        fprintf(file, "  <constellation id=\"1\">\n");
-        fwrite(instances.data(), instances.size(), 1, file);
-        fprintf(file, "  </constellation>\n");
+        out.printf("  <constellation id=\"1\">\n");
+        out.write(instances.data(), instances.size());
+        out.printf("  </constellation>\n");
     }
-    fprintf(file, "</amf>\n");
+    out.printf("</amf>\n");
+    bool result = out.close();
     fclose(file);
-    return true;
+    return result;
 }
 
 }; // namespace Slic3r
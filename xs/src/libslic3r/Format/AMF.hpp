@@ -8,7 +8,8 @@ class Model;
 // Load an AMF file into a provided model.
 extern bool load_amf(const char *path, Model *model);
 
-extern bool store_amf(const char *path, Model *model);
+// Store a model into an AMF file. If compress is set, the AMF file is deflated into a zip archive.
+extern bool store_amf(const char *path, Model *model, bool compress = false);
 
 }; // namespace Slic3r
 
@@ -0,0 +1,438 @@
+#include "../libslic3r.h"
+#include "../Model.hpp"
+#include "../TriangleMesh.hpp"
+
+#include "ModelCache.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace Slic3r {
+
+// The version shall be increased whenever the layout of the cache changes.
+static const uint32_t MODEL_CACHE_VERSION     = 2;
+static const char     MODEL_CACHE_MAGIC[8]    = { 'S', 'L', '3', 'R', 'M', 'D', 'L', 0 };
+static const uint32_t MODEL_CACHE_BYTE_ORDER  = 0x01020304;
+
+struct ModelCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    // MODEL_CACHE_BYTE_ORDER in the byte order of the writer.
+    uint32_t byte_order;
+    // Sizes of the admesh structures stored verbatim.
+    uint32_t sizeof_stats;
+    uint32_t sizeof_vertex;
+    uint32_t sizeof_indices;
+    uint32_t reserved;
+    uint64_t source_hash;
+    // The configuration values are stored serialized, their meaning may change between the Slic3r versions.
+    char     slic3r_version[32];
+
+    void init(uint64_t source_hash)
+    {
+        memset(this, 0, sizeof(*this));
+        memcpy(this->magic, MODEL_CACHE_MAGIC, sizeof(this->magic));
+        this->version          = MODEL_CACHE_VERSION;
+        this->byte_order       = MODEL_CACHE_BYTE_ORDER;
+        this->sizeof_stats     = uint32_t(sizeof(stl_stats));
+        this->sizeof_vertex    = uint32_t(sizeof(stl_vertex));
+        this->sizeof_indices   = uint32_t(sizeof(v_indices_struct));
+        this->source_hash      = source_hash;
+        strncpy(this->slic3r_version, SLIC3R_VERSION, sizeof(this->slic3r_version) - 1);
+    }
+};
+
+// 64bit hash of a block of data, processed in four independent lanes of 64bit words.
+static const uint64_t HASH_PRIME1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t HASH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t HASH_PRIME3 = 0x165667B19E3779F9ULL;
+
+static inline uint64_t hash_rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+static inline uint64_t hash_round(uint64_t acc, uint64_t input) { return hash_rotl(acc + input * HASH_PRIME2, 31) * HASH_PRIME1; }
+static inline uint64_t hash_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= HASH_PRIME2;
+    h ^= h >> 29;
+    h *= HASH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t hash_block(const unsigned char *data, size_t len, uint64_t seed)
+{
+    uint64_t lane[4] = { seed + HASH_PRIME1 + HASH_PRIME2, seed + HASH_PRIME2, seed, seed - HASH_PRIME1 };
+    size_t   i = 0;
+    for (; i + 32 <= len; i += 32)
+        for (int j = 0; j < 4; ++ j) {
+            uint64_t word;
+            memcpy(&word, data + i + 8 * j, 8);
+            lane[j] = hash_round(lane[j], word);
+        }
+    uint64_t h = hash_rotl(lane[0], 1) + hash_rotl(lane[1], 7) + hash_rotl(lane[2], 12) + hash_rotl(lane[3], 18);
+    for (; i < len; ++ i)
+        h = hash_round(h, data[i]);
+    return hash_avalanche(h ^ uint64_t(len));
+}
+
+bool model_file_hash(const char *path, uint64_t &hash)
+{
+    boost::system::error_code ec;
+    uintmax_t file_size = boost::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+    // The file is hashed in blocks of 1MB in parallel, then the hashes of the blocks are hashed.
+    const size_t          block_size = 1024 * 1024;
+    std::vector<uint64_t> block_hashes;
+    if (file_size > 0) {
+        boost::interprocess::mapped_region region;
+        try {
+            boost::interprocess::file_mapping mapping(path, boost::interprocess::read_only);
+            boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region);
+        } catch (const std::exception &ex) {
+            BOOST_LOG_TRIVIAL(error) << "model_file_hash: Couldn't open " << path << " for reading: " << ex.what();
+            return false;
+        }
+        const unsigned char *data = (const unsigned char*)region.get_address();
+        const size_t         size = region.get_size();
+        block_hashes.assign((size + block_size - 1) / block_size, 0);
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, block_hashes.size()),
+            [data, size, block_size, &block_hashes](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i < range.end(); ++ i)
+                    block_hashes[i] = hash_block(data + i * block_size, std::min(block_size, size - i * block_size), i);
+            });
+    }
+    std::string name = boost::filesystem::path(path).filename().string();
+    block_hashes.push_back(hash_block((const unsigned char*)name.data(), name.size(), 0));
+    hash = hash_block((const unsigned char*)block_hashes.data(), block_hashes.size() * sizeof(uint64_t), uint64_t(file_size));
+    return true;
+}
+
+class ModelCacheWriter
+{
+public:
+    ModelCacheWriter(FILE *file) : m_file(file), m_offset(0), m_error(false) {}
+
+    bool error() const { return m_error; }
+
+    void write(const void *data, size_t len)
+    {
+        if (! m_error && len > 0 && ::fwrite(data, 1, len, m_file) != len)
+            m_error = true;
+        m_offset += len;
+    }
+
+    template<typename T> void write_pod(const T &value) { this->write(&value, sizeof(T)); }
+
+    void write_string(const std::string &str)
+    {
+        this->write_pod(uint64_t(str.size()));
+        this->write(str.data(), str.size());
+    }
+
+    // The arrays are aligned to 8 bytes, so that they could be accessed in place in a memory mapped cache.
+    template<typename T> void write_array(const T *data, size_t count)
+    {
+        static const char zeros[8] = { 0 };
+        this->write_pod(uint64_t(count));
+        this->write(zeros, (8 - m_offset % 8) % 8);
+        this->write(data, count * sizeof(T));
+    }
+
+    void write_config(const DynamicPrintConfig &config)
+    {
+        t_config_option_keys keys = config.keys();
+        this->write_pod(uint64_t(keys.size()));
+        for (const std::string &key : keys) {
+            this->write_string(key);
+            this->write_string(config.serialize(key));
+        }
+    }
+
+    void write_mesh(const ModelVolume &volume)
+    {
+        this->write_pod(uint8_t(volume.repaired));
+        this->write_pod(volume.stats);
+        this->write_array(volume.its.indices.data(), volume.its.indices.size());
+        this->write_array(volume.its.vertices.data(), volume.its.vertices.size());
+    }
+
+private:
+    FILE   *m_file;
+    size_t  m_offset;
+    bool    m_error;
+};
+
+// Reads a cache from a memory mapped file. Any read past the end of the data flags an error.
+class ModelCacheReader
+{
+public:
+    ModelCacheReader(const char *begin, const char *end) : m_begin(begin), m_ptr(begin), m_end(end), m_error(false) {}
+
+    bool error() const { return m_error; }
+
+    const char* read(size_t len)
+    {
+        if (m_error || size_t(m_end - m_ptr) < len) {
+            m_error = true;
+            return nullptr;
+        }
+        const char *data = m_ptr;
+        m_ptr += len;
+        return data;
+    }
+
+    template<typename T> T read_pod()
+    {
+        T value;
+        const char *data = this->read(sizeof(T));
+        if (data == nullptr)
+            memset(&value, 0, sizeof(T));
+        else
+            memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    std::string read_string()
+    {
+        uint64_t    len  = this->read_pod<uint64_t>();
+        const char *data = this->read(size_t(len));
+        return (data == nullptr) ? std::string() : std::string(data, size_t(len));
+    }
+
+    // Returns a pointer into the mapped file, valid for the life time of the mapping.
+    template<typename T> const T* read_array(size_t &count)
+    {
+        count = size_t(this->read_pod<uint64_t>());
+        this->read((8 - (m_ptr - m_begin) % 8) % 8);
+        if (count > size_t(m_end - m_ptr) / sizeof(T)) {
+            m_error = true;
+            count   = 0;
+        }
+        return (const T*)this->read(count * sizeof(T));
+    }
+
+    void read_config(DynamicPrintConfig &config)
+    {
+        uint64_t num_keys = this->read_pod<uint64_t>();
+        for (uint64_t i = 0; i < num_keys && ! m_error; ++ i) {
+            std::string key   = this->read_string();
+            std::string value = this->read_string();
+            // An option unknown to this version of Slic3r is dropped, as by the other loaders.
+            if (print_config_def.options.find(key) != print_config_def.options.end())
+                config.set_deserialize(key, value);
+        }
+    }
+
+    bool read_mesh(ModelVolume &volume)
+    {
+        volume.repaired = this->read_pod<uint8_t>() != 0;
+        volume.stats    = this->read_pod<stl_stats>();
+        size_t num_indices, num_vertices;
+        const v_indices_struct *indices  = this->read_array<v_indices_struct>(num_indices);
+        const stl_vertex       *vertices = this->read_array<stl_vertex>(num_vertices);
+        if (m_error)
+            return false;
+        for (size_t i = 0; i < num_indices; ++ i)
+            for (int j = 0; j < 3; ++ j)
+                if (indices[i].vertex[j] < 0 || size_t(indices[i].vertex[j]) >= num_vertices)
+                    return false;
+        volume.its.indices.assign(indices, indices + num_indices);
+        volume.its.vertices.assign(vertices, vertices + num_vertices);
+        return true;
+    }
+
+private:
+    const char *m_begin;
+    const char *m_ptr;
+    const char *m_end;
+    bool        m_error;
+};
+
+bool store_model_cache(const char *path, Model *model, uint64_t source_hash)
+{
+    boost::filesystem::path path_tmp = boost::filesystem::path(path).parent_path() /
+        boost::filesystem::unique_path(boost::filesystem::path(path).filename().string() + ".%%%%-%%%%.tmp");
+    FILE *file = ::fopen(path_tmp.string().c_str(), "wb");
+    if (file == nullptr) {
+        BOOST_LOG_TRIVIAL(error) << "store_model_cache: Couldn't open " << path_tmp.string() << " for writing";
+        return false;
+    }
+
+    ModelCacheHeader header;
+    header.init(source_hash);
+    ModelCacheWriter writer(file);
+    writer.write_pod(header);
+
+    writer.write_pod(uint64_t(model->materials.size()));
+    for (const auto &material : model->materials) {
+        writer.write_string(material.first);
+        writer.write_pod(uint64_t(material.second->attributes.size()));
+        for (const auto &attr : material.second->attributes) {
+            writer.write_string(attr.first);
+            writer.write_string(attr.second);
+        }
+        writer.write_config(material.second->config);
+    }
+
+    writer.write_pod(uint64_t(model->objects.size()));
+    for (ModelObject *object : model->objects) {
+        writer.write_string(object->name);
+        writer.write_string(object->input_file);
+        writer.write_config(object->config);
+        writer.write_pod(uint64_t(object->layer_height_ranges.size()));
+        for (const auto &range : object->layer_height_ranges) {
+            writer.write_pod(range.first.first);
+            writer.write_pod(range.first.second);
+            writer.write_pod(range.second);
+        }
+        writer.write_array(object->layer_height_profile.data(), object->layer_height_profile.size());
+        writer.write_pod(uint8_t(object->layer_height_profile_valid));
+        writer.write_pod(object->origin_translation.x);
+        writer.write_pod(object->origin_translation.y);
+        writer.write_pod(object->origin_translation.z);
+        writer.write_pod(uint64_t(object->instances.size()));
+        for (const ModelInstance *instance : object->instances) {
+            writer.write_pod(instance->rotation);
+            writer.write_pod(instance->scaling_factor);
+            writer.write_pod(instance->offset.x);
+            writer.write_pod(instance->offset.y);
+        }
+        writer.write_pod(uint64_t(object->volumes.size()));
+        for (ModelVolume *volume : object->volumes) {
+            writer.write_string(volume->name);
+            writer.write_config(volume->config);
+            writer.write_pod(uint8_t(volume->modifier));
+            writer.write_string(volume->material_id());
+            writer.write_mesh(*volume);
+        }
+    }
+
+    bool result = ! writer.error();
+    result &= ::fclose(file) == 0;
+    boost::system::error_code ec;
+    if (result) {
+        boost::filesystem::rename(path_tmp, path, ec);
+        result = ! ec;
+    }
+    if (! result) {
+        BOOST_LOG_TRIVIAL(error) << "store_model_cache: Couldn't write " << path;
+        boost::filesystem::remove(path_tmp, ec);
+    }
+    return result;
+}
+
+static bool load_model_cache(ModelCacheReader &reader, Model *model, uint64_t source_hash)
+{
+    ModelCacheHeader header     = reader.read_pod<ModelCacheHeader>();
+    ModelCacheHeader header_ref;
+    header_ref.init(source_hash);
+    if (reader.error() || memcmp(&header, &header_ref, sizeof(header)) != 0)
+        return false;
+
+    uint64_t num_materials = reader.read_pod<uint64_t>();
+    for (uint64_t i = 0; i < num_materials && ! reader.error(); ++ i) {
+        ModelMaterial *material = model->add_material(reader.read_string());
+        uint64_t num_attributes = reader.read_pod<uint64_t>();
+        for (uint64_t j = 0; j < num_attributes && ! reader.error(); ++ j) {
+            std::string key = reader.read_string();
+            material->attributes[key] = reader.read_string();
+        }
+        reader.read_config(material->config);
+    }
+
+    uint64_t num_objects = reader.read_pod<uint64_t>();
+    for (uint64_t i = 0; i < num_objects && ! reader.error(); ++ i) {
+        ModelObject *object = model->add_object();
+        object->name       = reader.read_string();
+        object->input_file = reader.read_string();
+        reader.read_config(object->config);
+        uint64_t num_ranges = reader.read_pod<uint64_t>();
+        for (uint64_t j = 0; j < num_ranges && ! reader.error(); ++ j) {
+            coordf_t z1 = reader.read_pod<coordf_t>();
+            coordf_t z2 = reader.read_pod<coordf_t>();
+            object->layer_height_ranges[t_layer_height_range(z1, z2)] = reader.read_pod<coordf_t>();
+        }
+        size_t          num_profile = 0;
+        const coordf_t *profile     = reader.read_array<coordf_t>(num_profile);
+        if (profile != nullptr)
+            object->layer_height_profile.assign(profile, profile + num_profile);
+        object->layer_height_profile_valid = reader.read_pod<uint8_t>() != 0;
+        object->origin_translation.x = reader.read_pod<coordf_t>();
+        object->origin_translation.y = reader.read_pod<coordf_t>();
+        object->origin_translation.z = reader.read_pod<coordf_t>();
+        uint64_t num_instances = reader.read_pod<uint64_t>();
+        for (uint64_t j = 0; j < num_instances && ! reader.error(); ++ j) {
+            ModelInstance *instance = object->add_instance();
+            instance->rotation       = reader.read_pod<double>();
+            instance->scaling_factor = reader.read_pod<double>();
+            instance->offset.x       = reader.read_pod<coordf_t>();
+            instance->offset.y       = reader.read_pod<coordf_t>();
+        }
+        uint64_t num_volumes = reader.read_pod<uint64_t>();
+        for (uint64_t j = 0; j < num_volumes && ! reader.error(); ++ j) {
+            std::string        name = reader.read_string();
+            DynamicPrintConfig config;
+            reader.read_config(config);
+            bool               modifier    = reader.read_pod<uint8_t>() != 0;
+            std::string        material_id = reader.read_string();
+            ModelVolume       *volume      = object->add_volume(TriangleMesh());
+            if (! reader.read_mesh(*volume))
+                return false;
+            volume->name     = std::move(name);
+            volume->config   = std::move(config);
+            volume->modifier = modifier;
+            if (! material_id.empty())
+                volume->material_id(material_id);
+        }
+    }
+    return ! reader.error();
+}
+
+bool load_model_cache(const char *path, Model *model, uint64_t source_hash)
+{
+    boost::interprocess::mapped_region region;
+    try {
+        boost::interprocess::file_mapping mapping(path, boost::interprocess::read_only);
+        boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region);
+    } catch (const std::exception &ex) {
+        BOOST_LOG_TRIVIAL(error) << "load_model_cache: Couldn't open " << path << " for reading: " << ex.what();
+        return false;
+    }
+    const char *data = (const char*)region.get_address();
+    ModelCacheReader reader(data, data + region.get_size());
+
+    // Remember the content of the model, so that a partially loaded cache could be removed.
+    size_t                num_objects = model->objects.size();
+    std::set<std::string> material_ids;
+    for (const auto &material : model->materials)
+        material_ids.insert(material.first);
+    if (load_model_cache(reader, model, source_hash))
+        return true;
+    BOOST_LOG_TRIVIAL(info) << "load_model_cache: " << path << " is not a valid cache of the source file";
+    while (model->objects.size() > num_objects)
+        model->delete_object(model->objects.size() - 1);
+    std::vector<std::string> materials_added;
+    for (const auto &material : model->materials)
+        if (material_ids.find(material.first) == material_ids.end())
+            materials_added.push_back(material.first);
+    for (const std::string &material_id : materials_added)
+        model->delete_material(material_id);
+    return false;
+}
+
+}; // namespace Slic3r
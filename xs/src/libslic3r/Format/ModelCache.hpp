@@ -0,0 +1,29 @@
+#ifndef slic3r_Format_ModelCache_hpp_
+#define slic3r_Format_ModelCache_hpp_
+
+#include <stdint.h>
+
+namespace Slic3r {
+
+class Model;
+
+// Binary cache of a model loaded from a file, so that re-slicing the same file skips its parsing and repair.
+// The cache stores the indexed meshes of the volumes with their repair statistics, the materials,
+// the configuration overrides, the instances and the layer height profiles of the objects.
+// The mesh arrays are stored aligned, so that they could be used in place from a memory mapping.
+// A cache written by a different version of Slic3r or on a different platform is rejected.
+
+// Hash of the content and of the name of a model file, keying its cache.
+// The file name is hashed as well, because the STL and OBJ loaders name the objects after the file.
+extern bool model_file_hash(const char *path, uint64_t &hash);
+
+// Store a model into a cache file. The meshes shall be repaired.
+// The file is written under a temporary name and renamed, so that the concurrent readers never see it incomplete.
+extern bool store_model_cache(const char *path, Model *model, uint64_t source_hash);
+
+// Load a model from a cache file. Returns false if the file is not a valid cache of a source file with source_hash.
+extern bool load_model_cache(const char *path, Model *model, uint64_t source_hash);
+
+}; // namespace Slic3r
+
+#endif /* slic3r_Format_ModelCache_hpp_ */
@@ -4,7 +4,20 @@
 
 #include "STL.hpp"
 
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
 #include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
 
 #ifdef _WIN32
 #define DIR_SEPARATOR '\\'
@@ -39,6 +52,286 @@ bool load_stl(const char *path, Model *model, const char *object_name_in)
     return true;
 }
 
+// Parser of a chunk of an ASCII STL file, accepting the same syntax as admesh stl_read().
+class StlAsciiParser
+{
+public:
+    StlAsciiParser(const char *begin, const char *end) : m_ptr(begin), m_end(end), m_facet_start(begin) {}
+
+    // Parse all the facets of the chunk. Returns false on a syntax error.
+    bool parse(std::vector<stl_facet> &facets)
+    {
+        for (;;) {
+            this->skip_whitespaces();
+            if (m_ptr == m_end)
+                return true;
+            m_facet_start = m_ptr;
+            // Skip solid / endsolid lines, broken STL file generators may put several of them.
+            if (this->keyword("endsolid") || this->keyword("solid")) {
+                this->skip_line();
+                continue;
+            }
+            stl_facet facet;
+            memset(&facet, 0, sizeof(facet));
+            if (! this->keyword("facet") || ! this->keyword("normal"))
+                return false;
+            // Always consume the three tokens of the normal.
+            bool normal_valid = this->number(facet.normal.x);
+            normal_valid = this->number(facet.normal.y) && normal_valid;
+            normal_valid = this->number(facet.normal.z) && normal_valid;
+            if (! normal_valid)
+                // Normal was mangled. Maybe denormals or "not a number" were stored?
+                // Just reset the normal and silently ignore it.
+                memset(&facet.normal, 0, sizeof(facet.normal));
+            if (! this->keyword("outer") || ! this->keyword("loop"))
+                return false;
+            for (int j = 0; j < 3; ++ j)
+                if (! this->keyword("vertex") ||
+                    ! this->number(facet.vertex[j].x) || ! this->number(facet.vertex[j].y) || ! this->number(facet.vertex[j].z))
+                    return false;
+            if (! this->keyword("endloop") || ! this->keyword("endfacet"))
+                return false;
+            facets.push_back(facet);
+        }
+    }
+
+    // After a syntax error: The chunk ends with an incomplete facet.
+    bool truncated() const
+    {
+        static const char endfacet[] = "endfacet";
+        return std::search(m_facet_start, m_end, endfacet, endfacet + strlen(endfacet)) == m_end;
+    }
+
+private:
+    void skip_whitespaces() { while (m_ptr != m_end && isspace((unsigned char)*m_ptr)) ++ m_ptr; }
+    void skip_line() { while (m_ptr != m_end && *m_ptr != '\n') ++ m_ptr; }
+
+    bool keyword(const char *keyword)
+    {
+        this->skip_whitespaces();
+        const char *ptr = m_ptr;
+        for (; *keyword != 0; ++ keyword, ++ ptr)
+            if (ptr == m_end || *ptr != *keyword)
+                return false;
+        m_ptr = ptr;
+        return true;
+    }
+
+    // Consume the next token, parse it as a float. The mapped file is not zero terminated,
+    // therefore the token is copied into a local buffer for strtof().
+    bool number(float &value)
+    {
+        this->skip_whitespaces();
+        char   buf[64];
+        size_t len = 0;
+        for (; m_ptr != m_end && ! isspace((unsigned char)*m_ptr); ++ m_ptr)
+            if (len + 1 < sizeof(buf))
+                buf[len ++] = *m_ptr;
+        buf[len] = 0;
+        char *endptr = nullptr;
+        value = strtof(buf, &endptr);
+        return len > 0 && endptr == buf + len;
+    }
+
+    const char *m_ptr;
+    const char *m_end;
+    // Start of the facet being parsed.
+    const char *m_facet_start;
+};
+
+// Offset of the first line starting with the "facet" keyword at or after pos.
+static size_t stl_ascii_next_facet(const char *data, size_t size, size_t pos)
+{
+    for (size_t i = pos; i < size; ++ i) {
+        if (data[i] != '\n')
+            continue;
+        size_t j = i + 1;
+        while (j < size && (data[j] == ' ' || data[j] == '\t' || data[j] == '\r'))
+            ++ j;
+        if (size - j >= 5 && memcmp(data + j, "facet", 5) == 0)
+            return i + 1;
+    }
+    return size;
+}
+
+// Parse the ASCII STL in chunks of about 1MB in parallel, store the facets into stl->facet_start.
+static bool stl_read_ascii(stl_file *stl, const char *data, size_t size)
+{
+    // Get the header, the first line up to 80 characters.
+    for (size_t i = 0; i < LABEL_SIZE && i < size && data[i] != '\n'; ++ i)
+        stl->stats.header[i] = data[i];
+
+    const size_t chunk_size = 1 << 20;
+    std::vector<size_t> chunk_start(1, 0);
+    for (size_t pos = chunk_size; pos < size; pos = chunk_start.back() + chunk_size) {
+        size_t start = stl_ascii_next_facet(data, size, pos);
+        if (start == size)
+            break;
+        chunk_start.push_back(start);
+    }
+    chunk_start.push_back(size);
+
+    std::vector<std::vector<stl_facet>> chunk_facets(chunk_start.size() - 1);
+    std::vector<char>                   chunk_valid(chunk_start.size() - 1, false);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, chunk_facets.size(), 1),
+        [data, &chunk_start, &chunk_facets, &chunk_valid](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i) {
+                StlAsciiParser parser(data + chunk_start[i], data + chunk_start[i + 1]);
+                chunk_valid[i] = parser.parse(chunk_facets[i]) ||
+                    // admesh reads as many facets as there are complete groups of lines, ignoring an incomplete facet at the end of the file.
+                    (i + 1 == chunk_facets.size() && parser.truncated());
+            }
+        });
+    if (std::find(chunk_valid.begin(), chunk_valid.end(), false) != chunk_valid.end()) {
+        BOOST_LOG_TRIVIAL(error) << "Something is syntactically very wrong with this ASCII STL!";
+        return false;
+    }
+
+    std::vector<int> chunk_first_facet(chunk_facets.size() + 1, 0);
+    for (size_t i = 0; i < chunk_facets.size(); ++ i)
+        chunk_first_facet[i + 1] = chunk_first_facet[i] + int(chunk_facets[i].size());
+    stl->stats.number_of_facets = chunk_first_facet.back();
+    stl_allocate(stl);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, chunk_facets.size(), 1),
+        [stl, &chunk_facets, &chunk_first_facet](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                if (! chunk_facets[i].empty())
+                    memcpy(stl->facet_start + chunk_first_facet[i], chunk_facets[i].data(), chunk_facets[i].size() * sizeof(stl_facet));
+        });
+    return true;
+}
+
+// Copy the binary STL facets straight from the mapped file into stl->facet_start.
+static bool stl_read_binary(stl_file *stl, const char *data, size_t size, const char *path)
+{
+    // Test if the STL file has the right size.
+    if ((size - HEADER_SIZE) % SIZEOF_STL_FACET != 0 || size < STL_MIN_FILE_SIZE) {
+        BOOST_LOG_TRIVIAL(error) << "The file " << path << " has the wrong size.";
+        return false;
+    }
+    memcpy(stl->stats.header, data, LABEL_SIZE);
+    int header_num_facets;
+    memcpy(&header_num_facets, data + LABEL_SIZE, sizeof(int));
+    stl->stats.number_of_facets = int((size - HEADER_SIZE) / SIZEOF_STL_FACET);
+    if (stl->stats.number_of_facets != header_num_facets)
+        BOOST_LOG_TRIVIAL(warning) << "File size doesn't match number of facets in the header";
+    stl_allocate(stl);
+    // The facets are stored packed in the file, while stl_facet may be padded.
+    tbb::parallel_for(
+        tbb::blocked_range<int>(0, stl->stats.number_of_facets),
+        [stl, data](const tbb::blocked_range<int> &range) {
+            for (int i = range.begin(); i < range.end(); ++ i)
+                memcpy(stl->facet_start + i, data + HEADER_SIZE + size_t(i) * SIZEOF_STL_FACET, SIZEOF_STL_FACET);
+        });
+    return true;
+}
+
+// Unify the zeros of the facets, calculate the bounding box and the rest of the statistics collected by admesh stl_read().
+static void stl_read_stats(stl_file *stl)
+{
+    struct BoundingBox {
+        stl_vertex min, max;
+    };
+    BoundingBox bbox = tbb::parallel_reduce(
+        tbb::blocked_range<int>(0, stl->stats.number_of_facets),
+        BoundingBox{ stl->facet_start[0].vertex[0], stl->facet_start[0].vertex[0] },
+        [stl](const tbb::blocked_range<int> &range, BoundingBox bbox) {
+            for (int i = range.begin(); i < range.end(); ++ i) {
+                stl_facet &facet = stl->facet_start[i];
+                // Positive and negative zeros are possible in the floats, which are considered equal by the FP unit.
+                // When using a memcmp on raw floats, those numbers report to be different.
+                // Unify all +0 and -0 to +0 to make the floats equal under memcmp.
+                uint32_t *f = (uint32_t*)&facet;
+                for (int j = 0; j < 12; ++ j, ++ f) // 3x vertex + normal: 4x3 = 12 floats
+                    if (*f == 0x80000000)
+                        // Negative zero, switch to positive zero.
+                        *f = 0;
+                for (int j = 0; j < 3; ++ j) {
+                    bbox.max.x = STL_MAX(bbox.max.x, facet.vertex[j].x);
+                    bbox.min.x = STL_MIN(bbox.min.x, facet.vertex[j].x);
+                    bbox.max.y = STL_MAX(bbox.max.y, facet.vertex[j].y);
+                    bbox.min.y = STL_MIN(bbox.min.y, facet.vertex[j].y);
+                    bbox.max.z = STL_MAX(bbox.max.z, facet.vertex[j].z);
+                    bbox.min.z = STL_MIN(bbox.min.z, facet.vertex[j].z);
+                }
+            }
+            return bbox;
+        },
+        [](BoundingBox a, const BoundingBox &b) {
+            a.max.x = STL_MAX(a.max.x, b.max.x);
+            a.min.x = STL_MIN(a.min.x, b.min.x);
+            a.max.y = STL_MAX(a.max.y, b.max.y);
+            a.min.y = STL_MIN(a.min.y, b.min.y);
+            a.max.z = STL_MAX(a.max.z, b.max.z);
+            a.min.z = STL_MIN(a.min.z, b.min.z);
+            return a;
+        });
+    stl->stats.min = bbox.min;
+    stl->stats.max = bbox.max;
+    // admesh initializes the shortest edge with the first edge of the first facet.
+    const stl_facet &facet = stl->facet_start[0];
+    stl->stats.shortest_edge = STL_MAX(ABS(facet.vertex[0].z - facet.vertex[1].z),
+        STL_MAX(ABS(facet.vertex[0].x - facet.vertex[1].x), ABS(facet.vertex[0].y - facet.vertex[1].y)));
+    stl->stats.size.x = stl->stats.max.x - stl->stats.min.x;
+    stl->stats.size.y = stl->stats.max.y - stl->stats.min.y;
+    stl->stats.size.z = stl->stats.max.z - stl->stats.min.z;
+    stl->stats.bounding_diameter = sqrt(
+        stl->stats.size.x * stl->stats.size.x +
+        stl->stats.size.y * stl->stats.size.y +
+        stl->stats.size.z * stl->stats.size.z);
+}
+
+void stl_open_parallel(stl_file *stl, const char *path)
+{
+    stl_initialize(stl);
+
+    boost::system::error_code ec;
+    if (boost::filesystem::file_size(path, ec) == 0 && ! ec) {
+        // Empty files cannot be mapped.
+        BOOST_LOG_TRIVIAL(error) << "The input is an empty file: " << path;
+        stl->error = 1;
+        return;
+    }
+    boost::interprocess::mapped_region region;
+    try {
+        boost::interprocess::file_mapping mapping(path, boost::interprocess::read_only);
+        boost::interprocess::mapped_region(mapping, boost::interprocess::read_only).swap(region);
+    } catch (const std::exception &ex) {
+        BOOST_LOG_TRIVIAL(error) << "stl_open_parallel: Couldn't open " << path << " for reading: " << ex.what();
+        stl->error = 1;
+        return;
+    }
+    const char  *data = (const char*)region.get_address();
+    const size_t size = region.get_size();
+
+    // admesh detects a binary file by a character above 127 in the 128 bytes following the header.
+    // A binary file of small integer coordinates may not contain such a character, therefore a file
+    // with the size matching the number of facets stored in the header is considered binary as well.
+    stl->stats.type = ascii;
+    if (size >= HEADER_SIZE) {
+        int header_num_facets;
+        memcpy(&header_num_facets, data + LABEL_SIZE, sizeof(int));
+        if (header_num_facets > 0 && (size - HEADER_SIZE) / SIZEOF_STL_FACET == size_t(header_num_facets) &&
+            (size - HEADER_SIZE) % SIZEOF_STL_FACET == 0)
+            stl->stats.type = binary;
+    }
+    for (size_t i = HEADER_SIZE; stl->stats.type == ascii && i < std::min<size_t>(size, HEADER_SIZE + 128); ++ i)
+        if ((unsigned char)data[i] > 127)
+            stl->stats.type = binary;
+
+    if (! (stl->stats.type == binary ? stl_read_binary(stl, data, size, path) : stl_read_ascii(stl, data, size))) {
+        stl_close(stl);
+        stl_initialize(stl);
+        stl->error = 1;
+        return;
+    }
+    stl->stats.original_num_facets = stl->stats.number_of_facets;
+    if (stl->stats.number_of_facets > 0)
+        stl_read_stats(stl);
+}
+
 bool store_stl(const char *path, TriangleMesh *mesh, bool binary)
 {
     if (binary)
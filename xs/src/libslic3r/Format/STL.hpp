@@ -1,14 +1,23 @@
 #ifndef slic3r_Format_STL_hpp_
 #define slic3r_Format_STL_hpp_
 
+#include <admesh/stl.h>
+
 namespace Slic3r {
 
 class TriangleMesh;
+class Model;
 class ModelObject;
 
 // Load an STL file into a provided model.
 extern bool load_stl(const char *path, Model *model, const char *object_name = nullptr);
 
+// Replacement of admesh stl_open(). The file is memory mapped and read in a single pass: the binary facets
+// are copied straight from the mapping, an ASCII file is split into chunks at the facet boundaries,
+// which are parsed in parallel. The bounding box is calculated by a parallel reduction.
+// On failure, stl->error is set.
+extern void stl_open_parallel(stl_file *stl, const char *path);
+
 extern bool store_stl(const char *path, TriangleMesh *mesh, bool binary);
 extern bool store_stl(const char *path, ModelObject *model_object, bool binary);
 
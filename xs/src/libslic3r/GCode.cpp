@@ -20,7 +20,7 @@ namespace Slic3r {
 
 AvoidCrossingPerimeters::AvoidCrossingPerimeters()
     : use_external_mp(false), use_external_mp_once(false), disable_once(true),
-        _external_mp(NULL), _layer_mp(NULL)
+        _external_mp(NULL), _layer_mp(NULL), _layer_mp_owned(false)
 {
 }
 
@@ -29,26 +29,41 @@ AvoidCrossingPerimeters::~AvoidCrossingPerimeters()
     if (this->_external_mp != NULL)
         delete this->_external_mp;
     
-    if (this->_layer_mp != NULL)
-        delete this->_layer_mp;
+    this->clear_layer_mp();
 }
 
 void
-AvoidCrossingPerimeters::init_external_mp(const ExPolygons &islands)
+AvoidCrossingPerimeters::init_external_mp(const ExPolygons &islands, bool visibility_graph)
 {
     if (this->_external_mp != NULL)
         delete this->_external_mp;
     
-    this->_external_mp = new MotionPlanner(islands);
+    this->_external_mp = new MotionPlanner(islands, visibility_graph);
+}
+
+void
+AvoidCrossingPerimeters::init_layer_mp(const ExPolygons &islands, bool visibility_graph)
+{
+    this->clear_layer_mp();
+    this->_layer_mp = new MotionPlanner(islands, visibility_graph);
+    this->_layer_mp_owned = true;
+}
+
+void
+AvoidCrossingPerimeters::set_layer_mp(MotionPlanner *layer_mp)
+{
+    this->clear_layer_mp();
+    this->_layer_mp = layer_mp;
 }
 
 void
-AvoidCrossingPerimeters::init_layer_mp(const ExPolygons &islands)
+AvoidCrossingPerimeters::clear_layer_mp()
 {
-    if (this->_layer_mp != NULL)
+    if (this->_layer_mp_owned)
         delete this->_layer_mp;
     
-    this->_layer_mp = new MotionPlanner(islands);
+    this->_layer_mp = NULL;
+    this->_layer_mp_owned = false;
 }
 
 Polyline
@@ -183,6 +198,7 @@ Wipe::wipe(GCode &gcodegen, bool toolchange)
         wipe_path.clip_end(wipe_path.length() - wipe_dist);
     
         // subdivide the retraction in segments
+        gcodegen.writer.set_move_attributes(erNone, 0.f, 0.f, GCODE_MOVE_FLAG_WIPE);
         double retracted = 0;
         Lines lines = wipe_path.lines();
         for (Lines::const_iterator line = lines.begin(); line != lines.end(); ++line) {
@@ -192,8 +208,8 @@ Wipe::wipe(GCode &gcodegen, bool toolchange)
             double dE = length * (segment_length / wipe_dist) * 0.95;
             //FIXME one shall not generate the unnecessary G1 Fxxx commands, here wipe_speed is a constant inside this cycle.
             // Is it here for the cooling markers? Or should it be outside of the cycle?
-            gcode += gcodegen.writer.set_speed(wipe_speed*60, "", gcodegen.enable_cooling_markers ? ";_WIPE" : "");
-            gcode += gcodegen.writer.extrude_to_xy(
+            gcodegen.writer.set_speed(gcode, wipe_speed*60, "", gcodegen.enable_cooling_markers ? ";_WIPE" : "");
+            gcodegen.writer.extrude_to_xy(gcode,
                 gcodegen.point_to_gcode(line->b),
                 -dE,
                 "wipe and retract"
@@ -201,6 +217,7 @@ Wipe::wipe(GCode &gcodegen, bool toolchange)
             retracted += dE;
         }
         gcodegen.writer.extruder()->retracted += retracted;
+        gcodegen.writer.set_move_attributes(erNone, 0.f, 0.f, 0);
         
         // prevent wiping again on same path
         this->reset_path();
@@ -298,13 +315,13 @@ GCode::preamble()
 }
 
 std::string
-GCode::change_layer(const Layer &layer)
+GCode::change_layer(const Layer &layer, EdgeGrid::Grid *lower_layer_edge_grid)
 {
     this->layer = &layer;
     this->layer_index++;
     this->first_layer = (layer.id() == 0);
     delete this->_lower_layer_edge_grid;
-    this->_lower_layer_edge_grid = NULL;
+    this->_lower_layer_edge_grid = lower_layer_edge_grid;
 
     std::string gcode;
 
@@ -317,10 +334,13 @@ GCode::change_layer(const Layer &layer)
     
     // avoid computing islands and overhangs if they're not needed
     if (this->config.avoid_crossing_perimeters) {
-        ExPolygons islands = union_ex(layer.slices, true);
-        this->avoid_crossing_perimeters.init_layer_mp(islands);
+        // use the motion planner prepared by Layer::make_motion_planner(), if any
+        if (layer.motion_planner != NULL && layer.motion_planner->visibility_graph() == this->config.avoid_crossing_perimeters_visibility.value)
+            this->avoid_crossing_perimeters.set_layer_mp(layer.motion_planner);
+        else
+            this->avoid_crossing_perimeters.init_layer_mp(union_ex(layer.slices, true), this->config.avoid_crossing_perimeters_visibility.value);
     }
-    
+
     if (this->layer_count > 0) {
         gcode += this->writer.update_progress(this->layer_index, this->layer_count);
     }
@@ -545,10 +565,7 @@ GCode::extrude(ExtrusionLoop loop, std::string description, double speed)
     if (this->layer->lower_layer != NULL) {
         if (this->_lower_layer_edge_grid == NULL) {
             // Create the distance field for a layer below.
-            const coord_t distance_field_resolution = scale_(1.f);
-            this->_lower_layer_edge_grid = new EdgeGrid::Grid();
-            this->_lower_layer_edge_grid->create(this->layer->lower_layer->slices, distance_field_resolution);
-            this->_lower_layer_edge_grid->calculate_sdf();
+            this->_lower_layer_edge_grid = calculate_lower_layer_edge_grid(*this->layer);
             #if 0
             {
                 static int iRun = 0;
@@ -942,22 +959,26 @@ GCode::_extrude(const ExtrusionPath &path, std::string description, double speed
     }
     if (path.is_bridge() && this->enable_cooling_markers)
         gcode += ";_BRIDGE_FAN_START\n";
-    gcode += this->writer.set_speed(F, "", this->enable_cooling_markers ? ";_EXTRUDE_SET_SPEED" : "");
+    // The attributes go first, the CoolingBuffer does not slow down the bridges by the flag of the speed change.
+    this->writer.set_move_attributes(path.role, path.width, path.height, path.is_bridge() ? GCODE_MOVE_FLAG_BRIDGE : 0);
+    this->writer.set_speed(gcode, F, "", this->enable_cooling_markers ? ";_EXTRUDE_SET_SPEED" : "");
     double path_length = 0;
     {
-        std::string comment = this->config.gcode_comments ? description : "";
-        Lines lines = path.polyline.lines();
-        for (Lines::const_iterator line = lines.begin(); line != lines.end(); ++line) {
-            const double line_length = line->length() * SCALING_FACTOR;
+        // Append the moves in place, a single line of G-code takes less than 64 characters without a comment.
+        const Points &points = path.polyline.points;
+        gcode.reserve(gcode.size() + points.size() * (64 + description.size()));
+        for (size_t i = 1; i < points.size(); ++ i) {
+            const double line_length = points[i - 1].distance_to(points[i]) * SCALING_FACTOR;
             path_length += line_length;
             
-            gcode += this->writer.extrude_to_xy(
-                this->point_to_gcode(line->b),
+            this->writer.extrude_to_xy(gcode,
+                this->point_to_gcode(points[i]),
                 e_per_mm * line_length,
-                comment
+                description
             );
         }
     }
+    this->writer.set_move_attributes(erNone, 0.f, 0.f, 0);
     if (path.is_bridge() && this->enable_cooling_markers)
         gcode += ";_BRIDGE_FAN_END\n";
     
@@ -1004,9 +1025,8 @@ GCode::travel_to(const Point &point, ExtrusionRole role, std::string comment)
     if (needs_retraction) gcode += this->retract();
     
     // use G1 because we rely on paths being straight (G0 may make round paths)
-    Lines lines = travel.lines();
-    for (Lines::const_iterator line = lines.begin(); line != lines.end(); ++line)
-	    gcode += this->writer.travel_to_xy(this->point_to_gcode(line->b), comment);
+    for (size_t i = 1; i < travel.points.size(); ++ i)
+	    this->writer.travel_to_xy(gcode, this->point_to_gcode(travel.points[i]), comment);
     
     /*  While this makes the estimate more accurate, CoolingBuffer calculates the slowdown
         factor on the whole elapsed time but only alters non-travel moves, thus the resulting
@@ -1122,6 +1142,18 @@ GCode::set_extruder(unsigned int extruder_id)
     return gcode;
 }
 
+EdgeGrid::Grid*
+GCode::calculate_lower_layer_edge_grid(const Layer &layer)
+{
+    if (layer.lower_layer == NULL)
+        return NULL;
+    const coord_t distance_field_resolution = scale_(1.f);
+    EdgeGrid::Grid *grid = new EdgeGrid::Grid();
+    grid->create(layer.lower_layer->slices, distance_field_resolution);
+    grid->calculate_sdf();
+    return grid;
+}
+
 // convert a model-space scaled point into G-code coordinates
 Pointf
 GCode::point_to_gcode(const Point &point)
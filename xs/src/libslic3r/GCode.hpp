@@ -31,13 +31,19 @@ class AvoidCrossingPerimeters {
     
     AvoidCrossingPerimeters();
     ~AvoidCrossingPerimeters();
-    void init_external_mp(const ExPolygons &islands);
-    void init_layer_mp(const ExPolygons &islands);
+    void init_external_mp(const ExPolygons &islands, bool visibility_graph = false);
+    void init_layer_mp(const ExPolygons &islands, bool visibility_graph = false);
+    // Use a motion planner of the current layer, which has been prepared in advance and is owned by the layer.
+    void set_layer_mp(MotionPlanner *layer_mp);
     Polyline travel_to(GCode &gcodegen, Point point);
     
     private:
     MotionPlanner* _external_mp;
     MotionPlanner* _layer_mp;
+    // Was _layer_mp created by init_layer_mp()?
+    bool _layer_mp_owned;
+    
+    void clear_layer_mp();
 };
 
 class OozePrevention {
@@ -118,7 +124,10 @@ class GCode {
     void set_extruders(const std::vector<unsigned int> &extruder_ids);
     void set_origin(const Pointf &pointf);
     std::string preamble();
-    std::string change_layer(const Layer &layer);
+    // The distance field of the layer below may be prepared in advance, possibly by another thread,
+    // see calculate_lower_layer_edge_grid(). change_layer() takes the ownership, it is calculated on demand if NULL.
+    // The motion planner prepared by Layer::make_motion_planner() is used, otherwise it is calculated on demand.
+    std::string change_layer(const Layer &layer, EdgeGrid::Grid *lower_layer_edge_grid = NULL);
     std::string extrude(const ExtrusionEntity &entity, std::string description = "", double speed = -1);
     std::string extrude(ExtrusionLoop loop, std::string description = "", double speed = -1);
     std::string extrude(ExtrusionMultiPath multipath, std::string description = "", double speed = -1);
@@ -129,6 +138,8 @@ class GCode {
     std::string unretract();
     std::string set_extruder(unsigned int extruder_id);
     Pointf point_to_gcode(const Point &point);
+    // Distance field over the slices of the layer below, used to hide the seams. NULL for the first layer.
+    static EdgeGrid::Grid* calculate_lower_layer_edge_grid(const Layer &layer);
     
     private:
     Point _last_pos;
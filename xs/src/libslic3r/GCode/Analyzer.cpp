@@ -17,10 +17,10 @@ void GCodeMovesDB::reset()
 }
 
 GCodeAnalyzer::GCodeAnalyzer(const Slic3r::GCodeConfig *config) : 
-    m_config(config)
+    m_config(config),
+    m_moves(new GCodeMovesDB())
 {
     reset();
-    m_moves = new GCodeMovesDB();
 }
 
 GCodeAnalyzer::~GCodeAnalyzer()
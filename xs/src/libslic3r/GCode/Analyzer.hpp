@@ -1,5 +1,5 @@
-#ifndef slic3r_GCode_PressureEqualizer_hpp_
-#define slic3r_GCode_PressureEqualizer_hpp_
+#ifndef slic3r_GCode_Analyzer_hpp_
+#define slic3r_GCode_Analyzer_hpp_
 
 #include "../libslic3r.h"
 #include "../PrintConfig.hpp"
@@ -17,6 +17,17 @@ enum GCodeMoveType
     GCODE_MOVE_TYPE_EXTRUDE,
 };
 
+// Bits of GCodeMove::flags.
+enum GCodeMoveFlags
+{
+    // Bridging extrusion, the cooling fan may be switched to the bridge fan speed.
+    GCODE_MOVE_FLAG_BRIDGE  = 1,
+    // Retracting while wiping the nozzle over the last extrusion.
+    GCODE_MOVE_FLAG_WIPE    = 2,
+    // Feedrate change marked for the CoolingBuffer, recorded as a move not moving any axis.
+    GCODE_MOVE_FLAG_SET_SPEED = 4,
+};
+
 // For visualization purposes, for the purposes of the G-code analysis and timing.
 // The size of this structure is 56B.
 // Keep the size of this structure as small as possible, because all moves of a complete print
@@ -65,6 +76,8 @@ struct GCodeMove
     // For example, is it a bridge flow? Is the fan on?
     uint8_t         flags;
     // X,Y,Z,E,F. Storing the state of the currently active extruder only.
+    // If recorded by the GCodeWriter, E is the absolute E of the active extruder, not influenced
+    // by the resets of the E axis or by the relative E distances.
     float           pos_end[5];
     // Extrusion width, height for this segment in um.
     uint16_t        extrusion_width;
@@ -109,6 +122,7 @@ public:
 // or various speeds.
 // The GCodeAnalyzer is employed as a G-Code filter. It reads the G-code as it is generated,
 // parses the comments generated by Slic3r just for the analyzer, and removes these comments.
+// The GCodeMoves recorded by the GCodeWriter are not fed into the analyzer yet.
 class GCodeAnalyzer
 {
 public:
@@ -149,4 +163,4 @@ private:
 
 } // namespace Slic3r
 
-#endif /* slic3r_GCode_PressureEqualizer_hpp_ */
+#endif /* slic3r_GCode_Analyzer_hpp_ */
@@ -1,13 +1,29 @@
 #include "CoolingBuffer.hpp"
-#include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/replace.hpp>
-#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 namespace Slic3r {
 
+void
+CoolingBuffer::record_moves()
+{
+    this->_gcodegen->writer.record_moves(&this->_moves);
+    this->_recording = true;
+}
+
 std::string
 CoolingBuffer::append(const std::string &gcode, std::string obj_id, size_t layer_id, float print_z)
 {
+    const GCodeMoves *moves = NULL;
+    if (this->_recording) {
+        this->_gcodegen->writer.record_moves(NULL);
+        this->_recording = false;
+        moves = &this->_moves;
+    }
+
     std::string out;
     if (this->_last_z.find(obj_id) != this->_last_z.end()) {
         // A layer was finished, Z of the object's layer changed. Process the layer.
@@ -16,38 +32,107 @@ CoolingBuffer::append(const std::string &gcode, std::string obj_id, size_t layer
     
     this->_layer_id = layer_id;
     this->_last_z[obj_id] = print_z;
+    size_t old_size = this->_gcode.size();
     this->_gcode += gcode;
-    // This is a very rough estimate of the print time, 
-    // not taking into account the acceleration curves generated by the printer firmware.
-    this->_elapsed_time += this->_gcodegen->elapsed_time;
+    this->_find_markers(old_size, moves);
+    if (moves == NULL) {
+        // This is a very rough estimate of the print time,
+        // not taking into account the acceleration curves generated by the printer firmware.
+        this->_elapsed_time += this->_gcodegen->elapsed_time;
+    } else {
+        GCodeTimeEstimator::LayerTime layer_time = this->_time_estimator.estimate_layer(*moves, layer_id == 0);
+        this->_elapsed_time   += layer_time.total;
+        this->_extrusion_time += layer_time.extrusion;
+        this->_has_layer_time  = true;
+    }
     this->_gcodegen->elapsed_time = 0;
     
     return out;
 }
 
+// Indexed by CoolingBuffer::MarkerType.
+static const char *marker_names[] = { ";_EXTRUDE_SET_SPEED", ";_WIPE", ";_BRIDGE_FAN_START", ";_BRIDGE_FAN_END" };
+static const size_t num_marker_types = sizeof(marker_names) / sizeof(marker_names[0]);
+
+// Locate the cooling markers in _gcode starting at the start offset. The moves recorded with the G-code,
+// if any, hold the feedrates left out of the "G1 F" lines of the markers, in the order of the markers.
 void
-apply_speed_factor(std::string &line, float speed_factor, float min_print_speed)
+CoolingBuffer::_find_markers(size_t start, const GCodeMoves *moves)
 {
-    // find pos of F
-    size_t pos = line.find_first_of('F');
-    size_t last_pos = line.find_first_of(' ', pos+1);
-    
-    // extract current speed
-    float speed;
-    {
-        std::istringstream iss(line.substr(pos+1, last_pos));
-        iss >> speed;
+    const std::string &gcode = this->_gcode;
+    const size_t       first_marker = this->_markers.size();
+    size_t             move_idx = 0;
+    // Feedrate of the last recorded move consumed, starting with the state the recording was seeded with.
+    float              feedrate = (moves == NULL || moves->empty()) ? 0.f : moves->front().feedrate();
+    // Are there more or less marked lines without a feedrate than recorded feedrates?
+    bool               mismatch = false;
+    for (size_t pos = gcode.find(";_", start); pos != std::string::npos; pos = gcode.find(";_", pos + 2)) {
+        size_t type = 0;
+        for (; type < num_marker_types && gcode.compare(pos, strlen(marker_names[type]), marker_names[type]) != 0; ++ type) ;
+        if (type == num_marker_types)
+            // Not a cooling marker, for example an extrusion role marker.
+            continue;
+        Marker marker;
+        marker.type         = MarkerType(type);
+        marker.pos          = pos;
+        marker.adjustable   = false;
+        marker.has_feedrate = true;
+        size_t line_start = gcode.rfind('\n', pos);
+        line_start = (line_start == std::string::npos) ? 0 : line_start + 1;
+        if (moves != NULL && (marker.type == mtExtrudeSetSpeed || marker.type == mtWipe) &&
+            gcode.compare(line_start, 4, "G1 F") == 0 && ! isdigit(gcode[line_start + 4])) {
+            // The writer recorded the feedrate and left its value out after the "G1 F" of the line.
+            while (move_idx < moves->size() && ((*moves)[move_idx].flags & GCODE_MOVE_FLAG_SET_SPEED) == 0)
+                ++ move_idx;
+            if (move_idx < moves->size()) {
+                const GCodeMove &move = (*moves)[move_idx ++];
+                feedrate            = move.feedrate();
+                marker.adjustable   = marker.type == mtExtrudeSetSpeed && (move.flags & (GCODE_MOVE_FLAG_BRIDGE | GCODE_MOVE_FLAG_WIPE)) == 0;
+            } else
+                // No feedrate recorded for this line, repeat the last one.
+                mismatch = true;
+            marker.feedrate_pos = line_start + 4;
+            marker.feedrate_len = 0;
+            marker.feedrate     = feedrate;
+            marker.has_feedrate = false;
+        } else if (marker.type == mtExtrudeSetSpeed) {
+            size_t line_end = gcode.find('\n', pos);
+            if (line_end == std::string::npos)
+                line_end = gcode.size();
+            const char *wipe_marker = marker_names[mtWipe];
+            bool   wipe     = std::search(gcode.begin() + line_start, gcode.begin() + line_end,
+                                  wipe_marker, wipe_marker + strlen(wipe_marker)) != gcode.begin() + line_end;
+            const char *F   = (const char*)memchr(gcode.c_str() + line_start, 'F', pos - line_start);
+            size_t feedrate = (F == NULL) ? std::string::npos : F - gcode.c_str();
+            // Adjust feed rate of G1 commands marked with an _EXTRUDE_SET_SPEED
+            // as long as they are not _WIPE moves (they cannot if they are _EXTRUDE_SET_SPEED)
+            // and they are not preceded directly by _BRIDGE_FAN_START (do not adjust bridging speed).
+            marker.adjustable = gcode.compare(line_start, 2, "G1") == 0
+                && feedrate < pos
+                && ! wipe
+                && line_start != this->_bridge_fan_line_end;
+            if (marker.adjustable) {
+                const char *begin = gcode.c_str() + feedrate + 1;
+                char       *end   = NULL;
+                marker.feedrate     = strtof(begin, &end);
+                marker.feedrate_pos = feedrate + 1;
+                marker.feedrate_len = end - begin;
+            }
+        } else if (marker.type == mtBridgeFanStart) {
+            size_t line_end = gcode.find('\n', pos);
+            this->_bridge_fan_line_end = (line_end == std::string::npos) ? gcode.size() : line_end + 1;
+        }
+        this->_markers.push_back(marker);
     }
-    
-    // change speed
-    speed *= speed_factor;
-    speed = std::max(speed, min_print_speed);
-    
-    // replace speed in string
-    {
-        std::ostringstream oss;
-        oss << speed;
-        line.replace(pos+1, (last_pos-pos), oss.str());
+    if (moves != NULL) {
+        for (; move_idx < moves->size() && ! mismatch; ++ move_idx)
+            mismatch = ((*moves)[move_idx].flags & GCODE_MOVE_FLAG_SET_SPEED) != 0;
+        if (mismatch)
+            // The marked lines do not match the recorded moves, for example a G-code filter dropped
+            // or duplicated a marked line. The feedrates may have been taken from the wrong moves,
+            // do not slow down the feedrates of this G-code.
+            for (size_t i = first_marker; i < this->_markers.size(); ++ i)
+                this->_markers[i].adjustable = false;
     }
 }
 
@@ -56,10 +141,12 @@ CoolingBuffer::flush()
 {
     GCode &gg = *this->_gcodegen;
     
-    std::string gcode   = this->_gcode;
-    float elapsed       = this->_elapsed_time;
-    this->_gcode        = "";
-    this->_elapsed_time = 0;
+    float elapsed         = this->_elapsed_time;
+    float extrusion       = this->_extrusion_time;
+    bool  has_layer_time  = this->_has_layer_time;
+    this->_elapsed_time   = 0;
+    this->_extrusion_time = 0;
+    this->_has_layer_time = false;
     this->_last_z.clear(); // reset the whole table otherwise we would compute overlapping times
     
     int fan_speed = gg.config.fan_always_on ? gg.config.min_fan_speed.value : 0;
@@ -69,12 +156,17 @@ CoolingBuffer::flush()
     if (gg.config.cooling) {
         #ifdef SLIC3R_DEBUG
         printf("Layer %zu estimated printing time: %f seconds\n", this->_layer_id, elapsed);
-        #endif        
+        #endif
         if (elapsed < (float)gg.config.slowdown_below_layer_time) {
             // Layer time very short. Enable the fan to a full throttle and slow down the print
             // (stretch the layer print time to slowdown_below_layer_time).
             fan_speed = gg.config.max_fan_speed;
-            speed_factor = elapsed / (float)gg.config.slowdown_below_layer_time;
+            if (has_layer_time)
+                // Only the extrusions are slowed down, the travels, retracts and wipes take the same time.
+                speed_factor = (extrusion > 0.f) ?
+                    extrusion / ((float)gg.config.slowdown_below_layer_time - (elapsed - extrusion)) : 1.f;
+            else
+                speed_factor = elapsed / (float)gg.config.slowdown_below_layer_time;
         } else if (elapsed < (float)gg.config.fan_below_layer_time) {
             // Layer time quite short. Enable the fan proportionally according to the current layer time.
             fan_speed = gg.config.max_fan_speed
@@ -82,48 +174,59 @@ CoolingBuffer::flush()
                 * (elapsed - (float)gg.config.slowdown_below_layer_time)
                 / (gg.config.fan_below_layer_time - gg.config.slowdown_below_layer_time);
         }
-        
+    
         #ifdef SLIC3R_DEBUG
         printf("  fan = %d%%, speed = %f%%\n", fan_speed, speed_factor * 100);
         #endif
-        
-        if (speed_factor < 1.0) {
-            // Adjust feed rate of G1 commands marked with an _EXTRUDE_SET_SPEED
-            // as long as they are not _WIPE moves (they cannot if they are _EXTRUDE_SET_SPEED)
-            // and they are not preceded directly by _BRIDGE_FAN_START (do not adjust bridging speed).
-            std::string new_gcode;
-            std::istringstream ss(gcode);
-            std::string line;
-            bool bridge_fan_start = false;
-            while (std::getline(ss, line)) {
-                if (boost::starts_with(line, "G1")
-                    && boost::contains(line, ";_EXTRUDE_SET_SPEED")
-                    && !boost::contains(line, ";_WIPE")
-                    && !bridge_fan_start) {
-                    apply_speed_factor(line, speed_factor, this->_min_print_speed);
-                    boost::replace_first(line, ";_EXTRUDE_SET_SPEED", "");
-                }
-                bridge_fan_start = boost::contains(line, ";_BRIDGE_FAN_START");
-                new_gcode += line + '\n';
-            }
-            gcode = new_gcode;
-        }
     }
     if (this->_layer_id < gg.config.disable_fan_first_layers)
         fan_speed = 0;
     
-    gcode = gg.writer.set_fan(fan_speed) + gcode;
+    std::string gcode = gg.writer.set_fan(fan_speed);
     
     // bridge fan speed
-    if (!gg.config.cooling || gg.config.bridge_fan_speed == 0 || this->_layer_id < gg.config.disable_fan_first_layers) {
-        boost::replace_all(gcode, ";_BRIDGE_FAN_START", "");
-        boost::replace_all(gcode, ";_BRIDGE_FAN_END", "");
-    } else {
-        boost::replace_all(gcode, ";_BRIDGE_FAN_START", gg.writer.set_fan(gg.config.bridge_fan_speed, true));
-        boost::replace_all(gcode, ";_BRIDGE_FAN_END",   gg.writer.set_fan(fan_speed, true));
+    std::string bridge_fan_start, bridge_fan_end;
+    if (gg.config.cooling && gg.config.bridge_fan_speed != 0 && this->_layer_id >= gg.config.disable_fan_first_layers) {
+        bridge_fan_start = gg.writer.set_fan(gg.config.bridge_fan_speed, true);
+        bridge_fan_end   = gg.writer.set_fan(fan_speed, true);
     }
-    boost::replace_all(gcode, ";_WIPE", "");
-    boost::replace_all(gcode, ";_EXTRUDE_SET_SPEED", "");
+    
+    // Copy the G-code in a single pass: the markers are dropped or replaced by the bridge fan commands
+    // and the marked feedrates are scaled in place or formatted from the recorded moves.
+    gcode.reserve(gcode.size() + this->_gcode.size() + this->_markers.size() * bridge_fan_start.size());
+    size_t pos = 0;
+    for (const Marker &marker : this->_markers) {
+        const bool slow_down = marker.adjustable && speed_factor < 1.0;
+        if (slow_down || ! marker.has_feedrate) {
+            gcode.append(this->_gcode, pos, marker.feedrate_pos - pos);
+            GCodeFormatter::append_float(gcode, slow_down ?
+                std::max(marker.feedrate * speed_factor, this->_min_print_speed) : marker.feedrate);
+            pos = marker.feedrate_pos + marker.feedrate_len;
+        }
+        gcode.append(this->_gcode, pos, marker.pos - pos);
+        if (marker.type == mtBridgeFanStart)
+            gcode += bridge_fan_start;
+        else if (marker.type == mtBridgeFanEnd)
+            gcode += bridge_fan_end;
+        pos = marker.pos + strlen(marker_names[marker.type]);
+    }
+    gcode.append(this->_gcode, pos, std::string::npos);
+    
+    // Keep the buffers allocated for the next layer.
+    this->_gcode.clear();
+    this->_markers.clear();
+    this->_bridge_fan_line_end = std::string::npos;
+    
+    LayerStats stats;
+    stats.layer_id     = this->_layer_id;
+    stats.elapsed_time = elapsed;
+    stats.print_time   = elapsed;
+    // The slow down is limited by min_print_speed, therefore this is an upper estimate.
+    if (speed_factor > 0.f && speed_factor < 1.f)
+        stats.print_time = has_layer_time ? (elapsed - extrusion + extrusion / speed_factor) : (elapsed / speed_factor);
+    stats.speed_factor = speed_factor;
+    stats.fan_speed    = fan_speed;
+    this->_layer_stats.push_back(stats);
     
     return gcode;
 }
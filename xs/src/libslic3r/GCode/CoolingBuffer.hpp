@@ -3,8 +3,10 @@
 
 #include "libslic3r.h"
 #include "GCode.hpp"
+#include "TimeEstimator.hpp"
 #include <map>
 #include <string>
+#include <vector>
 
 namespace Slic3r {
 
@@ -12,26 +14,85 @@ namespace Slic3r {
 A standalone G-code filter, to control cooling of the print.
 The G-code is processed per layer. Once a layer is collected, fan start / stop commands are edited
 and the print is modified to stretch over a minimum layer time.
+The cooling markers emitted by GCode are located once when the G-code is appended,
+flush() then produces the output in a single pass, rewriting the feedrates in place.
+If the moves of the G-code were recorded by the GCodeWriter, see record_moves(), the layer time is estimated
+from the moves and the marked feedrates are taken from the moves, the writer left them out of the G-code.
 */
 
 class CoolingBuffer {
     public:
+    // Timing of a layer processed by flush().
+    struct LayerStats {
+        size_t layer_id;
+        // Estimated print time of the layer before the slow down, in seconds.
+        float  elapsed_time;
+        // Estimated print time of the layer after the slow down, in seconds.
+        float  print_time;
+        // Factor the extrusion feedrates were multiplied by, 1 if not slowed down.
+        float  speed_factor;
+        // Fan speed in percent.
+        int    fan_speed;
+    };
+
     CoolingBuffer(GCode &gcodegen)
-        : _gcodegen(&gcodegen), _elapsed_time(0.), _layer_id(0)
+        : _gcodegen(&gcodegen), _elapsed_time(0.), _extrusion_time(0.), _has_layer_time(false), _layer_id(0),
+          _bridge_fan_line_end(std::string::npos), _recording(false), _time_estimator(gcodegen.config)
     {
         this->_min_print_speed = this->_gcodegen->config.min_print_speed * 60;
     };
+    // Record the moves emitted by the GCodeWriter of the gcodegen until the next append().
+    void record_moves();
+    // If the moves of the G-code were recorded, the layer time is estimated from them by the GCodeTimeEstimator
+    // and only the extrusions are slowed down to stretch the layer time, otherwise the layer time is taken
+    // from GCode::elapsed_time.
     std::string append(const std::string &gcode, std::string obj_id, size_t layer_id, float print_z);
     std::string flush();
     GCode* gcodegen() { return this->_gcodegen; };
-    
+    // Timing of the layers flushed so far.
+    const std::vector<LayerStats>& layer_stats() const { return this->_layer_stats; }
+
     private:
+    enum MarkerType {
+        mtExtrudeSetSpeed,
+        mtWipe,
+        mtBridgeFanStart,
+        mtBridgeFanEnd,
+    };
+    // A cooling marker found in _gcode.
+    struct Marker {
+        MarkerType type;
+        // Offset of the marker in _gcode.
+        size_t     pos;
+        // Offset and length of the feedrate value in _gcode, the feedrate and whether the feedrate
+        // may be scaled (it is not a bridge). The length is zero if the value is to be formatted
+        // from the recorded moves, then the feedrate is always written.
+        size_t     feedrate_pos;
+        size_t     feedrate_len;
+        float      feedrate;
+        bool       adjustable;
+        bool       has_feedrate;
+    };
+
     GCode*                      _gcodegen;
     std::string                 _gcode;
+    std::vector<Marker>         _markers;
     float                       _elapsed_time;
+    // Time of the extrusion moves, part of _elapsed_time, if estimated by the GCodeTimeEstimator.
+    float                       _extrusion_time;
+    bool                        _has_layer_time;
     size_t                      _layer_id;
     std::map<std::string,float> _last_z;
     float                       _min_print_speed;
+    // Offset in _gcode of the line following the last ;_BRIDGE_FAN_START marker.
+    size_t                      _bridge_fan_line_end;
+    std::vector<LayerStats>     _layer_stats;
+    // Moves of the G-code to be appended, recorded by the GCodeWriter.
+    GCodeMoves                  _moves;
+    bool                        _recording;
+    GCodeTimeEstimator          _time_estimator;
+
+    void _find_markers(size_t start, const GCodeMoves *moves);
 };
 
 }
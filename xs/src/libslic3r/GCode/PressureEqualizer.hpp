@@ -9,6 +9,8 @@ namespace Slic3r {
 
 // Processes a G-code. Finds changes in the volumetric extrusion speed and adjusts the transitions
 // between these paths to limit fast changes in the volumetric extrusion speed.
+// The G-code text is parsed, the GCodeMoves recorded by the GCodeWriter are not consumed,
+// because the extrusion lines are split and rewritten after the CoolingBuffer adjusted their feedrates.
 class GCodePressureEqualizer
 {
 public:
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <math.h>
+
+#include "TimeEstimator.hpp"
+
+namespace Slic3r {
+
+const float GCodeTimeEstimator::DEFAULT_ACCELERATION = 1500.f;
+const float GCodeTimeEstimator::MAX_JERK             = 20.f;
+const float GCodeTimeEstimator::MAX_E_JERK           = 5.f;
+
+// Acceleration of a move, following the selection of the acceleration by GCode::_extrude()
+// and the reset to the default acceleration after each extrusion. If an acceleration is not set,
+// the one set last stays active in the firmware.
+float GCodeTimeEstimator::acceleration(const GCodeMove &move, bool first_layer)
+{
+    double acceleration = 0.;
+    if (move.type == GCODE_MOVE_TYPE_EXTRUDE) {
+        const ExtrusionRole role = ExtrusionRole(move.extrusion_role);
+        if (m_config.first_layer_acceleration.value > 0 && first_layer)
+            acceleration = m_config.first_layer_acceleration.value;
+        else if (m_config.perimeter_acceleration.value > 0 &&
+            (role == erPerimeter || role == erExternalPerimeter || role == erOverhangPerimeter))
+            acceleration = m_config.perimeter_acceleration.value;
+        else if (m_config.bridge_acceleration.value > 0 && (role == erBridgeInfill || role == erOverhangPerimeter))
+            acceleration = m_config.bridge_acceleration.value;
+        else if (m_config.infill_acceleration.value > 0 &&
+            (role == erBridgeInfill || role == erInternalInfill || role == erSolidInfill || role == erTopSolidInfill))
+            acceleration = m_config.infill_acceleration.value;
+        else
+            acceleration = m_config.default_acceleration.value;
+    } else
+        acceleration = m_config.default_acceleration.value;
+    if (acceleration > 0.)
+        m_acceleration = float(acceleration);
+    return m_acceleration;
+}
+
+// Time of a move of a given length with a trapezoidal velocity profile:
+// accelerating from the entry speed to the nominal speed, cruising, decelerating to the exit speed.
+// If the nominal speed cannot be reached, the profile is triangular.
+static inline float trapezoid_time(float length, float entry_speed, float exit_speed, float feedrate, float acceleration)
+{
+    const float accelerate_distance = (feedrate * feedrate - entry_speed * entry_speed) / (2.f * acceleration);
+    const float decelerate_distance = (feedrate * feedrate - exit_speed  * exit_speed ) / (2.f * acceleration);
+    if (accelerate_distance + decelerate_distance <= length)
+        return (feedrate - entry_speed) / acceleration + (feedrate - exit_speed) / acceleration
+            + (length - accelerate_distance - decelerate_distance) / feedrate;
+    const float peak_speed = sqrt(std::max(entry_speed * entry_speed,
+        acceleration * length + 0.5f * (entry_speed * entry_speed + exit_speed * exit_speed)));
+    return (std::max(peak_speed - entry_speed, 0.f) + std::max(peak_speed - exit_speed, 0.f)) / acceleration;
+}
+
+GCodeTimeEstimator::LayerTime GCodeTimeEstimator::estimate_layer(const GCodeMoves &moves, bool first_layer)
+{
+    const float max_jerk   = (m_config.max_jerk.value > 0) ? float(m_config.max_jerk.value) : MAX_JERK;
+    const float max_e_jerk = (m_config.max_extruder_jerk.value > 0) ? float(m_config.max_extruder_jerk.value) : MAX_E_JERK;
+
+    // Convert the moves into the planner blocks, limit the speed at the junctions by the jerk.
+    m_blocks.clear();
+    bool stopped = true;
+    for (size_t i = 1; i < moves.size(); ++ i) {
+        const GCodeMove &move = moves[i];
+        if (move.type == GCODE_MOVE_TYPE_NOOP || move.type == GCODE_MOVE_TYPE_TOOL_CHANGE) {
+            // The printer waits for the tool change to finish.
+            stopped = true;
+            continue;
+        }
+        const float *pos_start = move.get_pos_start();
+        float delta[4];
+        for (size_t j = 0; j < 4; ++ j)
+            delta[j] = move.pos_end[j] - pos_start[j];
+        Block block;
+        const float length_xyz = sqrt(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+        if (length_xyz > EPSILON) {
+            block.length = length_xyz;
+            for (size_t j = 0; j < 3; ++ j)
+                block.direction[j] = delta[j] / length_xyz;
+            block.direction[3] = 0.f;
+            block.jerk = max_jerk;
+        } else if (fabs(delta[3]) > EPSILON) {
+            // Retract or unretract.
+            block.length = fabs(delta[3]);
+            block.direction[0] = block.direction[1] = block.direction[2] = 0.f;
+            block.direction[3] = (delta[3] > 0.f) ? 1.f : -1.f;
+            block.jerk = max_e_jerk;
+        } else
+            continue;
+        block.feedrate = move.feedrate() / 60.f;
+        if (block.feedrate <= 0.f)
+            continue;
+        block.acceleration = this->acceleration(move, first_layer);
+        block.extrusion    = move.type == GCODE_MOVE_TYPE_EXTRUDE;
+        block.max_entry_speed = std::min(block.feedrate, block.jerk);
+        if (! stopped) {
+            const Block &prev = m_blocks.back();
+            // The velocity vector changes from v * prev.direction to v * block.direction at the junction.
+            float dv2 = 0.f;
+            for (size_t j = 0; j < 4; ++ j)
+                dv2 += (block.direction[j] - prev.direction[j]) * (block.direction[j] - prev.direction[j]);
+            const float jerk = std::min(block.jerk, prev.jerk);
+            block.max_entry_speed = std::min(std::min(block.feedrate, prev.feedrate),
+                (dv2 > 0.f) ? jerk / sqrt(dv2) : block.feedrate);
+        }
+        m_blocks.push_back(block);
+        stopped = false;
+    }
+
+    LayerTime time;
+    if (m_blocks.empty())
+        return time;
+
+    // Backward pass: decelerate in time to reach the entry speed of the next block,
+    // the printer stops at the end of the layer.
+    {
+        Block &last = m_blocks.back();
+        last.exit_speed = std::min(last.feedrate, last.jerk);
+        for (size_t i = m_blocks.size(); i > 0; -- i) {
+            Block &block = m_blocks[i - 1];
+            if (i < m_blocks.size())
+                block.exit_speed = m_blocks[i].entry_speed;
+            block.entry_speed = std::min(block.max_entry_speed,
+                sqrt(block.exit_speed * block.exit_speed + 2.f * block.acceleration * block.length));
+        }
+    }
+    // Forward pass: accelerate from the entry speed, then integrate the time of the trapezoids.
+    for (size_t i = 0; i < m_blocks.size(); ++ i) {
+        Block &block = m_blocks[i];
+        const float max_exit_speed = sqrt(block.entry_speed * block.entry_speed + 2.f * block.acceleration * block.length);
+        if (block.exit_speed > max_exit_speed) {
+            block.exit_speed = max_exit_speed;
+            if (i + 1 < m_blocks.size())
+                m_blocks[i + 1].entry_speed = max_exit_speed;
+        }
+        const float t = trapezoid_time(block.length, block.entry_speed, block.exit_speed, block.feedrate, block.acceleration);
+        time.total += t;
+        if (block.extrusion)
+            time.extrusion += t;
+    }
+    return time;
+}
+
+} // namespace Slic3r
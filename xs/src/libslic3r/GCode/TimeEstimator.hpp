@@ -0,0 +1,68 @@
+#ifndef slic3r_GCode_TimeEstimator_hpp_
+#define slic3r_GCode_TimeEstimator_hpp_
+
+#include "../libslic3r.h"
+#include "../PrintConfig.hpp"
+#include "Analyzer.hpp"
+
+namespace Slic3r {
+
+// Estimates the print time of the moves recorded by the GCodeWriter, see GCodeMove.
+// The moves are planned the way a printer firmware does: each move follows a trapezoidal velocity profile
+// with the acceleration set by the G-code for its extrusion role, and the speed at the junction of two moves
+// is limited by the maximum instantaneous velocity change (jerk).
+class GCodeTimeEstimator
+{
+public:
+    // Acceleration of the firmware, if neither set by the G-code nor by default_acceleration, mm/s^2.
+    static const float DEFAULT_ACCELERATION;
+    // Maximum instantaneous velocity change of the XYZ axes and of the extruder for the moves not moving in XYZ, mm/s,
+    // if not set by max_jerk and max_extruder_jerk.
+    static const float MAX_JERK;
+    static const float MAX_E_JERK;
+
+    struct LayerTime {
+        LayerTime() : total(0.f), extrusion(0.f) {}
+        // Time of all the moves of the layer in seconds.
+        float total;
+        // Time of the extrusion moves in seconds, these are slowed down by the CoolingBuffer.
+        float extrusion;
+    };
+
+    // Keeps the reference, does not own the config.
+    GCodeTimeEstimator(const PrintConfig &config) : m_config(config),
+        m_acceleration((config.default_acceleration.value > 0) ? float(config.default_acceleration.value) : DEFAULT_ACCELERATION) {}
+
+    // Estimate the time of the moves of a single layer. The 0th move is a GCODE_MOVE_TYPE_NOOP holding the initial state.
+    // The printer is expected to stand still at the start and at the end of the layer.
+    LayerTime estimate_layer(const GCodeMoves &moves, bool first_layer);
+
+private:
+    const PrintConfig   &m_config;
+    // Acceleration active in the firmware, the last one set by the G-code.
+    float                m_acceleration;
+
+    struct Block {
+        // Length of the move in mm, of the XYZ axes or of the extruder for the moves not moving in XYZ.
+        float length;
+        // Unit vector of the move in the XYZE space.
+        float direction[4];
+        // Nominal speed in mm/s and the acceleration in mm/s^2.
+        float feedrate;
+        float acceleration;
+        // Speed limits at the start of the move, and the planned speeds at the start and at the end of the move.
+        float max_entry_speed;
+        float entry_speed;
+        float exit_speed;
+        float jerk;
+        bool  extrusion;
+    };
+    // Kept to not reallocate for each layer.
+    std::vector<Block>   m_blocks;
+
+    float acceleration(const GCodeMove &move, bool first_layer);
+};
+
+} // namespace Slic3r
+
+#endif /* slic3r_GCode_TimeEstimator_hpp_ */
@@ -1,18 +1,92 @@
 #include "GCodeWriter.hpp"
 #include <algorithm>
-#include <iomanip>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <map>
 
 #define FLAVOR_IS(val) this->config.gcode_flavor == val
 #define FLAVOR_IS_NOT(val) this->config.gcode_flavor != val
-#define COMMENT(comment) if (this->config.gcode_comments && !comment.empty()) gcode << " ; " << comment;
-#define PRECISION(val, precision) std::fixed << std::setprecision(precision) << val
-#define XYZF_NUM(val) PRECISION(val, 3)
-#define E_NUM(val) PRECISION(val, 5)
 
 namespace Slic3r {
 
+void
+GCodeFormatter::append_fixed(std::string &out, double value, unsigned int digits)
+{
+    static const double pow_10[] = { 1., 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    const double x      = std::abs(value);
+    const double scale  = (digits < 10) ? pow_10[digits] : 0.;
+    const double scaled = std::floor(x * scale);
+    if (digits >= 10 || ! (scaled < 1e15)) {
+        // Too many digits, a huge number or NaN.
+        char buf[512];
+        sprintf(buf, "%.*f", int(digits), value);
+        out += buf;
+        return;
+    }
+    // Print the digits backwards into a buffer of sufficient size for 18 digits, the sign and the decimal point.
+    char  buf[32];
+    char *end = buf + sizeof(buf);
+    char *ptr = end;
+    // Round the exact value of x * scale the way printf() does, half to even.
+    double rounded = scaled;
+    const double fraction = x * scale - scaled;
+    const double margin   = scaled * 1e-15 + 1e-15;
+    if (fraction > margin && fraction < 1. - margin && std::abs(fraction - 0.5) > margin) {
+        // Far enough from a tie and from an integer, the rounding error of the product does not matter.
+        if (fraction > 0.5)
+            rounded += 1.;
+    } else {
+        // Evaluate the remainders of the exact product by a fused multiply-add.
+        if (std::fma(x, scale, - rounded) < 0.)
+            rounded -= 1.;
+        const double above_half = std::fma(x, scale, - (rounded + 0.5));
+        if (above_half > 0. || (above_half == 0. && std::fmod(rounded, 2.) != 0.))
+            rounded += 1.;
+    }
+    unsigned long long n = (unsigned long long)rounded;
+    for (unsigned int i = 0; i < digits; ++ i, n /= 10)
+        *(-- ptr) = char('0' + n % 10);
+    if (digits > 0)
+        *(-- ptr) = '.';
+    do {
+        *(-- ptr) = char('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    // printf() prints the sign of a negative zero and of the negative numbers rounded to zero.
+    if (std::signbit(value))
+        *(-- ptr) = '-';
+    out.append(ptr, end - ptr);
+}
+
+void
+GCodeFormatter::append_float(std::string &out, double value)
+{
+    // The feedrates are mostly integers, print them without going through printf().
+    if (value == std::floor(value) && std::abs(value) < 1e6 && ! (value == 0. && std::signbit(value))) {
+        if (value < 0)
+            out += '-';
+        append_uint(out, (unsigned int)std::abs(value));
+        return;
+    }
+    char buf[64];
+    sprintf(buf, "%g", value);
+    out += buf;
+}
+
+void
+GCodeFormatter::append_uint(std::string &out, unsigned int value)
+{
+    char  buf[16];
+    char *end = buf + sizeof(buf);
+    char *ptr = end;
+    do {
+        *(-- ptr) = char('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    out.append(ptr, end - ptr);
+}
+
 void
 GCodeWriter::apply_print_config(const PrintConfig &print_config)
 {
@@ -245,6 +319,7 @@ GCodeWriter::toolchange(unsigned int extruder_id)
 {
     // set the new extruder
     this->_extruder = &this->extruders.find(extruder_id)->second;
+    this->_record_move(GCODE_MOVE_TYPE_TOOL_CHANGE);
     
     // return the toolchange command
     // if we are running a single-extruder setup, just set the extruder and return nothing
@@ -268,29 +343,52 @@ GCodeWriter::toolchange(unsigned int extruder_id)
 
 std::string
 GCodeWriter::set_speed(double F, const std::string &comment,
-                       const std::string &cooling_marker) const
+                       const std::string &cooling_marker)
 {
-    std::ostringstream gcode;
-    gcode << "G1 F" << F;
-    COMMENT(comment);
-    gcode << cooling_marker;
-    gcode << "\n";
-    return gcode.str();
+    std::string gcode;
+    this->set_speed(gcode, F, comment, cooling_marker);
+    return gcode;
+}
+
+void
+GCodeWriter::set_speed(std::string &gcode, double F, const std::string &comment,
+                       const std::string &cooling_marker)
+{
+    this->_F = F;
+    gcode += "G1 F";
+    if (this->_moves == NULL || cooling_marker.empty())
+        GCodeFormatter::append_float(gcode, F);
+    else
+        this->_record_move(GCODE_MOVE_TYPE_MOVE, GCODE_MOVE_FLAG_SET_SPEED);
+    this->_append_comment(gcode, comment);
+    gcode += cooling_marker;
+    gcode += '\n';
 }
 
 std::string
 GCodeWriter::travel_to_xy(const Pointf &point, const std::string &comment)
+{
+    std::string gcode;
+    this->travel_to_xy(gcode, point, comment);
+    return gcode;
+}
+
+void
+GCodeWriter::travel_to_xy(std::string &gcode, const Pointf &point, const std::string &comment)
 {
     this->_pos.x = point.x;
     this->_pos.y = point.y;
-    
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    this->_F     = this->config.travel_speed.value * 60.0;
+    this->_record_move(GCODE_MOVE_TYPE_MOVE);
+    
+    gcode += "G1 X";
+    GCodeFormatter::append_fixed(gcode, point.x, XYZF_DIGITS);
+    gcode += " Y";
+    GCodeFormatter::append_fixed(gcode, point.y, XYZF_DIGITS);
+    gcode += " F";
+    GCodeFormatter::append_fixed(gcode, this->config.travel_speed.value * 60.0, XYZF_DIGITS);
+    this->_append_comment(gcode, comment);
+    gcode += '\n';
 }
 
 std::string
@@ -310,15 +408,20 @@ GCodeWriter::travel_to_xyz(const Pointf3 &point, const std::string &comment)
         the lift. */
     this->_lifted = 0;
     this->_pos = point;
-    
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<   " Z" << XYZF_NUM(point.z)
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    this->_F   = this->config.travel_speed.value * 60.0;
+    this->_record_move(GCODE_MOVE_TYPE_MOVE);
+    
+    std::string gcode = "G1 X";
+    GCodeFormatter::append_fixed(gcode, point.x, XYZF_DIGITS);
+    gcode += " Y";
+    GCodeFormatter::append_fixed(gcode, point.y, XYZF_DIGITS);
+    gcode += " Z";
+    GCodeFormatter::append_fixed(gcode, point.z, XYZF_DIGITS);
+    gcode += " F";
+    GCodeFormatter::append_fixed(gcode, this->config.travel_speed.value * 60.0, XYZF_DIGITS);
+    this->_append_comment(gcode, comment);
+    gcode += '\n';
+    return gcode;
 }
 
 std::string
@@ -343,13 +446,16 @@ std::string
 GCodeWriter::_travel_to_z(double z, const std::string &comment)
 {
     this->_pos.z = z;
-    
-    std::ostringstream gcode;
-    gcode << "G1 Z" << XYZF_NUM(z)
-          <<   " F" << XYZF_NUM(this->config.travel_speed.value * 60.0);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    this->_F     = this->config.travel_speed.value * 60.0;
+    this->_record_move(GCODE_MOVE_TYPE_MOVE);
+    
+    std::string gcode = "G1 Z";
+    GCodeFormatter::append_fixed(gcode, z, XYZF_DIGITS);
+    gcode += " F";
+    GCodeFormatter::append_fixed(gcode, this->config.travel_speed.value * 60.0, XYZF_DIGITS);
+    this->_append_comment(gcode, comment);
+    gcode += '\n';
+    return gcode;
 }
 
 bool
@@ -367,18 +473,30 @@ GCodeWriter::will_move_z(double z) const
 
 std::string
 GCodeWriter::extrude_to_xy(const Pointf &point, double dE, const std::string &comment)
+{
+    std::string gcode;
+    this->extrude_to_xy(gcode, point, dE, comment);
+    return gcode;
+}
+
+void
+GCodeWriter::extrude_to_xy(std::string &gcode, const Pointf &point, double dE, const std::string &comment)
 {
     this->_pos.x = point.x;
     this->_pos.y = point.y;
     this->_extruder->extrude(dE);
-    
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<    " " << this->_extrusion_axis << E_NUM(this->_extruder->E);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    // Negative dE while moving is the wipe.
+    this->_record_move((dE > 0) ? GCODE_MOVE_TYPE_EXTRUDE : (dE < 0) ? GCODE_MOVE_TYPE_RETRACT : GCODE_MOVE_TYPE_MOVE);
+    
+    gcode += "G1 X";
+    GCodeFormatter::append_fixed(gcode, point.x, XYZF_DIGITS);
+    gcode += " Y";
+    GCodeFormatter::append_fixed(gcode, point.y, XYZF_DIGITS);
+    gcode += ' ';
+    gcode += this->_extrusion_axis;
+    GCodeFormatter::append_fixed(gcode, this->_extruder->E, E_DIGITS);
+    this->_append_comment(gcode, comment);
+    gcode += '\n';
 }
 
 std::string
@@ -387,15 +505,20 @@ GCodeWriter::extrude_to_xyz(const Pointf3 &point, double dE, const std::string &
     this->_pos = point;
     this->_lifted = 0;
     this->_extruder->extrude(dE);
-    
-    std::ostringstream gcode;
-    gcode << "G1 X" << XYZF_NUM(point.x)
-          <<   " Y" << XYZF_NUM(point.y)
-          <<   " Z" << XYZF_NUM(point.z)
-          <<    " " << this->_extrusion_axis << E_NUM(this->_extruder->E);
-    COMMENT(comment);
-    gcode << "\n";
-    return gcode.str();
+    this->_record_move((dE > 0) ? GCODE_MOVE_TYPE_EXTRUDE : (dE < 0) ? GCODE_MOVE_TYPE_RETRACT : GCODE_MOVE_TYPE_MOVE);
+    
+    std::string gcode = "G1 X";
+    GCodeFormatter::append_fixed(gcode, point.x, XYZF_DIGITS);
+    gcode += " Y";
+    GCodeFormatter::append_fixed(gcode, point.y, XYZF_DIGITS);
+    gcode += " Z";
+    GCodeFormatter::append_fixed(gcode, point.z, XYZF_DIGITS);
+    gcode += ' ';
+    gcode += this->_extrusion_axis;
+    GCodeFormatter::append_fixed(gcode, this->_extruder->E, E_DIGITS);
+    this->_append_comment(gcode, comment);
+    gcode += '\n';
+    return gcode;
 }
 
 std::string
@@ -421,7 +544,7 @@ GCodeWriter::retract_for_toolchange()
 std::string
 GCodeWriter::_retract(double length, double restart_extra, const std::string &comment)
 {
-    std::ostringstream gcode;
+    std::string gcode;
     
     /*  If firmware retraction is enabled, we use a fake value of 1
         since we ignore the actual configured retract_length which 
@@ -438,51 +561,65 @@ GCodeWriter::_retract(double length, double restart_extra, const std::string &co
     
     double dE = this->_extruder->retract(length, restart_extra);
     if (dE != 0) {
+        if (! this->config.use_firmware_retraction)
+            this->_F = this->_extruder->retract_speed_mm_min;
+        this->_record_move(GCODE_MOVE_TYPE_RETRACT);
         if (this->config.use_firmware_retraction) {
             if (FLAVOR_IS(gcfMachinekit))
-                gcode << "G22 ; retract\n";
+                gcode += "G22 ; retract\n";
             else
-                gcode << "G10 ; retract\n";
+                gcode += "G10 ; retract\n";
         } else {
-            gcode << "G1 " << this->_extrusion_axis << E_NUM(this->_extruder->E)
-                           << " F" << this->_extruder->retract_speed_mm_min;
-            COMMENT(comment);
-            gcode << "\n";
+            gcode += "G1 ";
+            gcode += this->_extrusion_axis;
+            GCodeFormatter::append_fixed(gcode, this->_extruder->E, E_DIGITS);
+            // The feedrate is printed with the precision of the E axis.
+            gcode += " F";
+            GCodeFormatter::append_fixed(gcode, this->_extruder->retract_speed_mm_min, E_DIGITS);
+            this->_append_comment(gcode, comment);
+            gcode += '\n';
         }
     }
     
     if (FLAVOR_IS(gcfMakerWare))
-        gcode << "M103 ; extruder off\n";
+        gcode += "M103 ; extruder off\n";
     
-    return gcode.str();
+    return gcode;
 }
 
 std::string
 GCodeWriter::unretract()
 {
-    std::ostringstream gcode;
+    std::string gcode;
     
     if (FLAVOR_IS(gcfMakerWare))
-        gcode << "M101 ; extruder on\n";
+        gcode += "M101 ; extruder on\n";
     
     double dE = this->_extruder->unretract();
     if (dE != 0) {
+        if (! this->config.use_firmware_retraction)
+            this->_F = this->_extruder->retract_speed_mm_min;
+        this->_record_move(GCODE_MOVE_TYPE_UNRETRACT);
         if (this->config.use_firmware_retraction) {
             if (FLAVOR_IS(gcfMachinekit))
-                 gcode << "G23 ; unretract\n";
+                 gcode += "G23 ; unretract\n";
             else
-                 gcode << "G11 ; unretract\n";
-            gcode << this->reset_e();
+                 gcode += "G11 ; unretract\n";
+            gcode += this->reset_e();
         } else {
             // use G1 instead of G0 because G0 will blend the restart with the previous travel move
-            gcode << "G1 " << this->_extrusion_axis << E_NUM(this->_extruder->E)
-                           << " F" << this->_extruder->retract_speed_mm_min;
-            if (this->config.gcode_comments) gcode << " ; unretract";
-            gcode << "\n";
+            gcode += "G1 ";
+            gcode += this->_extrusion_axis;
+            GCodeFormatter::append_fixed(gcode, this->_extruder->E, E_DIGITS);
+            // The feedrate is printed with the precision of the E axis.
+            gcode += " F";
+            GCodeFormatter::append_fixed(gcode, this->_extruder->retract_speed_mm_min, E_DIGITS);
+            if (this->config.gcode_comments) gcode += " ; unretract";
+            gcode += '\n';
         }
     }
     
-    return gcode.str();
+    return gcode;
 }
 
 /*  If this method is called more than once before calling unlift(),
@@ -506,6 +643,58 @@ GCodeWriter::lift()
     return "";
 }
 
+void
+GCodeWriter::record_moves(GCodeMoves *moves)
+{
+    this->_moves = moves;
+    if (moves != NULL) {
+        moves->clear();
+        this->_record_move(GCODE_MOVE_TYPE_NOOP);
+    }
+}
+
+void
+GCodeWriter::set_move_attributes(ExtrusionRole role, float width, float height, uint8_t flags)
+{
+    this->_move_attributes.extrusion_role   = uint8_t(role);
+    this->_move_attributes.flags            = flags;
+    // in um
+    this->_move_attributes.extrusion_width  = uint16_t(std::max(0.f, std::min(width  * 1000.f + 0.5f, 65535.f)));
+    this->_move_attributes.extrusion_height = uint16_t(std::max(0.f, std::min(height * 1000.f + 0.5f, 65535.f)));
+}
+
+void
+GCodeWriter::_record_move(GCodeMoveType type, uint8_t flags)
+{
+    if (this->_moves == NULL)
+        return;
+    GCodeMove move = this->_move_attributes;
+    move.type        = uint8_t(type);
+    move.flags      |= flags;
+    move.extruder_id = (this->_extruder == NULL) ? 0 : uint8_t(this->_extruder->id);
+    if (type != GCODE_MOVE_TYPE_EXTRUDE && type != GCODE_MOVE_TYPE_RETRACT) {
+        // Not an extrusion, not a wipe.
+        move.extrusion_role   = uint8_t(erNone);
+        move.extrusion_width  = 0;
+        move.extrusion_height = 0;
+    }
+    move.pos_end[0] = float(this->_pos.x);
+    move.pos_end[1] = float(this->_pos.y);
+    move.pos_end[2] = float(this->_pos.z);
+    move.pos_end[3] = (this->_extruder == NULL) ? 0.f : float(this->_extruder->absolute_E);
+    move.pos_end[4] = float(this->_F);
+    this->_moves->push_back(move);
+}
+
+void
+GCodeWriter::_append_comment(std::string &gcode, const std::string &comment) const
+{
+    if (this->config.gcode_comments && ! comment.empty()) {
+        gcode += " ; ";
+        gcode += comment;
+    }
+}
+
 std::string
 GCodeWriter::unlift()
 {
@@ -6,9 +6,22 @@
 #include "Extruder.hpp"
 #include "Point.hpp"
 #include "PrintConfig.hpp"
+#include "GCode/Analyzer.hpp"
 
 namespace Slic3r {
 
+// Appends G-code words to a string. The numbers are formatted by hand, without the locale
+// aware and allocating std::ostringstream, so emitting a move into a string with
+// a sufficient capacity does not allocate.
+class GCodeFormatter {
+public:
+    // Fixed point number with the given count of decimal digits, the equivalent of printf("%.*f").
+    static void append_fixed(std::string &out, double value, unsigned int digits);
+    // Equivalent of the default std::ostream formatting of a double, printf("%g").
+    static void append_float(std::string &out, double value);
+    static void append_uint(std::string &out, unsigned int value);
+};
+
 class GCodeWriter {
 public:
     GCodeConfig config;
@@ -17,8 +30,8 @@ public:
     
     GCodeWriter()
         : multiple_extruders(false), _extrusion_axis("E"), _extruder(NULL),
-            _last_acceleration(0), _last_fan_speed(0), _lifted(0)
-        {};
+            _last_acceleration(0), _last_fan_speed(0), _lifted(0), _F(0), _moves(NULL)
+        { this->set_move_attributes(erNone, 0.f, 0.f, 0); };
     Extruder* extruder() const { return this->_extruder; }
     std::string extrusion_axis() const { return this->_extrusion_axis; }
     void apply_print_config(const PrintConfig &print_config);
@@ -34,12 +47,16 @@ public:
     bool need_toolchange(unsigned int extruder_id) const;
     std::string set_extruder(unsigned int extruder_id);
     std::string toolchange(unsigned int extruder_id);
-    std::string set_speed(double F, const std::string &comment = std::string(), const std::string &cooling_marker = std::string()) const;
+    // The overloads taking a gcode string append to it instead of returning a new string.
+    std::string set_speed(double F, const std::string &comment = std::string(), const std::string &cooling_marker = std::string());
+    void        set_speed(std::string &gcode, double F, const std::string &comment, const std::string &cooling_marker);
     std::string travel_to_xy(const Pointf &point, const std::string &comment = std::string());
+    void        travel_to_xy(std::string &gcode, const Pointf &point, const std::string &comment);
     std::string travel_to_xyz(const Pointf3 &point, const std::string &comment = std::string());
     std::string travel_to_z(double z, const std::string &comment = std::string());
     bool will_move_z(double z) const;
     std::string extrude_to_xy(const Pointf &point, double dE, const std::string &comment = std::string());
+    void        extrude_to_xy(std::string &gcode, const Pointf &point, double dE, const std::string &comment);
     std::string extrude_to_xyz(const Pointf3 &point, double dE, const std::string &comment = std::string());
     std::string retract();
     std::string retract_for_toolchange();
@@ -47,6 +64,18 @@ public:
     std::string lift();
     std::string unlift();
     Pointf3 get_position() const { return this->_pos; }
+    
+    // Start recording the moves emitted into a vector, which is cleared and seeded
+    // with a GCODE_MOVE_TYPE_NOOP move holding the current state. The vector is not owned.
+    // The recording is stopped by passing NULL.
+    // While recording, the value of a feedrate set with a cooling marker is left out of the "G1 F" line
+    // and recorded with GCODE_MOVE_FLAG_SET_SPEED instead, the CoolingBuffer formats it from the record.
+    void record_moves(GCodeMoves *moves);
+    // Attributes of the extrusion moves recorded from now on, width and height in mm, flags of GCodeMoveFlags.
+    void set_move_attributes(ExtrusionRole role, float width, float height, uint8_t flags);
+    // Number of decimal digits of the coordinates and feedrates, and of the extrusion axis.
+    static const unsigned int XYZF_DIGITS = 3;
+    static const unsigned int E_DIGITS    = 5;
 private:
     std::string _extrusion_axis;
     Extruder* _extruder;
@@ -54,9 +83,15 @@ private:
     unsigned int _last_fan_speed;
     double _lifted;
     Pointf3 _pos;
+    // Current feedrate of the machine, mm/min.
+    double _F;
+    GCodeMoves *_moves;
+    GCodeMove   _move_attributes;
     
     std::string _travel_to_z(double z, const std::string &comment);
     std::string _retract(double length, double restart_extra, const std::string &comment);
+    void _append_comment(std::string &gcode, const std::string &comment) const;
+    void _record_move(GCodeMoveType type, uint8_t flags = 0);
 };
 
 } /* namespace Slic3r */
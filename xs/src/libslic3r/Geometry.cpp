@@ -248,20 +248,13 @@ convex_hull(const Polygons &polygons)
 void
 chained_path(const Points &points, std::vector<Points::size_type> &retval, Point start_near)
 {
-    PointConstPtrs my_points;
-    std::map<const Point*,Points::size_type> indices;
-    my_points.reserve(points.size());
-    for (Points::const_iterator it = points.begin(); it != points.end(); ++it) {
-        my_points.push_back(&*it);
-        indices[&*it] = it - points.begin();
-    }
-    
+    NearestPointLookup lookup(points);
     retval.reserve(points.size());
-    while (!my_points.empty()) {
-        Points::size_type idx = start_near.nearest_point_index(my_points);
-        start_near = *my_points[idx];
-        retval.push_back(indices[ my_points[idx] ]);
-        my_points.erase(my_points.begin() + idx);
+    while (! lookup.empty()) {
+        int idx = lookup.nearest(start_near);
+        start_near = points[idx];
+        retval.push_back(idx);
+        lookup.remove(idx);
     }
 }
 
@@ -284,6 +277,121 @@ chained_path_items(Points &points, T &items, T &retval)
 }
 template void chained_path_items(Points &points, ClipperLib::PolyNodes &items, ClipperLib::PolyNodes &retval);
 
+NearestPointLookup::NearestPointLookup(const Points &points, TieBreak tie_break) :
+    m_points(points), m_tie_break(tie_break)
+{
+    m_indices.reserve(points.size());
+    for (size_t i = 0; i < points.size(); ++ i)
+        m_indices.push_back(int(i));
+    m_leaf.assign(points.size(), -1);
+    m_removed.assign(points.size(), false);
+    if (! points.empty())
+        this->build_node(0, points.size(), -1);
+}
+
+int NearestPointLookup::build_node(size_t begin, size_t end, int parent)
+{
+    Node node;
+    node.begin  = begin;
+    node.end    = end;
+    node.left   = -1;
+    node.right  = -1;
+    node.parent = parent;
+    node.alive  = end - begin;
+    node.bbox.min = node.bbox.max = m_points[m_indices[begin]];
+    for (size_t i = begin + 1; i < end; ++ i) {
+        const Point &pt = m_points[m_indices[i]];
+        node.bbox.min.x = std::min(node.bbox.min.x, pt.x);
+        node.bbox.min.y = std::min(node.bbox.min.y, pt.y);
+        node.bbox.max.x = std::max(node.bbox.max.x, pt.x);
+        node.bbox.max.y = std::max(node.bbox.max.y, pt.y);
+    }
+    node.bbox.defined = true;
+    int node_idx = int(m_nodes.size());
+    m_nodes.push_back(node);
+    if (end - begin <= 8) {
+        for (size_t i = begin; i < end; ++ i)
+            m_leaf[m_indices[i]] = node_idx;
+    } else {
+        // Split the longer side of the bounding box at the median.
+        size_t mid = (begin + end) / 2;
+        if (node.bbox.max.x - node.bbox.min.x > node.bbox.max.y - node.bbox.min.y)
+            std::nth_element(m_indices.begin() + begin, m_indices.begin() + mid, m_indices.begin() + end,
+                [this](int i1, int i2) { return m_points[i1].x < m_points[i2].x; });
+        else
+            std::nth_element(m_indices.begin() + begin, m_indices.begin() + mid, m_indices.begin() + end,
+                [this](int i1, int i2) { return m_points[i1].y < m_points[i2].y; });
+        int left  = this->build_node(begin, mid, node_idx);
+        int right = this->build_node(mid, end, node_idx);
+        m_nodes[node_idx].left  = left;
+        m_nodes[node_idx].right = right;
+    }
+    return node_idx;
+}
+
+// Total order of the candidates, equal to the order of selection of a linear scan.
+inline bool NearestPointLookup::better(double dist, int idx, double dist_min, int idx_min) const
+{
+    if (idx_min == -1 || dist < dist_min)
+        return true;
+    if (dist > dist_min)
+        return false;
+    return (m_tie_break == tbFirstIndex || dist < EPSILON) ? (idx < idx_min) : (idx > idx_min);
+}
+
+// Squared distance of a point to a bounding box, zero if inside.
+static inline double bbox_distance2(const BoundingBox &bbox, const Point &pt)
+{
+    double dx = double(std::max<coord_t>(0, std::max(bbox.min.x - pt.x, pt.x - bbox.max.x)));
+    double dy = double(std::max<coord_t>(0, std::max(bbox.min.y - pt.y, pt.y - bbox.max.y)));
+    return dx * dx + dy * dy;
+}
+
+void NearestPointLookup::nearest(int node_idx, const Point &pt, double &dist_min, int &idx_min) const
+{
+    const Node &node = m_nodes[node_idx];
+    // Equally distant nodes have to be visited to resolve the ties.
+    if (node.alive == 0 || (idx_min != -1 && bbox_distance2(node.bbox, pt) > dist_min))
+        return;
+    if (node.left == -1) {
+        for (size_t i = node.begin; i < node.end; ++ i) {
+            int idx = m_indices[i];
+            if (m_removed[idx])
+                continue;
+            // double because long is limited to 2147483647 on some platforms and it's not enough
+            double d = double(pt.x - m_points[idx].x) * double(pt.x - m_points[idx].x) + 
+                       double(pt.y - m_points[idx].y) * double(pt.y - m_points[idx].y);
+            if (this->better(d, idx, dist_min, idx_min)) {
+                dist_min = d;
+                idx_min  = idx;
+            }
+        }
+    } else {
+        // Visit the child closer to the query point first.
+        bool left_first = bbox_distance2(m_nodes[node.left].bbox, pt) <= bbox_distance2(m_nodes[node.right].bbox, pt);
+        this->nearest(left_first ? node.left : node.right, pt, dist_min, idx_min);
+        this->nearest(left_first ? node.right : node.left, pt, dist_min, idx_min);
+    }
+}
+
+int NearestPointLookup::nearest(const Point &pt) const
+{
+    double dist_min = 0.;
+    int    idx_min  = -1;
+    if (! this->empty())
+        this->nearest(0, pt, dist_min, idx_min);
+    return idx_min;
+}
+
+void NearestPointLookup::remove(size_t idx)
+{
+    if (m_removed[idx])
+        return;
+    m_removed[idx] = true;
+    for (int node_idx = m_leaf[idx]; node_idx != -1; node_idx = m_nodes[node_idx].parent)
+        -- m_nodes[node_idx].alive;
+}
+
 bool
 directions_parallel(double angle1, double angle2, double max_diff)
 {
@@ -60,6 +60,55 @@ Polygon convex_hull(const Polygons &polygons);
 void chained_path(const Points &points, std::vector<Points::size_type> &retval, Point start_near);
 void chained_path(const Points &points, std::vector<Points::size_type> &retval);
 template<class T> void chained_path_items(Points &points, T &items, T &retval);
+
+// K-d tree over a fixed set of points supporting removal of points, used by the greedy nearest neighbor
+// path ordering (chained_path) to find the next path in O(log n) instead of a linear scan.
+// The nearest point is selected exactly as by a linear scan over the points in the order of their indices.
+class NearestPointLookup
+{
+public:
+    enum TieBreak {
+        // Of the equally distant points, prefer the point with the highest index, or with the lowest index
+        // if the points coincide with the query point. This is the selection of Point::nearest_point_index().
+        tbLastIndex,
+        // Of the equally distant points, prefer the point with the lowest index.
+        tbFirstIndex,
+    };
+
+    NearestPointLookup(const Points &points, TieBreak tie_break = tbLastIndex);
+    bool    empty() const { return m_nodes.empty() || m_nodes.front().alive == 0; }
+    // Index of the nearest point not removed yet, -1 if all points were removed.
+    int     nearest(const Point &pt) const;
+    void    remove(size_t idx);
+
+private:
+    struct Node {
+        // Bounding box of the points of this node.
+        BoundingBox bbox;
+        // Range of m_indices belonging to this node.
+        size_t      begin;
+        size_t      end;
+        // Children, -1 for a leaf.
+        int         left;
+        int         right;
+        int         parent;
+        // Number of points of this node not removed yet.
+        size_t      alive;
+    };
+    int     build_node(size_t begin, size_t end, int parent);
+    void    nearest(int node_idx, const Point &pt, double &dist_min, int &idx_min) const;
+    bool    better(double dist, int idx, double dist_min, int idx_min) const;
+
+    Points              m_points;
+    TieBreak            m_tie_break;
+    std::vector<Node>   m_nodes;
+    // Permutation of point indices, points of a node are stored in a continuous range.
+    std::vector<int>    m_indices;
+    // Leaf node of each point.
+    std::vector<int>    m_leaf;
+    std::vector<bool>   m_removed;
+};
+
 bool directions_parallel(double angle1, double angle2, double max_diff = 0);
 template<class T> bool contains(const std::vector<T> &vector, const Point &point);
 double rad2deg(double angle);
@@ -1,6 +1,7 @@
 #include "Layer.hpp"
 #include "ClipperUtils.hpp"
 #include "Geometry.hpp"
+#include "MotionPlanner.hpp"
 #include "Print.hpp"
 #include "Fill/Fill.hpp"
 #include "SVG.hpp"
@@ -19,6 +20,7 @@ Layer::Layer(size_t id, PrintObject *object, coordf_t height, coordf_t print_z,
     print_z(print_z),
     height(height),
     slices(),
+    motion_planner(NULL),
     _id(id),
     _object(object)
 {
@@ -36,6 +38,7 @@ Layer::~Layer()
     }
 
     this->clear_regions();
+    delete this->motion_planner;
 }
 
 size_t
@@ -112,6 +115,8 @@ Layer::make_slices()
     
     this->slices.expolygons.clear();
     this->slices.expolygons.reserve(slices.size());
+    // the motion planner is calculated from the slices
+    this->clear_motion_planner();
     
     // prepare ordering points
     Points ordering_points;
@@ -143,6 +148,28 @@ Layer::merge_slices()
     }
 }
 
+// Motion planner for the avoid_crossing_perimeters travel moves over the slices of this layer.
+// All of its graphs are built here, so that the travel queries of the G-code export only search them.
+void
+Layer::make_motion_planner(bool visibility_graph)
+{
+    if (this->motion_planner != NULL) {
+        if (this->motion_planner->visibility_graph() == visibility_graph)
+            return;
+        this->clear_motion_planner();
+    }
+    MotionPlanner *mp = new MotionPlanner(union_ex(to_polygons(this->slices.expolygons), true), visibility_graph);
+    mp->init_graphs();
+    this->motion_planner = mp;
+}
+
+void
+Layer::clear_motion_planner()
+{
+    delete this->motion_planner;
+    this->motion_planner = NULL;
+}
+
 template <class T>
 bool
 Layer::any_internal_region_slice_contains(const T &item) const
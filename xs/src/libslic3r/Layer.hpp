@@ -12,6 +12,7 @@
 namespace Slic3r {
 
 class Layer;
+class MotionPlanner;
 class PrintRegion;
 class PrintObject;
 
@@ -107,6 +108,10 @@ public:
     // order will be recovered by the G-code generator.
     ExPolygonCollection slices;
 
+    // Motion planner of the travel moves avoiding the crossing of the slices, see make_motion_planner().
+    // Owned by the layer, NULL if not prepared yet. The G-code generator uses it until the next layer change.
+    MotionPlanner *motion_planner;
+
     size_t region_count() const;
     const LayerRegion* get_region(int idx) const { return this->regions.at(idx); }
     LayerRegion* get_region(int idx) { return this->regions.at(idx); }
@@ -114,6 +119,9 @@ public:
     
     void make_slices();
     void merge_slices();
+    // Prepare the motion planner over the slices of this layer with its configuration space and graphs built.
+    void make_motion_planner(bool visibility_graph = false);
+    void clear_motion_planner();
     template <class T> bool any_internal_region_slice_contains(const T &item) const;
     template <class T> bool any_bottom_region_slice_contains(const T &item) const;
     void make_perimeters();
@@ -1,4 +1,5 @@
 #include "Model.hpp"
+#include "ClipperUtils.hpp"
 #include "Geometry.hpp"
 
 namespace Slic3r {
@@ -358,7 +359,9 @@ ModelMaterial::apply(const t_model_material_attributes &attributes)
 ModelObject::ModelObject(Model *model) : 
     model(model), 
     _bounding_box_valid(false),
-    layer_height_profile_valid(false)
+    layer_height_profile_valid(false),
+    _raw_convex_hull_valid(false),
+    _raw_horizontal_projection_valid(false)
 {}
 
 ModelObject::ModelObject(Model *model, const ModelObject &other, bool copy_volumes)
@@ -373,7 +376,11 @@ ModelObject::ModelObject(Model *model, const ModelObject &other, bool copy_volum
     origin_translation(other.origin_translation),
     _bounding_box(other._bounding_box),
     _bounding_box_valid(other._bounding_box_valid),
-    model(model)
+    model(model),
+    _raw_convex_hull(other._raw_convex_hull),
+    _raw_convex_hull_valid(other._raw_convex_hull_valid),
+    _raw_horizontal_projection(other._raw_horizontal_projection),
+    _raw_horizontal_projection_valid(other._raw_horizontal_projection_valid)
 {
     if (copy_volumes) {
         this->volumes.reserve(other.volumes.size());
@@ -405,6 +412,10 @@ ModelObject::swap(ModelObject &other)
     std::swap(this->origin_translation,     other.origin_translation);
     std::swap(this->_bounding_box,          other._bounding_box);
     std::swap(this->_bounding_box_valid,    other._bounding_box_valid);
+    std::swap(this->_raw_convex_hull,       other._raw_convex_hull);
+    std::swap(this->_raw_convex_hull_valid, other._raw_convex_hull_valid);
+    std::swap(this->_raw_horizontal_projection,       other._raw_horizontal_projection);
+    std::swap(this->_raw_horizontal_projection_valid, other._raw_horizontal_projection_valid);
 }
 
 ModelObject::~ModelObject()
@@ -419,15 +430,18 @@ ModelObject::add_volume(const TriangleMesh &mesh)
     ModelVolume* v = new ModelVolume(this, mesh);
     this->volumes.push_back(v);
     this->invalidate_bounding_box();
+    this->invalidate_raw_projections();
     return v;
 }
 
 ModelVolume*
 ModelObject::add_volume(TriangleMesh &&mesh)
 {
-    ModelVolume* v = new ModelVolume(this, std::move(mesh));
+    // The mesh is converted to an indexed triangle set, there is nothing to move from.
+    ModelVolume* v = new ModelVolume(this, mesh);
     this->volumes.push_back(v);
     this->invalidate_bounding_box();
+    this->invalidate_raw_projections();
     return v;
 }
 
@@ -437,6 +451,7 @@ ModelObject::add_volume(const ModelVolume &other)
     ModelVolume* v = new ModelVolume(this, other);
     this->volumes.push_back(v);
     this->invalidate_bounding_box();
+    this->invalidate_raw_projections();
     return v;
 }
 
@@ -447,6 +462,7 @@ ModelObject::delete_volume(size_t idx)
     delete *i;
     this->volumes.erase(i);
     this->invalidate_bounding_box();
+    this->invalidate_raw_projections();
 }
 
 void
@@ -511,6 +527,51 @@ ModelObject::invalidate_bounding_box()
     this->_bounding_box_valid = false;
 }
 
+Polygon
+ModelObject::raw_convex_hull()
+{
+    if (! this->_raw_convex_hull_valid) {
+        Polygons hulls;
+        for (const ModelVolume *volume : this->volumes)
+            if (! volume->modifier && volume->facets_count() > 0)
+                hulls.push_back(volume->its.convex_hull());
+        if (hulls.size() == 1)
+            this->_raw_convex_hull = std::move(hulls.front());
+        else if (! hulls.empty())
+            this->_raw_convex_hull = Slic3r::Geometry::convex_hull(hulls);
+        this->_raw_convex_hull_valid = true;
+    }
+    return this->_raw_convex_hull;
+}
+
+ExPolygons
+ModelObject::raw_horizontal_projection()
+{
+    if (! this->_raw_horizontal_projection_valid) {
+        ExPolygons projection;
+        size_t num_volumes = 0;
+        for (const ModelVolume *volume : this->volumes)
+            if (! volume->modifier) {
+                expolygons_append(projection, volume->its.horizontal_projection());
+                ++ num_volumes;
+            }
+        if (num_volumes > 1)
+            projection = union_ex(projection);
+        this->_raw_horizontal_projection = std::move(projection);
+        this->_raw_horizontal_projection_valid = true;
+    }
+    return this->_raw_horizontal_projection;
+}
+
+void
+ModelObject::invalidate_raw_projections()
+{
+    this->_raw_convex_hull_valid = false;
+    this->_raw_horizontal_projection_valid = false;
+    this->_raw_convex_hull.points.clear();
+    this->_raw_horizontal_projection.clear();
+}
+
 void
 ModelObject::update_bounding_box()
 {
@@ -518,7 +579,7 @@ ModelObject::update_bounding_box()
     BoundingBoxf3 raw_bbox;
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
         if ((*v)->modifier) continue;
-        raw_bbox.merge((*v)->mesh.bounding_box());
+        raw_bbox.merge((*v)->bounding_box());
     }
     BoundingBoxf3 bb;
     for (ModelInstancePtrs::const_iterator i = this->instances.begin(); i != this->instances.end(); ++i)
@@ -545,12 +606,20 @@ ModelObject::mesh() const
 TriangleMesh
 ModelObject::raw_mesh() const
 {
-    TriangleMesh mesh;
+    // Concatenate the indexed volumes, then build the admesh facets once.
+    IndexedTriangleSet its;
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
         if ((*v)->modifier) continue;
-        mesh.merge((*v)->mesh);
+        const IndexedTriangleSet &volume_its = (*v)->its;
+        int offset = int(its.vertices.size());
+        its.vertices.insert(its.vertices.end(), volume_its.vertices.begin(), volume_its.vertices.end());
+        for (v_indices_struct facet : volume_its.indices) {
+            for (int j = 0; j < 3; ++ j)
+                facet.vertex[j] += offset;
+            its.indices.push_back(facet);
+        }
     }
-    return mesh;
+    return TriangleMesh(its);
 }
 
 BoundingBoxf3
@@ -560,7 +629,7 @@ ModelObject::raw_bounding_box() const
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
         if ((*v)->modifier) continue;
         if (this->instances.empty()) CONFESS("Can't call raw_bounding_box() with no instances");
-        bb.merge(this->instances.front()->transform_mesh_bounding_box(&(*v)->mesh, true));
+        bb.merge(this->instances.front()->transform_mesh_bounding_box(&(*v)->its, true));
     }
     return bb;
 }
@@ -572,7 +641,7 @@ ModelObject::instance_bounding_box(size_t instance_idx) const
     BoundingBoxf3 bb;
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
         if ((*v)->modifier) continue;
-        bb.merge(this->instances[instance_idx]->transform_mesh_bounding_box(&(*v)->mesh, true));
+        bb.merge(this->instances[instance_idx]->transform_mesh_bounding_box(&(*v)->its, true));
     }
     return bb;
 }
@@ -585,7 +654,7 @@ ModelObject::center_around_origin()
 	BoundingBoxf3 bb;
 	for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v)
 		if (! (*v)->modifier)
-			bb.merge((*v)->mesh.bounding_box());
+			bb.merge((*v)->bounding_box());
     
     // first align to origin on XYZ
     Vectorf3 vector(-bb.min.x, -bb.min.y, -bb.min.z);
@@ -621,41 +690,45 @@ void
 ModelObject::translate(coordf_t x, coordf_t y, coordf_t z)
 {
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
-        (*v)->mesh.translate(x, y, z);
+        (*v)->translate(x, y, z);
     }
     if (this->_bounding_box_valid) this->_bounding_box.translate(x, y, z);
+    this->invalidate_raw_projections();
 }
 
 void
 ModelObject::scale(const Pointf3 &versor)
 {
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
-        (*v)->mesh.scale(versor);
+        (*v)->scale(versor);
     }
     
     // reset origin translation since it doesn't make sense anymore
     this->origin_translation = Pointf3(0,0,0);
     this->invalidate_bounding_box();
+    this->invalidate_raw_projections();
 }
 
 void
 ModelObject::rotate(float angle, const Axis &axis)
 {
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
-        (*v)->mesh.rotate(angle, axis);
+        (*v)->rotate(angle, axis);
     }
     this->origin_translation = Pointf3(0,0,0);
     this->invalidate_bounding_box();
+    this->invalidate_raw_projections();
 }
 
 void
 ModelObject::mirror(const Axis &axis)
 {
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
-        (*v)->mesh.mirror(axis);
+        (*v)->mirror(axis);
     }
     this->origin_translation = Pointf3(0,0,0);
     this->invalidate_bounding_box();
+    this->invalidate_raw_projections();
 }
 
 size_t
@@ -674,7 +747,7 @@ ModelObject::facets_count() const
     size_t num = 0;
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
         if ((*v)->modifier) continue;
-        num += (*v)->mesh.stl.stats.number_of_facets;
+        num += (*v)->facets_count();
     }
     return num;
 }
@@ -684,7 +757,7 @@ ModelObject::needed_repair() const
 {
     for (ModelVolumePtrs::const_iterator v = this->volumes.begin(); v != this->volumes.end(); ++v) {
         if ((*v)->modifier) continue;
-        if ((*v)->mesh.needed_repair()) return true;
+        if ((*v)->needed_repair()) return true;
     }
     return false;
 }
@@ -709,13 +782,16 @@ ModelObject::cut(coordf_t z, Model* model) const
         } else {
             TriangleMesh upper_mesh, lower_mesh;
             // TODO: shouldn't we use object bounding box instead of per-volume bb?
-            coordf_t cut_z = z + volume->mesh.bounding_box().min.z;
+            coordf_t cut_z = z + volume->bounding_box().min.z;
+            // The cut only needs the facets and the shared vertices, not the facet neighbors.
+            TriangleMesh mesh = volume->mesh();
             if (false) {
-//            if (volume->mesh.has_multiple_patches()) {
+//            if (mesh.has_multiple_patches()) {
                 // Cutting algorithm does not work on intersecting meshes.
                 // As we are not sure whether the meshes don't intersect,
                 // we rather split the mesh into multiple non-intersecting pieces.
-                TriangleMeshPtrs meshptrs = volume->mesh.split();
+                mesh.repair();
+                TriangleMeshPtrs meshptrs = mesh.split();
                 for (TriangleMeshPtrs::iterator mesh = meshptrs.begin(); mesh != meshptrs.end(); ++mesh) {
                     printf("Cutting mesh patch %d of %d\n", size_t(mesh - meshptrs.begin()));
                     (*mesh)->repair();
@@ -732,7 +808,7 @@ ModelObject::cut(coordf_t z, Model* model) const
                 }
             } else {
                 printf("Cutting mesh patch\n");
-                TriangleMeshSlicer tms(&volume->mesh);
+                TriangleMeshSlicer tms(&mesh);
                 tms.cut(cut_z, &upper_mesh, &lower_mesh);
             }
 
@@ -768,7 +844,10 @@ ModelObject::split(ModelObjectPtrs* new_objects)
     }
     
     ModelVolume* volume = this->volumes.front();
-    TriangleMeshPtrs meshptrs = volume->mesh.split();
+    TriangleMesh mesh = volume->mesh();
+    // An unrepaired volume has no facet neighbors to find the connected patches.
+    mesh.repair();
+    TriangleMeshPtrs meshptrs = mesh.split();
     for (TriangleMeshPtrs::iterator mesh = meshptrs.begin(); mesh != meshptrs.end(); ++mesh) {
         (*mesh)->repair();
         
@@ -789,20 +868,89 @@ ModelObject::split(ModelObjectPtrs* new_objects)
 
 
 ModelVolume::ModelVolume(ModelObject* object, const TriangleMesh &mesh)
-:   mesh(mesh), modifier(false), object(object)
-{}
-
-ModelVolume::ModelVolume(ModelObject* object, TriangleMesh &&mesh)
-:   mesh(std::move(mesh)), modifier(false), object(object)
-{}
+:   modifier(false), object(object)
+{
+    this->set_mesh(mesh);
+}
 
 ModelVolume::ModelVolume(ModelObject* object, const ModelVolume &other)
-:   name(other.name), mesh(other.mesh), config(other.config),
+:   name(other.name), its(other.its), stats(other.stats), repaired(other.repaired), config(other.config),
     modifier(other.modifier), object(object)
 {
     this->material_id(other.material_id());
 }
 
+TriangleMesh
+ModelVolume::mesh() const
+{
+    TriangleMesh mesh(this->its);
+    if (this->repaired) {
+        // Rebuild the facet neighbors the way repair() matched them. The edges of a repaired mesh
+        // usually match exactly, the matching within the tolerance only runs for the edges left over.
+        mesh.check_facets();
+        mesh.repaired = true;
+    }
+    // Restore the statistics not derived from the vertices.
+    stl_stats &stats = mesh.stl.stats;
+    stats.original_num_facets   = this->stats.original_num_facets;
+    stats.volume                = this->stats.volume;
+    stats.number_of_parts       = this->stats.number_of_parts;
+    stats.degenerate_facets     = this->stats.degenerate_facets;
+    stats.edges_fixed           = this->stats.edges_fixed;
+    stats.facets_removed        = this->stats.facets_removed;
+    stats.facets_added          = this->stats.facets_added;
+    stats.facets_reversed       = this->stats.facets_reversed;
+    stats.backwards_edges       = this->stats.backwards_edges;
+    stats.normals_fixed         = this->stats.normals_fixed;
+    return mesh;
+}
+
+void
+ModelVolume::set_mesh(const TriangleMesh &mesh)
+{
+    this->its      = mesh.indexed_triangle_set();
+    this->stats    = mesh.stl.stats;
+    this->repaired = mesh.repaired;
+}
+
+bool
+ModelVolume::needed_repair() const
+{
+    return this->stats.degenerate_facets    > 0
+        || this->stats.edges_fixed          > 0
+        || this->stats.facets_removed       > 0
+        || this->stats.facets_added         > 0
+        || this->stats.facets_reversed      > 0
+        || this->stats.backwards_edges      > 0;
+}
+
+void
+ModelVolume::translate(float x, float y, float z)
+{
+    this->its.translate(x, y, z);
+}
+
+void
+ModelVolume::scale(const Pointf3 &versor)
+{
+    this->its.scale(versor);
+    // as stl_scale_versor()
+    if (this->stats.volume > 0.0)
+        this->stats.volume *= float(versor.x) * float(versor.y) * float(versor.z);
+}
+
+void
+ModelVolume::rotate(float angle, const Axis &axis)
+{
+    this->its.rotate(angle, axis);
+}
+
+void
+ModelVolume::mirror(const Axis &axis)
+{
+    this->its.mirror(axis);
+}
+
 t_model_material_id
 ModelVolume::material_id() const
 {
@@ -853,35 +1001,45 @@ ModelInstance::ModelInstance(ModelObject *object, const ModelInstance &other)
 void
 ModelInstance::transform_mesh(TriangleMesh* mesh, bool dont_translate) const
 {
-    mesh->rotate_z(this->rotation);                 // rotate around mesh origin
-    mesh->scale(this->scaling_factor);              // scale around mesh origin
-    if (!dont_translate)
-        mesh->translate(this->offset.x, this->offset.y, 0);
+    // rotate and scale around mesh origin
+    if (dont_translate)
+        mesh->rotate_z_scale_translate(this->rotation, this->scaling_factor, 0.f, 0.f, 0.f);
+    else
+        mesh->rotate_z_scale_translate(this->rotation, this->scaling_factor, this->offset.x, this->offset.y, 0.f);
+}
+
+void
+ModelInstance::transform_mesh(IndexedTriangleSet* its, bool dont_translate) const
+{
+    // rotate and scale around mesh origin
+    if (dont_translate)
+        its->rotate_z_scale_translate(this->rotation, this->scaling_factor, 0.f, 0.f, 0.f);
+    else
+        its->rotate_z_scale_translate(this->rotation, this->scaling_factor, this->offset.x, this->offset.y, 0.f);
 }
 
 BoundingBoxf3 ModelInstance::transform_mesh_bounding_box(const TriangleMesh* mesh, bool dont_translate) const
 {
-    // rotate around mesh origin
-    double c = cos(this->rotation);
-    double s = sin(this->rotation);
-    BoundingBoxf3 bbox;
-    for (int i = 0; i < mesh->stl.stats.number_of_facets; ++ i) {
-        const stl_facet &facet = mesh->stl.facet_start[i];
-        for (int j = 0; j < 3; ++ j) {
-            stl_vertex v = facet.vertex[j];
-            double xold = v.x;
-            double yold = v.y;
-            v.x = float(c * xold - s * yold);
-            v.y = float(s * xold + c * yold);
-            v.x *= float(this->scaling_factor);
-            v.y *= float(this->scaling_factor);
-            v.z *= float(this->scaling_factor);
-            if (!dont_translate) {
-                v.x += this->offset.x;
-                v.y += this->offset.y;
-            }
-            bbox.merge(Pointf3(v.x, v.y, v.z));
-        }
+    // rotate and scale around mesh origin
+    BoundingBoxf3 bbox = mesh->transformed_bounding_box(this->rotation, float(this->scaling_factor));
+    if (!dont_translate && bbox.defined) {
+        // Translate the extents of the single precision vertices.
+        bbox.min.x = float(bbox.min.x + this->offset.x);
+        bbox.min.y = float(bbox.min.y + this->offset.y);
+        bbox.max.x = float(bbox.max.x + this->offset.x);
+        bbox.max.y = float(bbox.max.y + this->offset.y);
+    }
+    return bbox;
+}
+
+BoundingBoxf3 ModelInstance::transform_mesh_bounding_box(const IndexedTriangleSet* its, bool dont_translate) const
+{
+    BoundingBoxf3 bbox = its->transformed_bounding_box(this->rotation, float(this->scaling_factor));
+    if (!dont_translate && bbox.defined) {
+        bbox.min.x = float(bbox.min.x + this->offset.x);
+        bbox.min.y = float(bbox.min.y + this->offset.y);
+        bbox.max.x = float(bbox.max.x + this->offset.x);
+        bbox.max.y = float(bbox.max.y + this->offset.y);
     }
     return bbox;
 }
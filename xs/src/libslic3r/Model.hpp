@@ -150,6 +150,12 @@ public:
 
     BoundingBoxf3 bounding_box();
     void invalidate_bounding_box();
+    // Convex hull and horizontal projection of the raw mesh (the non-modifier volumes without the instance
+    // transformation), scaled. Cached until the volumes are added, deleted or transformed.
+    Polygon raw_convex_hull();
+    ExPolygons raw_horizontal_projection();
+    // To be called after the volume meshes are modified in place.
+    void invalidate_raw_projections();
 
     TriangleMesh mesh() const;
     TriangleMesh raw_mesh() const;
@@ -171,6 +177,11 @@ public:
 private:
     // Parent object, owning this ModelObject.
     Model* model;
+
+    Polygon     _raw_convex_hull;
+    bool        _raw_convex_hull_valid;
+    ExPolygons  _raw_horizontal_projection;
+    bool        _raw_horizontal_projection_valid;
     
     ModelObject(Model *model);
     ModelObject(Model *model, const ModelObject &other, bool copy_volumes = true);
@@ -186,8 +197,13 @@ class ModelVolume
     friend class ModelObject;
 public:
     std::string name;
-    // The triangular model.
-    TriangleMesh mesh;
+    // The triangular model, repaired when it was assigned. The admesh stl_file with the facet neighbors
+    // is not kept, it is rebuilt by mesh() where needed (splitting, cutting, exporting).
+    IndexedTriangleSet its;
+    // Statistics of the mesh when it was assigned: the repair counters and the volume, for reporting.
+    stl_stats stats;
+    // Was the mesh repaired before it was assigned?
+    bool repaired;
     // Configuration parameters specific to an object model geometry or a modifier volume, 
     // overriding the global Slic3r settings and the ModelObject settings.
     DynamicPrintConfig config;
@@ -196,6 +212,20 @@ public:
     
     // A parent object owning this modifier volume.
     ModelObject* get_object() const { return this->object; };
+    // The mesh of this volume with its statistics. The facet neighbors of a repaired mesh are rebuilt,
+    // the repair is not repeated.
+    TriangleMesh mesh() const;
+    // Replace the mesh of this volume. The caches of the parent object are not invalidated.
+    void set_mesh(const TriangleMesh &mesh);
+    BoundingBoxf3 bounding_box() const { return this->its.bounding_box(); }
+    size_t facets_count() const { return this->its.facets_count(); }
+    bool needed_repair() const;
+    // Transform the mesh, keeping the statistics up to date as the admesh transformations do.
+    // The caches of the parent object are not invalidated.
+    void translate(float x, float y, float z);
+    void scale(const Pointf3 &versor);
+    void rotate(float angle, const Axis &axis);
+    void mirror(const Axis &axis);
     t_model_material_id material_id() const;
     void material_id(t_model_material_id material_id);
     ModelMaterial* material() const;
@@ -209,7 +239,6 @@ private:
     t_model_material_id _material_id;
     
     ModelVolume(ModelObject *object, const TriangleMesh &mesh);
-    ModelVolume(ModelObject *object, TriangleMesh &&mesh);
     ModelVolume(ModelObject *object, const ModelVolume &other);
 };
 
@@ -227,8 +256,10 @@ public:
 
     // To be called on an external mesh
     void transform_mesh(TriangleMesh* mesh, bool dont_translate = false) const;
+    void transform_mesh(IndexedTriangleSet* its, bool dont_translate = false) const;
     // Calculate a bounding box of a transformed mesh. To be called on an external mesh.
     BoundingBoxf3 transform_mesh_bounding_box(const TriangleMesh* mesh, bool dont_translate = false) const;
+    BoundingBoxf3 transform_mesh_bounding_box(const IndexedTriangleSet* its, bool dont_translate = false) const;
     // Transform an external bounding box.
     BoundingBoxf3 transform_bounding_box(const BoundingBoxf3 &bbox, bool dont_translate = false) const;
     // To be called on an external polygon. It does not translate the polygon, only rotates and scales.
@@ -1,6 +1,7 @@
 #include "BoundingBox.hpp"
 #include "MotionPlanner.hpp"
 #include <limits> // for numeric_limits
+#include <queue>
 #include <assert.h>
 
 #include "boost/polygon/voronoi.hpp"
@@ -9,8 +10,8 @@ using boost::polygon::voronoi_diagram;
 
 namespace Slic3r {
 
-MotionPlanner::MotionPlanner(const ExPolygons &islands)
-    : initialized(false)
+MotionPlanner::MotionPlanner(const ExPolygons &islands, bool visibility_graph)
+    : initialized(false), use_visibility_graph(visibility_graph)
 {
     ExPolygons expp;
     for (ExPolygons::const_iterator island = islands.begin(); island != islands.end(); ++island)
@@ -32,6 +33,37 @@ MotionPlanner::islands_count() const
     return this->islands.size();
 }
 
+// Create an edge grid over the polygons with about a single edge per cell.
+static coord_t
+grid_resolution(const BoundingBox &bbox, size_t num_edges)
+{
+    Point size = bbox.size();
+    return std::max<coord_t>(scale_(0.5), coord_t(sqrt(double(size.x) * double(size.y) / double(std::max<size_t>(num_edges, 1)))));
+}
+
+static void
+create_grid(EdgeGrid::Grid &grid, const ExPolygon &expolygon)
+{
+    size_t num_edges = expolygon.contour.points.size();
+    for (const Polygon &hole : expolygon.holes)
+        num_edges += hole.points.size();
+    if (num_edges > 0)
+        grid.create(expolygon, grid_resolution(get_extents(expolygon), num_edges));
+}
+
+static void
+create_grid(EdgeGrid::Grid &grid, const ExPolygonCollection &expolygons)
+{
+    size_t num_edges = 0;
+    for (const ExPolygon &expolygon : expolygons.expolygons) {
+        num_edges += expolygon.contour.points.size();
+        for (const Polygon &hole : expolygon.holes)
+            num_edges += hole.points.size();
+    }
+    if (num_edges > 0)
+        grid.create(expolygons, grid_resolution(get_extents(expolygons.expolygons), num_edges));
+}
+
 void
 MotionPlanner::initialize()
 {
@@ -45,6 +77,8 @@ MotionPlanner::initialize()
         // we'll use these inner rings for motion planning (endpoints of the Voronoi-based
         // graph, visibility check) in order to avoid moving too close to the boundaries
         island->env = offset_ex(island->island, -MP_INNER_MARGIN);
+        create_grid(island->island_grid, island->island);
+        create_grid(island->env_grid, island->env);
         
         // island contours are holes of our external environment
         outer_holes.push_back(island->island.contour);
@@ -65,11 +99,24 @@ MotionPlanner::initialize()
     this->outer.island = outer.front();
     
     this->outer.env = ExPolygonCollection(diff_ex(contour, offset(outer_holes, +MP_OUTER_MARGIN)));
+    this->outer.grown_env = ExPolygonCollection(offset_ex(this->outer.env.expolygons, +SCALED_EPSILON));
+    create_grid(this->outer.island_grid, this->outer.island);
+    create_grid(this->outer.env_grid, this->outer.env);
+    create_grid(this->outer.grown_env_grid, this->outer.grown_env);
     
     this->graphs.resize(this->islands.size() + 1, NULL);
     this->initialized = true;
 }
 
+void
+MotionPlanner::init_graphs()
+{
+    this->initialize();
+    if (! this->initialized) return;  // no islands
+    for (int island_idx = -1; island_idx < int(this->islands.size()); ++ island_idx)
+        this->init_graph(island_idx);
+}
+
 const MotionPlannerEnv&
 MotionPlanner::get_env(int island_idx) const
 {
@@ -80,20 +127,31 @@ MotionPlanner::get_env(int island_idx) const
     }
 }
 
+// Number of the pieces of a line inside the expolygons, calculated from the number of their edges the line crosses
+// and from the position of its end points. This is exact unless the line passes through a vertex of the expolygons.
+static size_t
+count_pieces_inside(const Line &line, const ExPolygonCollection &expolygons, const EdgeGrid::Grid &grid)
+{
+    return (grid.count_crossings(line) + (expolygons.contains(line.a) ? 1 : 0) + (expolygons.contains(line.b) ? 1 : 0)) / 2;
+}
+
 Polyline
-MotionPlanner::shortest_path(const Point &from, const Point &to)
+MotionPlanner::shortest_path(const Point &from, const Point &to, bool heuristic)
 {
     // if we have an empty configuration space, return a straight move
     if (this->islands.empty())
         return Line(from, to);
     
+    // lazy generation of configuration space
+    this->initialize();
+    
     // Are both points in the same island?
     int island_idx = -1;
     for (std::vector<MotionPlannerEnv>::const_iterator island = this->islands.begin(); island != this->islands.end(); ++island) {
         if (island->island.contains(from) && island->island.contains(to)) {
             // since both points are in the same island, is a direct move possible?
-            // if so, we avoid generating the visibility environment
-            if (island->island.contains(Line(from, to)))
+            // if so, we avoid searching the graph; the move may touch the boundaries
+            if (! island->island_grid.crosses(Line(from, to)))
                 return Line(from, to);
             
             island_idx = island - this->islands.begin();
@@ -101,11 +159,8 @@ MotionPlanner::shortest_path(const Point &from, const Point &to)
         }
     }
     
-    // lazy generation of configuration space
-    this->initialize();
-    
     // get environment
-    MotionPlannerEnv env = this->get_env(island_idx);
+    const MotionPlannerEnv &env = this->get_env(island_idx);
     if (env.env.expolygons.empty()) {
         // if this environment is empty (probably because it's too small), perform straight move
         // and avoid running the algorithms on empty dataset
@@ -131,18 +186,30 @@ MotionPlanner::shortest_path(const Point &from, const Point &to)
             inner_to = env.nearest_env_point(to, inner_from);
         }
     }
+    if (this->use_visibility_graph) {
+        // The end points in the margin between the island and its env may see no corner of the env, for example
+        // next to a grown hole or in a narrow gap between two holes, whose grown outlines merged.
+        // Step onto the env boundary without crossing the island boundaries.
+        if (!env.env.contains(inner_from))
+            inner_from = env.nearest_env_boundary_point(inner_from);
+        if (!env.env.contains(inner_to))
+            inner_to = env.nearest_env_boundary_point(inner_to);
+    }
     
     // perform actual path search
     MotionPlannerGraph* graph = this->init_graph(island_idx);
-    Polyline polyline = graph->shortest_path(graph->find_node(inner_from), graph->find_node(inner_to));
+    Polyline polyline = this->use_visibility_graph ?
+        // the end points may lie between the island and env, connect them to the corners visible inside the island
+        graph->shortest_path(inner_from, inner_to, env.island_grid, heuristic) :
+        graph->shortest_path(graph->find_node(inner_from), graph->find_node(inner_to), heuristic);
     
     polyline.points.insert(polyline.points.begin(), from);
     polyline.points.push_back(to);
     
     {
-        // grow our environment slightly in order for simplify_by_visibility()
+        // our environment grown slightly in order for simplify_by_visibility()
         // to work best by considering moves on boundaries valid as well
-        ExPolygonCollection grown_env(offset_ex(env.env.expolygons, +SCALED_EPSILON));
+        const ExPolygonCollection &grown_env = env.grown_env;
         
         if (island_idx == -1) {
             /*  If 'from' or 'to' are not inside our env, they were connected using the 
@@ -155,12 +222,12 @@ MotionPlanner::shortest_path(const Point &from, const Point &to)
             if (!grown_env.contains(from)) {
                 // delete second point while the line connecting first to third crosses the
                 // boundaries as many times as the current first to second
-                while (polyline.points.size() > 2 && intersection_ln((Lines)Line(from, polyline.points[2]), grown_env).size() == 1) {
+                while (polyline.points.size() > 2 && count_pieces_inside(Line(from, polyline.points[2]), grown_env, env.grown_env_grid) == 1) {
                     polyline.points.erase(polyline.points.begin() + 1);
                 }
             }
             if (!grown_env.contains(to)) {
-                while (polyline.points.size() > 2 && intersection_ln((Lines)Line(*(polyline.points.end() - 3), to), grown_env).size() == 1) {
+                while (polyline.points.size() > 2 && count_pieces_inside(Line(*(polyline.points.end() - 3), to), grown_env, env.grown_env_grid) == 1) {
                     polyline.points.erase(polyline.points.end() - 2);
                 }
             }
@@ -202,60 +269,125 @@ MotionPlanner::init_graph(int island_idx)
     if (this->graphs[island_idx + 1] == NULL) {
         // if this graph doesn't exist, initialize it
         MotionPlannerGraph* graph = this->graphs[island_idx + 1] = new MotionPlannerGraph();
+        const MotionPlannerEnv &env = this->get_env(island_idx);
+        if (this->use_visibility_graph)
+            this->init_visibility_graph(env, *graph);
+        else
+            this->init_voronoi_graph(env, *graph);
+        return graph;
+    }
+    return this->graphs[island_idx + 1];
+}
+
+void
+MotionPlanner::init_voronoi_graph(const MotionPlannerEnv &env, MotionPlannerGraph &graph) const
+{
+    /*  We don't add polygon boundaries as graph edges, because we'd need to connect
+        them to the Voronoi-generated edges by recognizing coinciding nodes. */
+    
+    typedef voronoi_diagram<double> VD;
+    VD vd;
+    
+    // mapping between Voronoi vertices and graph nodes
+    typedef std::map<const VD::vertex_type*,size_t> t_vd_vertices;
+    t_vd_vertices vd_vertices;
+    
+    // get boundaries as lines
+    Lines lines = env.env.lines();
+    boost::polygon::construct_voronoi(lines.begin(), lines.end(), &vd);
+    
+    // traverse the Voronoi diagram and generate graph nodes and edges
+    for (VD::const_edge_iterator edge = vd.edges().begin(); edge != vd.edges().end(); ++edge) {
+        if (edge->is_infinite()) continue;
         
-        /*  We don't add polygon boundaries as graph edges, because we'd need to connect
-            them to the Voronoi-generated edges by recognizing coinciding nodes. */
+        const VD::vertex_type* v0 = edge->vertex0();
+        const VD::vertex_type* v1 = edge->vertex1();
+        Point p0 = Point(v0->x(), v0->y());
+        Point p1 = Point(v1->x(), v1->y());
         
-        typedef voronoi_diagram<double> VD;
-        VD vd;
+        // skip edge if any of its endpoints is outside our configuration space
+        if (!env.island.contains_b(p0) || !env.island.contains_b(p1)) continue;
         
-        // mapping between Voronoi vertices and graph nodes
-        typedef std::map<const VD::vertex_type*,size_t> t_vd_vertices;
-        t_vd_vertices vd_vertices;
+        t_vd_vertices::const_iterator i_v0 = vd_vertices.find(v0);
+        size_t v0_idx;
+        if (i_v0 == vd_vertices.end()) {
+            graph.nodes.push_back(p0);
+            vd_vertices[v0] = v0_idx = graph.nodes.size()-1;
+        } else {
+            v0_idx = i_v0->second;
+        }
         
-        // get boundaries as lines
-        MotionPlannerEnv env = this->get_env(island_idx);
-        Lines lines = env.env.lines();
-        boost::polygon::construct_voronoi(lines.begin(), lines.end(), &vd);
+        t_vd_vertices::const_iterator i_v1 = vd_vertices.find(v1);
+        size_t v1_idx;
+        if (i_v1 == vd_vertices.end()) {
+            graph.nodes.push_back(p1);
+            vd_vertices[v1] = v1_idx = graph.nodes.size()-1;
+        } else {
+            v1_idx = i_v1->second;
+        }
         
-        // traverse the Voronoi diagram and generate graph nodes and edges
-        for (VD::const_edge_iterator edge = vd.edges().begin(); edge != vd.edges().end(); ++edge) {
-            if (edge->is_infinite()) continue;
-            
-            const VD::vertex_type* v0 = edge->vertex0();
-            const VD::vertex_type* v1 = edge->vertex1();
-            Point p0 = Point(v0->x(), v0->y());
-            Point p1 = Point(v1->x(), v1->y());
-            
-            // skip edge if any of its endpoints is outside our configuration space
-            if (!env.island.contains_b(p0) || !env.island.contains_b(p1)) continue;
-            
-            t_vd_vertices::const_iterator i_v0 = vd_vertices.find(v0);
-            size_t v0_idx;
-            if (i_v0 == vd_vertices.end()) {
-                graph->nodes.push_back(p0);
-                vd_vertices[v0] = v0_idx = graph->nodes.size()-1;
-            } else {
-                v0_idx = i_v0->second;
-            }
-            
-            t_vd_vertices::const_iterator i_v1 = vd_vertices.find(v1);
-            size_t v1_idx;
-            if (i_v1 == vd_vertices.end()) {
-                graph->nodes.push_back(p1);
-                vd_vertices[v1] = v1_idx = graph->nodes.size()-1;
-            } else {
-                v1_idx = i_v1->second;
+        // Euclidean distance is used as weight for the graph edge
+        double dist = graph.nodes[v0_idx].distance_to(graph.nodes[v1_idx]);
+        graph.add_edge(v0_idx, v1_idx, dist);
+    }
+    
+    graph.init_node_lookup();
+}
+
+// Sign of the cross product (b - a) x (c - a), evaluated exactly.
+static inline int
+orientation(const Point &a, const Point &b, const Point &c)
+{
+    int64_t det = (int64_t(b.x) - a.x) * (int64_t(c.y) - a.y) - (int64_t(b.y) - a.y) * (int64_t(c.x) - a.x);
+    return (det > 0) - (det < 0);
+}
+
+// Is the line from a corner to a point tangent to the polygon at the corner, so that the polygon edges
+// meeting at the corner lie on a single side of the line? The shortest paths only leave the corners this way.
+static inline bool
+tangent_at_corner(const Point &corner, const std::pair<Point, Point> &neighbors, const Point &point)
+{
+    return orientation(corner, point, neighbors.first) * orientation(corner, point, neighbors.second) >= 0;
+}
+
+void
+MotionPlanner::init_visibility_graph(const MotionPlannerEnv &env, MotionPlannerGraph &graph) const
+{
+    /*  The shortest paths around polygonal obstacles only bend at the corners, where the environment
+        is not convex. The contours are oriented counter-clockwise and the holes clockwise, so the
+        environment lies on the left side of the polygons and these corners turn right. */
+    Polygons polygons = env.env;
+    for (const Polygon &polygon : polygons) {
+        const Points &pts = polygon.points;
+        for (size_t i = 0; i < pts.size(); ++ i) {
+            const Point &prev = pts[(i == 0) ? pts.size() - 1 : i - 1];
+            const Point &next = pts[(i + 1 == pts.size()) ? 0 : i + 1];
+            if (orientation(prev, pts[i], next) < 0) {
+                graph.nodes.push_back(pts[i]);
+                graph.corner_neighbors.push_back(std::make_pair(prev, next));
             }
-            
-            // Euclidean distance is used as weight for the graph edge
-            double dist = graph->nodes[v0_idx].distance_to(graph->nodes[v1_idx]);
-            graph->add_edge(v0_idx, v1_idx, dist);
         }
-        
-        return graph;
     }
-    return this->graphs[island_idx + 1];
+    graph.adjacency_list.resize(graph.nodes.size());
+    
+    /*  Connect the mutually visible corners by the lines tangent to the polygons at both of them,
+        this is the reduced visibility graph. A path leaving a corner in another direction would
+        be shortened by cutting the corner.
+        All pairs of the concave corners are visited, so the graph is built in O(n^2) time for n corners.
+        The constant time tangency test culls most of the pairs, only the tangent ones are walked over
+        the edge grid, at a cost proportional to their length. That is what makes the visibility graph
+        an option (avoid_crossing_perimeters_visibility) and not the default. */
+    for (size_t i = 0; i < graph.nodes.size(); ++ i)
+        for (size_t j = i + 1; j < graph.nodes.size(); ++ j) {
+            const Point &a = graph.nodes[i];
+            const Point &b = graph.nodes[j];
+            if (tangent_at_corner(a, graph.corner_neighbors[i], b) && tangent_at_corner(b, graph.corner_neighbors[j], a) &&
+                ! env.env_grid.crosses(Line(a, b))) {
+                double dist = a.distance_to(b);
+                graph.add_edge(i, j, dist);
+                graph.add_edge(j, i, dist);
+            }
+        }
 }
 
 Point
@@ -288,23 +420,27 @@ MotionPlannerEnv::nearest_env_point(const Point &from, const Point &to) const
         }
     }
     
-    /*  Find the candidate result and check that it doesn't cross too many boundaries. */
-    while (pp.size() >= 2) {
-        // find the point in pp that is closest to both 'from' and 'to'
-        size_t result = from.nearest_waypoint_index(pp, to);
-        
+    /*  Find the candidate result and check that it doesn't cross too many boundaries.
+        The candidates are tried starting with the one closest to both 'from' and 'to',
+        in the order Point::nearest_waypoint_index() would pick them. */
+    auto sqr = [](double x) { return x * x; };
+    std::vector<std::pair<double, size_t> > candidates;
+    candidates.reserve(pp.size());
+    for (size_t i = 0; i < pp.size(); ++ i)
+        candidates.push_back(std::make_pair(
+            sqr(from.x - pp[i].x) + sqr(from.y - pp[i].y) + sqr(pp[i].x - to.x) + sqr(pp[i].y - to.y), i));
+    std::sort(candidates.begin(), candidates.end(), [](const std::pair<double, size_t> &c1, const std::pair<double, size_t> &c2)
+        { return c1.first < c2.first || (c1.first == c2.first && c1.second > c2.second); });
+    for (size_t i = 0; i + 1 < candidates.size(); ++ i) {
+        const Point &candidate = pp[candidates[i].second];
         // as we assume 'from' is outside env, any node will require at least one crossing
-        if (intersection_ln((Lines)Line(from, pp[result]), this->island).size() > 1) {
-            // discard result
-            pp.erase(pp.begin() + result);
-        } else {
-            return pp[result];
-        }
+        if (this->island_grid.count_crossings(Line(from, candidate)) <= 1)
+            return candidate;
     }
     
     // if we're here, return last point if any (better than nothing)
-    if (!pp.empty()) {
-        return pp.front();
+    if (!candidates.empty()) {
+        return pp[candidates.back().second];
     }
     
     // if we have no points at all, then we have an empty environment and we
@@ -312,6 +448,33 @@ MotionPlannerEnv::nearest_env_point(const Point &from, const Point &to) const
     return from;
 }
 
+Point
+MotionPlannerEnv::nearest_env_boundary_point(const Point &point) const
+{
+    /*  Try the projections of the point onto the env edges, the closest first. The env lies on the left
+        side of its edges, the projections are moved slightly to the left, so that their rounding does not
+        put them inside the env holes, where they would not be tangent to the corners of the edges. */
+    std::vector<std::pair<double, Point> > candidates;
+    Polygons polygons = this->env;
+    for (const Polygon &polygon : polygons)
+        for (const Line &line : polygon.lines()) {
+            double length = line.length();
+            if (length == 0)
+                continue;
+            Point candidate = point.projection_onto(line);
+            candidate.translate(
+                - (line.b.y - line.a.y) * SCALED_EPSILON / length,
+                  (line.b.x - line.a.x) * SCALED_EPSILON / length);
+            candidates.push_back(std::make_pair(point.distance_to(candidate), candidate));
+        }
+    std::sort(candidates.begin(), candidates.end(), [](const std::pair<double, Point> &c1, const std::pair<double, Point> &c2)
+        { return c1.first < c2.first; });
+    for (const std::pair<double, Point> &candidate : candidates)
+        if (this->island_grid.count_crossings(Line(point, candidate.second)) == 0)
+            return candidate.second;
+    return candidates.empty() ? point : candidates.front().second;
+}
+
 void
 MotionPlannerGraph::add_edge(size_t from, size_t to, double weight)
 {
@@ -322,85 +485,88 @@ MotionPlannerGraph::add_edge(size_t from, size_t to, double weight)
     this->adjacency_list[from].push_back(neighbor(to, weight));
 }
 
+void
+MotionPlannerGraph::init_node_lookup()
+{
+    this->node_lookup.reset(new Geometry::NearestPointLookup(this->nodes));
+}
+
 size_t
 MotionPlannerGraph::find_node(const Point &point) const
 {
-    /*
-    for (Points::const_iterator p = this->nodes.begin(); p != this->nodes.end(); ++p) {
-        if (p->coincides_with(point)) return p - this->nodes.begin();
-    }
-    */
+    // The lookup returns the same node as point.nearest_point_index(this->nodes).
+    if (this->node_lookup)
+        return this->node_lookup->nearest(point);
     return point.nearest_point_index(this->nodes);
 }
 
-Polyline
-MotionPlannerGraph::shortest_path(size_t from, size_t to)
+template<typename PointFn, typename ExtraEdgesFn>
+std::vector<MotionPlannerGraph::node_t>
+MotionPlannerGraph::astar(size_t num_nodes, node_t from, node_t to, PointFn point, ExtraEdgesFn extra_edges, bool heuristic) const
 {
-    // this prevents a crash in case for some reason we got here with an empty adjacency list
-    if (this->adjacency_list.empty()) return Polyline();
-    
+    static const std::vector<neighbor> no_edges;
     const weight_t max_weight = std::numeric_limits<weight_t>::infinity();
     
-    std::vector<weight_t> dist;
-    std::vector<node_t> previous;
-    {
-        // number of nodes
-        size_t n = this->adjacency_list.size();
-        
-        // initialize dist and previous
-        dist.clear();
-        dist.resize(n, max_weight);
-        dist[from] = 0;  // distance from 'from' to itself
-        previous.clear();
-        previous.resize(n, -1);
+    std::vector<weight_t> dist(num_nodes, max_weight);
+    std::vector<node_t>   previous(num_nodes, -1);
+    std::vector<bool>     visited(num_nodes, false);
+    dist[from] = 0;  // distance from 'from' to itself
+    
+    // Open nodes ordered by the distance from 'from' plus the estimated distance to 'to'.
+    // A node is queued again when its distance decreases, the outdated entries are skipped.
+    typedef std::pair<weight_t, node_t> queue_item;
+    std::priority_queue<queue_item, std::vector<queue_item>, std::greater<queue_item> > queue;
+    const Point &target = point(to);
+    queue.push(queue_item(heuristic ? point(from).distance_to(target) : 0., from));
+    
+    std::vector<neighbor> extra;
+    while (! queue.empty()) {
+        node_t u = queue.top().second;
+        queue.pop();
+        if (visited[u]) continue;
+        visited[u] = true;
         
-        // initialize the Q with all nodes
-        std::set<node_t> Q;
-        for (node_t i = 0; i < n; ++i) Q.insert(i);
+        // stop searching if we reached our destination
+        if (u == to) break;
         
-        while (!Q.empty()) 
-        {
-            // get node in Q having the minimum dist ('from' in the first loop)
-            node_t u;
-            {
-                double min_dist = -1;
-                for (std::set<node_t>::const_iterator n = Q.begin(); n != Q.end(); ++n) {
-                    if (dist[*n] < min_dist || min_dist == -1) {
-                        u = *n;
-                        min_dist = dist[*n];
-                    }
-                }
-            }
-            Q.erase(u);
+        // Visit each edge starting from node u
+        auto relax = [&](const neighbor &nb) {
+            // neighbor node is v
+            node_t v = nb.target;
             
-            // stop searching if we reached our destination
-            if (u == to) break;
+            // skip if we already visited this
+            if (visited[v]) return;
             
-            // Visit each edge starting from node u
-            const std::vector<neighbor> &neighbors = this->adjacency_list[u];
-            for (std::vector<neighbor>::const_iterator neighbor_iter = neighbors.begin();
-                 neighbor_iter != neighbors.end();
-                 ++neighbor_iter)
-            {
-                // neighbor node is v
-                node_t v = neighbor_iter->target;
-                
-                // skip if we already visited this
-                if (Q.find(v) == Q.end()) continue;
-                
-                // calculate total distance
-                weight_t alt = dist[u] + neighbor_iter->weight;
-                
-                // if total distance through u is shorter than the previous
-                // distance (if any) between 'from' and 'v', replace it
-                if (alt < dist[v]) {
-                    dist[v]     = alt;
-                    previous[v] = u;
-                }
-
+            // if total distance through u is shorter than the previous
+            // distance (if any) between 'from' and 'v', replace it
+            weight_t alt = dist[u] + nb.weight;
+            if (alt < dist[v]) {
+                dist[v]     = alt;
+                previous[v] = u;
+                queue.push(queue_item(heuristic ? alt + point(v).distance_to(target) : alt, v));
             }
-        }
+        };
+        const std::vector<neighbor> &edges = (size_t(u) < this->adjacency_list.size()) ? this->adjacency_list[u] : no_edges;
+        for (const neighbor &nb : edges)
+            relax(nb);
+        extra.clear();
+        extra_edges(u, extra);
+        for (const neighbor &nb : extra)
+            relax(nb);
     }
+    return previous;
+}
+
+Polyline
+MotionPlannerGraph::shortest_path(size_t from, size_t to, bool heuristic) const
+{
+    // this prevents a crash in case for some reason we got here with an empty adjacency list
+    if (this->adjacency_list.empty()) return Polyline();
+    
+    std::vector<node_t> previous = astar(this->nodes.size(), node_t(from), node_t(to),
+        [this](node_t v) -> const Point& { return this->nodes[v]; },
+        [](node_t, std::vector<neighbor>&) {},
+        heuristic);
     
     Polyline polyline;
     for (node_t vertex = to; vertex != -1; vertex = previous[vertex])
@@ -410,4 +576,47 @@ MotionPlannerGraph::shortest_path(size_t from, size_t to)
     return polyline;
 }
 
+Polyline
+MotionPlannerGraph::shortest_path(const Point &from, const Point &to, const EdgeGrid::Grid &grid, bool heuristic) const
+{
+    // The end points are searched as two temporary nodes following the graph nodes.
+    const weight_t max_weight = std::numeric_limits<weight_t>::infinity();
+    const node_t   num_nodes  = node_t(this->nodes.size());
+    const node_t   from_idx   = num_nodes;
+    const node_t   to_idx     = num_nodes + 1;
+    
+    // Connect the end points to the corners visible from them, which they are tangent to.
+    std::vector<neighbor> from_edges;
+    std::vector<weight_t> to_weights(num_nodes, max_weight);
+    for (node_t v = 0; v < num_nodes; ++ v) {
+        const Point &corner = this->nodes[v];
+        if (tangent_at_corner(corner, this->corner_neighbors[v], from) && ! grid.crosses(Line(from, corner)))
+            from_edges.push_back(neighbor(v, from.distance_to(corner)));
+        if (tangent_at_corner(corner, this->corner_neighbors[v], to) && ! grid.crosses(Line(corner, to)))
+            to_weights[v] = corner.distance_to(to);
+    }
+    if (! grid.crosses(Line(from, to)))
+        from_edges.push_back(neighbor(to_idx, from.distance_to(to)));
+    
+    std::vector<node_t> previous = astar(this->nodes.size() + 2, from_idx, to_idx,
+        [this, from_idx, &from, &to](node_t v) -> const Point& { return (v < from_idx) ? this->nodes[v] : (v == from_idx) ? from : to; },
+        [from_idx, to_idx, max_weight, &from_edges, &to_weights](node_t u, std::vector<neighbor> &edges) {
+            if (u == from_idx)
+                edges = from_edges;
+            else if (u < from_idx && to_weights[u] < max_weight)
+                edges.push_back(neighbor(to_idx, to_weights[u]));
+        },
+        heuristic);
+    
+    // if the end points are not connected, return a straight line like the search over the nodes does
+    Polyline polyline;
+    polyline.points.push_back(to);
+    for (node_t vertex = previous[to_idx]; vertex != -1; vertex = previous[vertex])
+        polyline.points.push_back((vertex == from_idx) ? from : this->nodes[vertex]);
+    if (polyline.points.size() == 1)
+        polyline.points.push_back(from);
+    polyline.reverse();
+    return polyline;
+}
+
 }
@@ -3,9 +3,12 @@
 
 #include "libslic3r.h"
 #include "ClipperUtils.hpp"
+#include "EdgeGrid.hpp"
 #include "ExPolygonCollection.hpp"
+#include "Geometry.hpp"
 #include "Polyline.hpp"
 #include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -23,9 +26,19 @@ class MotionPlannerEnv
     public:
     ExPolygon island;
     ExPolygonCollection env;
+    // env grown by SCALED_EPSILON to consider the moves along its boundaries valid,
+    // only calculated for the outer environment.
+    ExPolygonCollection grown_env;
+    // Edge grids of the island, env and grown_env for the visibility tests, see MotionPlanner::initialize().
+    // The grids reference the polygons above, so the environment shall not be copied once they are created.
+    EdgeGrid::Grid island_grid;
+    EdgeGrid::Grid env_grid;
+    EdgeGrid::Grid grown_env_grid;
     MotionPlannerEnv() {};
     MotionPlannerEnv(const ExPolygon &island) : island(island) {};
     Point nearest_env_point(const Point &from, const Point &to) const;
+    // Closest point of the env boundary reachable from a point inside the island without crossing its boundaries.
+    Point nearest_env_boundary_point(const Point &point) const;
 };
 
 class MotionPlannerGraph
@@ -43,31 +56,60 @@ class MotionPlannerGraph
     };
     typedef std::vector< std::vector<neighbor> > adjacency_list_t;
     adjacency_list_t adjacency_list;
+    // K-d tree over the nodes for find_node(), built by init_node_lookup() once all the nodes were added.
+    std::unique_ptr<Geometry::NearestPointLookup> node_lookup;
+    // Polygon points preceding and following the nodes of a visibility graph, which are polygon corners.
+    std::vector<std::pair<Point, Point> > corner_neighbors;
+    
+    // A* search from the node 'from' to the node 'to' of num_nodes nodes, returning the predecessors of the nodes
+    // along the paths found. point(v) returns the position of the node v. The edges leaving u are read from
+    // the adjacency list, extra_edges(u, out) fills in the edges not stored there, for example of temporary nodes.
+    // Without the heuristic, this is a plain Dijkstra search.
+    template<typename PointFn, typename ExtraEdgesFn>
+    std::vector<node_t> astar(size_t num_nodes, node_t from, node_t to, PointFn point, ExtraEdgesFn extra_edges, bool heuristic) const;
     
     public:
     Points nodes;
     //std::map<std::pair<size_t,size_t>, double> edges;
     void add_edge(size_t from, size_t to, double weight);
+    void init_node_lookup();
     size_t find_node(const Point &point) const;
-    Polyline shortest_path(size_t from, size_t to);
+    // A* search with the Euclidean distance to the target node as a heuristic,
+    // which is consistent as the edges are weighted by their lengths.
+    Polyline shortest_path(size_t from, size_t to, bool heuristic = true) const;
+    // Shortest path over a visibility graph between two points, which are connected to the corners visible
+    // from them. A segment is visible if it does not cross the edges of the grid.
+    Polyline shortest_path(const Point &from, const Point &to, const EdgeGrid::Grid &grid, bool heuristic = true) const;
 };
 
 class MotionPlanner
 {
     public:
-    MotionPlanner(const ExPolygons &islands);
+    // With visibility_graph set, the travel moves are planned over the visible corners of the environments,
+    // which gives shorter paths than the medial axis of the environments. The visibility graph of an environment
+    // is built in a time quadratic in the number of its concave corners.
+    MotionPlanner(const ExPolygons &islands, bool visibility_graph = false);
     ~MotionPlanner();
-    Polyline shortest_path(const Point &from, const Point &to);
+    // Without the heuristic, the graph is searched by Dijkstra, which the tests compare the A* paths to.
+    Polyline shortest_path(const Point &from, const Point &to, bool heuristic = true);
     size_t islands_count() const;
+    bool visibility_graph() const { return this->use_visibility_graph; }
+    // Calculate the environment offsets and their edge grids, otherwise done by the first shortest_path() call.
+    // The graph of an environment is only built by the first shortest_path() call searching it.
+    void initialize();
+    // Initialize and build the graphs of all the environments, so that shortest_path() only searches them.
+    void init_graphs();
     
     private:
     bool initialized;
+    bool use_visibility_graph;
     std::vector<MotionPlannerEnv> islands;
     MotionPlannerEnv outer;
     std::vector<MotionPlannerGraph*> graphs;
     
-    void initialize();
     MotionPlannerGraph* init_graph(int island_idx);
+    void init_voronoi_graph(const MotionPlannerEnv &env, MotionPlannerGraph &graph) const;
+    void init_visibility_graph(const MotionPlannerEnv &env, MotionPlannerGraph &graph) const;
     const MotionPlannerEnv& get_env(int island_idx) const;
 };
 
@@ -4,8 +4,10 @@
 #include "Extruder.hpp"
 #include "Flow.hpp"
 #include "Geometry.hpp"
+#include "PrintGCode.hpp"
 #include "SupportMaterial.hpp"
 #include <algorithm>
+#include <fstream>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -130,6 +132,7 @@ Print::invalidate_state_by_config_options(const std::vector<t_config_option_key>
             || *opt_key == "resolution") {
             osteps.insert(posSlice);
         } else if (*opt_key == "avoid_crossing_perimeters"
+            || *opt_key == "avoid_crossing_perimeters_visibility"
             || *opt_key == "bed_shape"
             || *opt_key == "bed_temperature"
             || *opt_key == "bridge_acceleration"
@@ -159,7 +162,9 @@ Print::invalidate_state_by_config_options(const std::vector<t_config_option_key>
             || *opt_key == "infill_first"
             || *opt_key == "layer_gcode"
             || *opt_key == "min_fan_speed"
+            || *opt_key == "max_extruder_jerk"
             || *opt_key == "max_fan_speed"
+            || *opt_key == "max_jerk"
             || *opt_key == "min_print_speed"
             || *opt_key == "notes"
             || *opt_key == "only_retract_when_crossing_perimeters"
@@ -603,7 +608,7 @@ Print::validate() const
                     Polygons mesh_convex_hulls;
                     for (size_t i = 0; i < this->regions.size(); ++i) {
                         for (std::vector<int>::const_iterator it = object->region_volumes[i].begin(); it != object->region_volumes[i].end(); ++it) {
-                            Polygon hull = object->model_object()->volumes[*it]->mesh.convex_hull();
+                            Polygon hull = object->model_object()->volumes[*it]->its.convex_hull();
                             mesh_convex_hulls.push_back(hull);
                         }
                     }
@@ -1022,4 +1027,30 @@ Print::output_filepath(const std::string &path)
     return path;
 }
 
+// Write the G-code of the whole print into a file.
+void
+Print::export_gcode(const std::string &path)
+{
+    // The G-code is written in many small pieces, let the stream buffer collect them.
+    std::vector<char> buffer(1 << 20);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    out.open(path.c_str());
+    if (! out.is_open())
+        CONFESS("Failed to open %s for writing", path.c_str());
+    this->export_gcode(out);
+    out.close();
+    if (out.fail())
+        CONFESS("Failed to write the G-code to %s", path.c_str());
+}
+
+// Write the G-code of the whole print into a stream.
+void
+Print::export_gcode(std::ostream &out)
+{
+    PrintGCode gcode(*this, out);
+    gcode.output();
+    out.flush();
+}
+
 }
@@ -2,6 +2,7 @@
 #define slic3r_Print_hpp_
 
 #include "libslic3r.h"
+#include <ostream>
 #include <set>
 #include <vector>
 #include <string>
@@ -178,6 +179,10 @@ public:
     void _make_perimeters();
     void _infill();
     void _generate_support_material();
+    // Prepare the motion planners of all the layers for the avoid_crossing_perimeters travel moves.
+    void make_motion_planners();
+    // Release the motion planners once the G-code has been exported.
+    void clear_motion_planners();
 
 private:
     Print* _print;
@@ -187,9 +192,31 @@ private:
     // TODO: call model_object->get_bounding_box() instead of accepting
         // parameter
     PrintObject(Print* print, ModelObject* model_object, const BoundingBoxf3 &modobj_bbox);
-    ~PrintObject() {}
-
-    std::vector<ExPolygons> _slice_region(size_t region_id, const std::vector<float> &z, bool modifier);
+    ~PrintObject();
+
+    // Slicer of a ModelVolume transformed into the coordinate system of this object (the indexed mesh, scaled
+    // shared vertices, facet to edge table, facets indexed by Z). Kept between reslicing, so that
+    // reslicing after a change of the layer heights or of a non-geometric configuration only slices the volume.
+    // It is rebuilt if the volume mesh or the transformation changes.
+    struct VolumeSlicer {
+        VolumeSlicer() : mesh_hash(0), rotation(0.), scaling_factor(1.), slicer(nullptr) {}
+        ~VolumeSlicer() { delete this->slicer; }
+        void update(const IndexedTriangleSet &volume_its, const ModelInstance &instance, const Pointf3 &shift);
+
+        // Hash of the untransformed volume mesh and the transformation of the mesh.
+        size_t              mesh_hash;
+        double              rotation;
+        double              scaling_factor;
+        Pointf3             shift;
+        // Null if the volume mesh is empty.
+        TriangleMeshSlicer *slicer;
+    };
+    std::map<const ModelVolume*, VolumeSlicer*> _volume_slicers;
+
+    // Create or update the slicers of all volumes of the model object.
+    void _update_volume_slicers();
+    std::vector<std::vector<ExPolygons>> _slice_volumes(const std::vector<float> &z) const;
+    ExPolygons _merge_volume_slices(std::vector<std::vector<ExPolygons>> &volume_slices, size_t region_id, size_t layer_id, bool modifier) const;
 };
 
 typedef std::vector<PrintObject*> PrintObjectPtrs;
@@ -259,6 +286,9 @@ public:
     void _make_skirt();
     std::string output_filename();
     std::string output_filepath(const std::string &path);
+    // Write the G-code of the whole print into a file or a stream, replacing the Perl Slic3r::Print::GCode exporter.
+    void export_gcode(const std::string &path);
+    void export_gcode(std::ostream &out);
     
 private:
     void clear_regions();
@@ -15,6 +15,12 @@ PrintConfigDef::PrintConfigDef()
     def->cli = "avoid-crossing-perimeters!";
     def->default_value = new ConfigOptionBool(false);
 
+    def = this->add("avoid_crossing_perimeters_visibility", coBool);
+    def->label = "Travel around the island corners";
+    def->tooltip = "When avoiding the crossing of perimeters, plan the travel moves over the visible corners of the islands instead of over the medial axis of the space between them. The travel moves get shorter, while the G-code generation gets slower on layers with many islands, as the graph of an island is built in a time growing with the square of the number of its concave corners.";
+    def->cli = "avoid-crossing-perimeters-visibility!";
+    def->default_value = new ConfigOptionBool(false);
+
     def = this->add("bed_shape", coPoints);
     def->label = "Bed shape";
     {
@@ -643,6 +649,14 @@ PrintConfigDef::PrintConfigDef()
     def->min = 0;
     def->default_value = new ConfigOptionFloat(0.3);
 
+    def = this->add("max_extruder_jerk", coFloat);
+    def->label = "Extruder jerk";
+    def->tooltip = "This is the maximum instantaneous velocity change of the extruder set in your printer firmware, used to estimate the time of the retractions for the cooling slowdown. Set zero to assume 5 mm/s.";
+    def->sidetext = "mm/s";
+    def->cli = "max-extruder-jerk=f";
+    def->min = 0;
+    def->default_value = new ConfigOptionFloat(0);
+
     def = this->add("max_fan_speed", coInt);
     def->label = "Max";
     def->tooltip = "This setting represents the maximum speed of your fan.";
@@ -652,6 +666,14 @@ PrintConfigDef::PrintConfigDef()
     def->max = 100;
     def->default_value = new ConfigOptionInt(100);
 
+    def = this->add("max_jerk", coFloat);
+    def->label = "Jerk";
+    def->tooltip = "This is the maximum instantaneous velocity change of the XYZ axes set in your printer firmware, used to estimate the layer times for the cooling slowdown. Set zero to assume 20 mm/s.";
+    def->sidetext = "mm/s";
+    def->cli = "max-jerk=f";
+    def->min = 0;
+    def->default_value = new ConfigOptionFloat(0);
+
     def = this->add("max_layer_height", coFloats);
     def->label = "Max";
     def->tooltip = "This is the highest printable layer height for this extruder, used to cap the variable layer height and support layer height. Maximum recommended layer height is 75% of the extrusion width to achieve reasonable inter-layer adhesion. If set to 0, layer height is limited to 75% of the nozzle diameter.";
@@ -387,6 +387,7 @@ class PrintConfig : public GCodeConfig
 {
     public:
     ConfigOptionBool                avoid_crossing_perimeters;
+    ConfigOptionBool                avoid_crossing_perimeters_visibility;
     ConfigOptionPoints              bed_shape;
     ConfigOptionInt                 bed_temperature;
     ConfigOptionFloat               bridge_acceleration;
@@ -412,7 +413,9 @@ class PrintConfig : public GCodeConfig
     ConfigOptionBool                gcode_arcs;
     ConfigOptionFloat               infill_acceleration;
     ConfigOptionBool                infill_first;
+    ConfigOptionFloat               max_extruder_jerk;
     ConfigOptionInt                 max_fan_speed;
+    ConfigOptionFloat               max_jerk;
     ConfigOptionFloats              max_layer_height;
     ConfigOptionInt                 min_fan_speed;
     ConfigOptionFloats              min_layer_height;
@@ -446,6 +449,7 @@ class PrintConfig : public GCodeConfig
 
     virtual ConfigOption* optptr(const t_config_option_key &opt_key, bool create = false) {
         OPT_PTR(avoid_crossing_perimeters);
+        OPT_PTR(avoid_crossing_perimeters_visibility);
         OPT_PTR(bed_shape);
         OPT_PTR(bed_temperature);
         OPT_PTR(bridge_acceleration);
@@ -471,7 +475,9 @@ class PrintConfig : public GCodeConfig
         OPT_PTR(gcode_arcs);
         OPT_PTR(infill_acceleration);
         OPT_PTR(infill_first);
+        OPT_PTR(max_extruder_jerk);
         OPT_PTR(max_fan_speed);
+        OPT_PTR(max_jerk);
         OPT_PTR(max_layer_height);
         OPT_PTR(min_fan_speed);
         OPT_PTR(min_layer_height);
@@ -0,0 +1,859 @@
+#include "PrintGCode.hpp"
+#include "ClipperUtils.hpp"
+#include "Extruder.hpp"
+#include "ExtrusionEntity.hpp"
+#include "ExtrusionEntityCollection.hpp"
+#include "Geometry.hpp"
+#include "GCode/CoolingBuffer.hpp"
+#include "GCode/PressureEqualizer.hpp"
+#include "EdgeGrid.hpp"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+
+#include <tbb/pipeline.h>
+
+namespace Slic3r {
+
+// Does the custom G-code contain a M<code1> or M<code2> command?
+// Case insensitive, like the /M(?:109|104)/i test of the Perl exporter.
+static bool custom_gcode_contains(const std::string &gcode, const char *code1, const char *code2)
+{
+    const size_t len1 = strlen(code1);
+    const size_t len2 = strlen(code2);
+    for (size_t i = 0; i < gcode.size(); ++ i)
+        if (gcode[i] == 'M' || gcode[i] == 'm') {
+            const char *rest = gcode.c_str() + i + 1;
+            if (strncmp(rest, code1, len1) == 0 || strncmp(rest, code2, len2) == 0)
+                return true;
+        }
+    return false;
+}
+
+// Format a number the way Perl stringifies it when it is passed to the placeholder parser.
+static std::string float_to_string(double value)
+{
+    char buf[64];
+    sprintf(buf, "%.15g", value);
+    return buf;
+}
+
+// Is the print_z already in the set, up to EPSILON? Layers of different objects
+// and the support layers may not share the exact same print_z.
+static bool has_print_z(const std::set<coordf_t> &zs, coordf_t print_z)
+{
+    std::set<coordf_t>::const_iterator it = zs.lower_bound(print_z - EPSILON);
+    return it != zs.end() && *it < print_z + EPSILON;
+}
+
+static bool is_solid_infill(const ExtrusionEntity &entity)
+{
+    if (const ExtrusionPath *path = dynamic_cast<const ExtrusionPath*>(&entity))
+        return path->is_solid_infill();
+    if (const ExtrusionMultiPath *multipath = dynamic_cast<const ExtrusionMultiPath*>(&entity))
+        return multipath->is_solid_infill();
+    if (const ExtrusionLoop *loop = dynamic_cast<const ExtrusionLoop*>(&entity))
+        return loop->is_solid_infill();
+    return false;
+}
+
+PrintGCode::PrintGCode(Print &print, std::ostream &out)
+    : _print(print), _config(print.config), _out(out), _cooling_buffer(NULL), _pressure_equalizer(NULL),
+        _brim_done(false), _second_layer_things_done(false), _last_obj(NULL), _last_layer(NULL)
+{
+    // estimate the total number of layer changes
+    // TODO: only do this when M73 is enabled
+    size_t layer_count = 0;
+    for (const PrintObject *object : print.objects)
+        // if sequential printing is not enable, all copies of the same object share the same layer change command(s)
+        layer_count += object->total_layer_count() * (this->_config.complete_objects ? object->copies().size() : 1);
+
+    GCode &gcodegen = this->_gcodegen;
+    gcodegen.placeholder_parser = &print.placeholder_parser;
+    // Tell the G-code generator, how many times the gcodegen.change_layer() will be called.
+    // gcodegen.change_layer() in turn increments the progress bar status.
+    gcodegen.layer_count = layer_count;
+    gcodegen.enable_cooling_markers = true;
+    gcodegen.apply_print_config(this->_config);
+    {
+        std::set<size_t> extruders = print.extruders();
+        gcodegen.set_extruders(std::vector<unsigned int>(extruders.begin(), extruders.end()));
+    }
+
+    // initialize autospeed
+    {
+        // get the minimum cross-section used in the print
+        std::vector<double> mm3_per_mm;
+        for (const PrintObject *object : print.objects) {
+            for (size_t region_id = 0; region_id < print.regions.size(); ++ region_id) {
+                const PrintRegionConfig &region_config = print.regions[region_id]->config;
+                const bool perimeters_autospeed =
+                       region_config.get_abs_value("perimeter_speed") == 0
+                    || region_config.get_abs_value("small_perimeter_speed") == 0
+                    || region_config.get_abs_value("external_perimeter_speed") == 0
+                    || region_config.get_abs_value("bridge_speed") == 0;
+                const bool infill_autospeed =
+                       region_config.get_abs_value("infill_speed") == 0
+                    || region_config.get_abs_value("solid_infill_speed") == 0
+                    || region_config.get_abs_value("top_solid_infill_speed") == 0
+                    || region_config.get_abs_value("bridge_speed") == 0;
+                if (! perimeters_autospeed && ! infill_autospeed)
+                    continue;
+                for (const Layer *layer : object->layers) {
+                    if (region_id >= layer->regions.size())
+                        continue;
+                    const LayerRegion *layerm = layer->regions[region_id];
+                    if (perimeters_autospeed)
+                        mm3_per_mm.push_back(layerm->perimeters.min_mm3_per_mm());
+                    if (infill_autospeed)
+                        mm3_per_mm.push_back(layerm->fills.min_mm3_per_mm());
+                }
+            }
+            if (object->config.get_abs_value("support_material_speed") == 0
+                || object->config.get_abs_value("support_material_interface_speed") == 0) {
+                for (const SupportLayer *layer : object->support_layers) {
+                    mm3_per_mm.push_back(layer->support_fills.min_mm3_per_mm());
+                    mm3_per_mm.push_back(layer->support_interface_fills.min_mm3_per_mm());
+                }
+            }
+        }
+        // filter out 0-width segments
+        double min_mm3_per_mm = std::numeric_limits<double>::max();
+        for (double v : mm3_per_mm)
+            if (v > 0.000001)
+                min_mm3_per_mm = std::min(min_mm3_per_mm, v);
+        if (min_mm3_per_mm != std::numeric_limits<double>::max()) {
+            // In order to honor max_print_speed we need to find a target volumetric
+            // speed that we can use throughout the print. So we define this target
+            // volumetric speed as the volumetric speed produced by printing the
+            // smallest cross-section at the maximum speed: any larger cross-section
+            // will need slower feedrates.
+            double volumetric_speed = min_mm3_per_mm * this->_config.max_print_speed.value;
+            // limit such volumetric speed with max_volumetric_speed if set
+            if (this->_config.max_volumetric_speed.value > 0)
+                volumetric_speed = std::min(volumetric_speed, this->_config.max_volumetric_speed.value);
+            gcodegen.volumetric_speed = volumetric_speed;
+        }
+    }
+
+    this->_cooling_buffer = new CoolingBuffer(gcodegen);
+    if (this->_config.max_volumetric_extrusion_rate_slope_positive.value > 0 ||
+        this->_config.max_volumetric_extrusion_rate_slope_negative.value > 0)
+        this->_pressure_equalizer = new GCodePressureEqualizer(&this->_config);
+    gcodegen.enable_extrusion_role_markers = this->_pressure_equalizer != NULL;
+}
+
+PrintGCode::~PrintGCode()
+{
+    delete this->_cooling_buffer;
+    delete this->_pressure_equalizer;
+}
+
+void
+PrintGCode::output()
+{
+    const PrintConfig &config = this->_config;
+    GCode &gcodegen = this->_gcodegen;
+
+    // Write information on the generator.
+    {
+        time_t now = time(NULL);
+        const struct tm *lt = localtime(&now);
+        this->writef("; generated by Slic3r %s on %04d-%02d-%02d at %02d:%02d:%02d\n\n", SLIC3R_VERSION,
+            lt->tm_year + 1900, lt->tm_mon + 1, lt->tm_mday, lt->tm_hour, lt->tm_min, lt->tm_sec);
+    }
+    // Write notes (content of the Print Settings tab -> Notes)
+    {
+        // Split by any line ending, trailing empty lines are dropped.
+        std::vector<std::string> lines(1);
+        const std::string &notes = config.notes.value;
+        for (size_t i = 0; i < notes.size(); ++ i) {
+            if (notes[i] == '\r' || notes[i] == '\n') {
+                if (notes[i] == '\r' && i + 1 < notes.size() && notes[i + 1] == '\n')
+                    ++ i;
+                lines.push_back(std::string());
+            } else
+                lines.back() += notes[i];
+        }
+        while (! lines.empty() && lines.back().empty())
+            lines.pop_back();
+        for (const std::string &line : lines)
+            this->write("; " + line + "\n");
+        if (! notes.empty() && notes != "0")
+            this->write("\n");
+    }
+    // Write some terse information on the slicing parameters.
+    if (! this->_print.objects.empty()) {
+        const PrintObject &first_object = *this->_print.objects.front();
+        const double layer_height = first_object.config.layer_height.value;
+        for (const PrintRegion *region : this->_print.regions) {
+            this->writef("; external perimeters extrusion width = %.2fmm\n",
+                region->flow(frExternalPerimeter, layer_height, false, false, -1, first_object).width);
+            this->writef("; perimeters extrusion width = %.2fmm\n",
+                region->flow(frPerimeter, layer_height, false, false, -1, first_object).width);
+            this->writef("; infill extrusion width = %.2fmm\n",
+                region->flow(frInfill, layer_height, false, false, -1, first_object).width);
+            this->writef("; solid infill extrusion width = %.2fmm\n",
+                region->flow(frSolidInfill, layer_height, false, false, -1, first_object).width);
+            this->writef("; top infill extrusion width = %.2fmm\n",
+                region->flow(frTopSolidInfill, layer_height, false, false, -1, first_object).width);
+            if (this->_print.has_support_material()) {
+                // We use a bogus layer_height because we use the same flow for all support material layers.
+                // Extruder 0 means the current extruder, its nozzle is looked up like the Perl array index -1.
+                const std::vector<double> &nozzle_diameter = config.nozzle_diameter.values;
+                int extruder = first_object.config.support_material_extruder.value - 1;
+                if (extruder < 0)
+                    extruder += int(nozzle_diameter.size());
+                Flow support_flow = Flow::new_from_config_width(frSupportMaterial,
+                    (first_object.config.support_material_extrusion_width.value > 0) ?
+                        first_object.config.support_material_extrusion_width : first_object.config.extrusion_width,
+                    float((extruder >= 0 && extruder < int(nozzle_diameter.size())) ? nozzle_diameter[extruder] : nozzle_diameter.front()),
+                    float(layer_height), 0.f);
+                this->writef("; support material extrusion width = %.2fmm\n", support_flow.width);
+            }
+            // The Perl exporter looked up first_layer_extrusion_width in the region config, where it does not exist,
+            // so the first layer extrusion width was never reported. Keep the output the same.
+            this->write("\n");
+        }
+    }
+
+    // prepare the helper object for replacing placeholders in custom G-code and output filename
+    this->_print.placeholder_parser.update_timestamp();
+
+    // disable fan
+    if (config.cooling.value && config.disable_fan_first_layers.value)
+        this->write(gcodegen.writer.set_fan(0, true));
+
+    // set bed temperature
+    if (config.first_layer_bed_temperature.value != 0 && ! custom_gcode_contains(config.start_gcode.value, "190", "140"))
+        this->write(gcodegen.writer.set_bed_temperature(config.first_layer_bed_temperature.value, true));
+
+    // set extruder(s) temperature before and after start G-code
+    this->_print_first_layer_temperature(false);
+    this->write(gcodegen.placeholder_parser->process(config.start_gcode.value) + "\n");
+    this->_print_first_layer_temperature(true);
+
+    // set other general things
+    this->write(gcodegen.preamble());
+
+    // initialize a motion planner for object-to-object travel moves
+    if (config.avoid_crossing_perimeters.value) {
+        // compute the offsetted convex hull for each object and repeat it for each copy.
+        Polygons islands_p;
+        for (const PrintObject *object : this->_print.objects) {
+            // discard objects only containing thin walls (offset would fail on an empty polygon)
+            Polygons polygons;
+            for (const Layer *layer : object->layers)
+                for (const ExPolygon &expoly : layer->slices.expolygons)
+                    polygons.push_back(expoly.contour);
+            if (polygons.empty())
+                continue;
+            // translate convex hull for each object copy and append it to the islands array
+            for (const Point &copy : object->_shifted_copies)
+                for (Polygon polygon : polygons) {
+                    polygon.translate(copy);
+                    islands_p.push_back(std::move(polygon));
+                }
+        }
+        gcodegen.avoid_crossing_perimeters.init_external_mp(union_ex(islands_p), config.avoid_crossing_perimeters_visibility.value);
+        // the motion planners of the layers are prepared together with the layer plans, see plan_layer()
+    }
+
+    // calculate wiping points if needed
+    if (config.ooze_prevention.value) {
+        Points skirt_points;
+        for (const ExtrusionEntity *loop : this->_print.skirt.entities)
+            append_to(skirt_points, loop->as_polyline().points);
+        if (! skirt_points.empty()) {
+            Polygon outer_skirt = Geometry::convex_hull(skirt_points);
+            Points skirts;
+            for (size_t extruder_id : this->_print.extruders()) {
+                const Pointf &extruder_offset = config.extruder_offset.get_at(extruder_id);
+                Polygon s(outer_skirt);
+                s.translate(-scale_(extruder_offset.x), -scale_(extruder_offset.y));
+                append_to(skirts, s.points);
+            }
+            Polygon convex_hull = Geometry::convex_hull(skirts);
+            gcodegen.ooze_prevention.enable = true;
+            gcodegen.ooze_prevention.standby_points.clear();
+            for (const Polygon &polygon : offset(Polygons(1, convex_hull), scale_(3.)))
+                append_to(gcodegen.ooze_prevention.standby_points, polygon.equally_spaced_points(scale_(10.)));
+        }
+    }
+
+    // set initial extruder only after custom start G-code
+    {
+        std::set<size_t> extruders = this->_print.extruders();
+        if (! extruders.empty())
+            this->write(gcodegen.set_extruder(*extruders.begin()));
+    }
+
+    // do all objects for each layer
+    if (config.complete_objects.value) {
+        // print objects from the smallest to the tallest to avoid collisions
+        // when moving onto next object starting point
+        std::vector<const PrintObject*> objects(this->_print.objects.begin(), this->_print.objects.end());
+        std::stable_sort(objects.begin(), objects.end(),
+            [](const PrintObject *o1, const PrintObject *o2) { return o1->size.z < o2->size.z; });
+
+        size_t finished_objects = 0;
+        for (const PrintObject *object : objects) {
+            // Order layers by print_z, support layers preceding the object layers.
+            std::vector<Layer*> layers(object->layers.begin(), object->layers.end());
+            layers.insert(layers.end(), object->support_layers.begin(), object->support_layers.end());
+            std::stable_sort(layers.begin(), layers.end(), [](const Layer *l1, const Layer *l2) {
+                return (l1->print_z == l2->print_z) ?
+                    (dynamic_cast<const SupportLayer*>(l1) != NULL && dynamic_cast<const SupportLayer*>(l2) == NULL) :
+                    (l1->print_z < l2->print_z);
+            });
+            for (const Point &copy : object->_shifted_copies) {
+                const Points copies(1, copy);
+                // move to the origin position for the copy we're going to print.
+                // this happens before Z goes down to layer 0 again, so that
+                // no collision happens hopefully.
+                if (finished_objects > 0) {
+                    gcodegen.set_origin(Pointf::new_unscale(copy));
+                    gcodegen.enable_cooling_markers = false;  // we're not filtering these moves through CoolingBuffer
+                    gcodegen.avoid_crossing_perimeters.use_external_mp_once = true;
+                    this->write(gcodegen.retract());
+                    this->write(gcodegen.travel_to(Point(0, 0), erNone, "move to origin position for next object"));
+                    gcodegen.enable_cooling_markers = true;
+                    // disable motion planner when traveling to first object point
+                    gcodegen.avoid_crossing_perimeters.disable_once = true;
+                }
+                std::vector<LayerToPrint> layers_to_print;
+                layers_to_print.reserve(layers.size());
+                for (Layer *layer : layers)
+                    layers_to_print.push_back(LayerToPrint{ layer, &copies });
+                this->process_layers(layers_to_print, [this, &config, &gcodegen, finished_objects](const Layer &layer) {
+                    // if we are printing the bottom layer of an object, and we have already finished
+                    // another one, set first layer temperatures. this happens before the Z move
+                    // is triggered, so machine has more time to reach such temperatures
+                    if (layer.id() == 0 && finished_objects > 0) {
+                        if (config.first_layer_bed_temperature.value != 0)
+                            this->write(gcodegen.writer.set_bed_temperature(config.first_layer_bed_temperature.value));
+                        this->_print_first_layer_temperature(false);
+                    }
+                });
+                this->flush_filters();
+                ++ finished_objects;
+                this->_second_layer_things_done = false;
+            }
+        }
+    } else {
+        // order objects using a nearest neighbor search
+        std::vector<Points::size_type> obj_idx;
+        {
+            Points first_copies;
+            for (const PrintObject *object : this->_print.objects)
+                first_copies.push_back(object->_shifted_copies.front());
+            Geometry::chained_path(first_copies, obj_idx);
+        }
+
+        // sort layers by Z
+        // All extrusion moves with the same top layer height are extruded uninterrupted,
+        // object extrusion moves are performed first, then the support.
+        struct ObjectLayer {
+            Layer       *layer;
+            size_t       object_idx;
+        };
+        std::vector<ObjectLayer> layers;
+        for (size_t object_idx = 0; object_idx < this->_print.objects.size(); ++ object_idx) {
+            const PrintObject *object = this->_print.objects[object_idx];
+            // Collect the object layers by z, support layers first, object layers second.
+            for (SupportLayer *layer : object->support_layers)
+                layers.push_back(ObjectLayer{ layer, object_idx });
+            for (Layer *layer : object->layers)
+                layers.push_back(ObjectLayer{ layer, object_idx });
+        }
+        std::stable_sort(layers.begin(), layers.end(),
+            [](const ObjectLayer &l1, const ObjectLayer &l2) { return l1.layer->print_z < l2.layer->print_z; });
+
+        std::vector<LayerToPrint> layers_to_print;
+        layers_to_print.reserve(layers.size());
+        for (size_t i = 0; i < layers.size();) {
+            // Layers of a single print_z.
+            size_t j = i + 1;
+            while (j < layers.size() && layers[j].layer->print_z - layers[i].layer->print_z < EPSILON)
+                ++ j;
+            for (Points::size_type object_idx : obj_idx)
+                for (size_t k = i; k < j; ++ k)
+                    if (layers[k].object_idx == object_idx)
+                        layers_to_print.push_back(LayerToPrint{ layers[k].layer, &layers[k].layer->object()->_shifted_copies });
+            i = j;
+        }
+        this->process_layers(layers_to_print, [](const Layer &) {});
+        this->flush_filters();
+    }
+
+    // write end commands to file
+    this->write(gcodegen.retract());   // TODO: process this retract through PressureRegulator in order to discharge fully
+    this->write(gcodegen.writer.set_fan(0));
+    this->write(gcodegen.placeholder_parser->process(config.end_gcode.value) + "\n");
+    this->write(gcodegen.writer.update_progress(gcodegen.layer_count, gcodegen.layer_count, true));  // 100%
+    this->write(gcodegen.writer.postamble());
+    this->release_last_layer();
+
+    // get filament stats
+    this->_print.filament_stats.clear();
+    this->_print.total_used_filament    = 0.;
+    this->_print.total_extruded_volume  = 0.;
+    this->_print.total_weight           = 0.;
+    this->_print.total_cost             = 0.;
+    for (const auto &it : gcodegen.writer.extruders) {
+        const Extruder &extruder = it.second;
+        double used_filament   = extruder.used_filament();
+        double extruded_volume = extruder.extruded_volume();
+        double filament_weight = extruded_volume * extruder.filament_density() / 1000;
+        double filament_cost   = filament_weight * (extruder.filament_cost() / 1000);
+        this->_print.filament_stats[extruder.id] += float(used_filament);
+
+        this->writef("; filament used = %.1fmm (%.1fcm3)\n", used_filament, extruded_volume / 1000);
+        if (filament_weight > 0) {
+            this->_print.total_weight += filament_weight;
+            this->writef("; filament used = %.1fg\n", filament_weight);
+            if (filament_cost > 0) {
+                this->_print.total_cost += filament_cost;
+                this->writef("; filament cost = %.1f\n", filament_cost);
+            }
+        }
+        this->_print.total_used_filament   += used_filament;
+        this->_print.total_extruded_volume += extruded_volume;
+    }
+    this->writef("; total filament cost = %.1f\n", this->_print.total_cost);
+    if (this->_cooling_buffer != NULL) {
+        // Sum of the layer times estimated from the moves, after the cooling slow down.
+        // The start / end G-code and the moves between the layers are not accounted for.
+        double print_time = 0.;
+        for (const CoolingBuffer::LayerStats &stats : this->_cooling_buffer->layer_stats())
+            print_time += stats.print_time;
+        int seconds = int(print_time + 0.5);
+        this->writef("; estimated printing time = %dh %dm %ds\n", seconds / 3600, (seconds / 60) % 60, seconds % 60);
+    }
+
+    // append full config
+    this->write("\n");
+    const StaticPrintConfig *configs[] = { &this->_print.config, &this->_print.default_object_config, &this->_print.default_region_config };
+    for (const StaticPrintConfig *cfg : configs) {
+        t_config_option_keys keys = cfg->keys();
+        std::sort(keys.begin(), keys.end());
+        for (const t_config_option_key &opt_key : keys) {
+            const ConfigOptionDef *def = cfg->def->get(opt_key);
+            if (def == NULL || def->shortcut.empty())
+                this->write("; " + opt_key + " = " + cfg->serialize(opt_key) + "\n");
+        }
+    }
+}
+
+void
+PrintGCode::_print_first_layer_temperature(bool wait)
+{
+    if (custom_gcode_contains(this->_config.start_gcode.value, "109", "104"))
+        return;
+    for (size_t extruder_id : this->_print.extruders()) {
+        int temp = this->_config.first_layer_temperature.get_at(extruder_id);
+        if (this->_config.ooze_prevention.value)
+            temp += this->_config.standby_temperature_delta.value;
+        if (temp > 0)
+            this->write(this->_gcodegen.writer.set_temperature(temp, wait, extruder_id));
+    }
+}
+
+// Called per object's layer.
+// First the G-code is collected, then filtered and finally written to the file.
+// Calculate the data of a layer, which do not depend on the state of the G-code generator.
+// Called from worker threads, therefore it shall not touch the G-code generator.
+void
+PrintGCode::plan_layer(LayerPlan &plan) const
+{
+    const Layer &layer = *plan.layer;
+
+    // Distance field of the layer below for the seam placement, see GCode::extrude(ExtrusionLoop).
+    // Support layers do not extrude loops, their distance field is left to be calculated on demand.
+    if (layer.lower_layer != NULL && dynamic_cast<const SupportLayer*>(&layer) == NULL)
+        plan.lower_layer_edge_grid.reset(GCode::calculate_lower_layer_edge_grid(layer));
+
+    // Configuration space and graphs of the travel moves inside the layer. They are released once the G-code generator
+    // changed to the next layer, so that only the motion planners of the layers in flight are kept in memory.
+    if (this->_config.avoid_crossing_perimeters.value)
+        plan.layer->make_motion_planner(this->_config.avoid_crossing_perimeters_visibility.value);
+
+    // The island grouping does not depend on the object copy, support layers have no regions.
+    if (dynamic_cast<const SupportLayer*>(&layer) != NULL)
+        return;
+
+    // We now define a strategy for building perimeters and fills. The separation
+    // between regions doesn't matter in terms of printing order, as we follow
+    // another logic instead:
+    // - we group all extrusions by extruder so that we minimize toolchanges
+    // - we start from the last used extruder
+    // - for each extruder, we group extrusions by island
+    // - for each island, we extrude perimeters first, unless user set the infill_first
+    //   option
+    // (Still, we have to keep track of regions because we need to apply their config)
+
+    // group extrusions by extruder and then by island
+    std::map<unsigned int,std::vector<Island>> &by_extruder = plan.by_extruder;
+    const ExPolygons &slices = layer.slices.expolygons;
+    std::vector<BoundingBox> layer_surface_bboxes;
+    layer_surface_bboxes.reserve(slices.size());
+    for (const ExPolygon &expoly : slices)
+        layer_surface_bboxes.push_back(expoly.contour.bounding_box());
+    // Index of the first slice containing the point, slices.size() if none.
+    auto island_idx = [&slices, &layer_surface_bboxes](const Point &point) {
+        size_t i = 0;
+        for (; i < slices.size(); ++ i) {
+            const BoundingBox &bbox = layer_surface_bboxes[i];
+            if (point.x >= bbox.min.x && point.x < bbox.max.x &&
+                point.y >= bbox.min.y && point.y < bbox.max.y &&
+                slices[i].contour.contains(point))
+                break;
+        }
+        return i;
+    };
+    auto islands_of = [&by_extruder, &slices](unsigned int extruder_id) -> std::vector<Island>& {
+        std::vector<Island> &islands = by_extruder[extruder_id];
+        if (islands.empty())
+            islands.resize(slices.size() + 1);
+        return islands;
+    };
+
+    for (size_t region_id = 0; region_id < this->_print.regions.size(); ++ region_id) {
+        if (region_id >= layer.regions.size() || layer.regions[region_id] == NULL)
+            continue;
+        const LayerRegion *layerm = layer.regions[region_id];
+        const PrintRegion *region = this->_print.regions[region_id];
+
+        // process perimeters
+        {
+            unsigned int extruder_id = region->config.perimeter_extruder.value - 1;
+            for (const ExtrusionEntity *ee : layerm->perimeters.entities) {
+                // perimeter_coll represents the perimeters of a single slice
+                const ExtrusionEntityCollection *perimeter_coll = dynamic_cast<const ExtrusionEntityCollection*>(ee);
+                if (perimeter_coll != NULL && perimeter_coll->entities.empty())
+                    continue;  // this shouldn't happen but first_point() would fail
+                std::vector<const ExtrusionEntity*> &dst = islands_of(extruder_id)[island_idx(ee->first_point())].perimeters[region_id];
+                if (perimeter_coll != NULL)
+                    dst.insert(dst.end(), perimeter_coll->entities.begin(), perimeter_coll->entities.end());
+                else
+                    dst.push_back(ee);
+            }
+        }
+
+        // process infill
+        // layerm->fills is a collection of ExtrusionEntityCollection objects, each one containing
+        // the ExtrusionPath objects of a certain infill "group" (also called "surface"
+        // throughout the code). We can redefine the order of such Collections but we have to
+        // do each one completely at once.
+        for (const ExtrusionEntity *ee : layerm->fills.entities) {
+            const ExtrusionEntityCollection *fill = dynamic_cast<const ExtrusionEntityCollection*>(ee);
+            if (fill == NULL || fill->entities.empty())
+                continue;  // this shouldn't happen but first_point() would fail
+            unsigned int extruder_id = is_solid_infill(*fill->entities.front()) ?
+                region->config.solid_infill_extruder.value - 1 :
+                region->config.infill_extruder.value - 1;
+            islands_of(extruder_id)[island_idx(fill->first_point())].infill[region_id].push_back(ee);
+        }
+    } // for regions
+}
+
+// Generate G-code for the layers in the order given. The layers are streamed through a pipeline:
+// the layer plans are prepared by worker threads, while the G-code of the layers planned already
+// is generated and written by a single serial stage in the original layer order.
+void
+PrintGCode::process_layers(const std::vector<LayerToPrint> &layers, const std::function<void(const Layer&)> &layer_start)
+{
+    // Maximum number of layers being planned or waiting to be processed, limits the memory held by the plans.
+    const size_t max_layers_in_flight = 64;
+    // Plans of the layers in flight, indexed by the layer index. A plan is released once its G-code is written.
+    std::vector<std::unique_ptr<LayerPlan>> plans(layers.size());
+    size_t next_layer = 0;
+    // The layers may be printed again for the next object copy, the workers shall not meet a motion planner being released.
+    this->release_last_layer();
+    tbb::parallel_pipeline(max_layers_in_flight,
+        tbb::make_filter<void, size_t>(tbb::filter::serial_in_order,
+            [&layers, &plans, &next_layer](tbb::flow_control &fc) -> size_t {
+                if (next_layer == layers.size()) {
+                    fc.stop();
+                    return 0;
+                }
+                LayerPlan *plan = new LayerPlan();
+                plan->layer  = layers[next_layer].layer;
+                plan->copies = layers[next_layer].copies;
+                plans[next_layer].reset(plan);
+                return next_layer ++;
+            }) &
+        tbb::make_filter<size_t, size_t>(tbb::filter::parallel,
+            [this, &plans](size_t idx) -> size_t {
+                this->plan_layer(*plans[idx]);
+                return idx;
+            }) &
+        tbb::make_filter<size_t, void>(tbb::filter::serial_in_order,
+            [this, &plans, &layer_start](size_t idx) {
+                layer_start(*plans[idx]->layer);
+                this->process_layer(*plans[idx]);
+                this->release_last_layer();
+                this->_last_layer = plans[idx]->layer;
+                plans[idx].reset();
+            }));
+}
+
+void
+PrintGCode::release_last_layer()
+{
+    if (this->_last_layer != NULL) {
+        this->_last_layer->clear_motion_planner();
+        this->_last_layer = NULL;
+    }
+}
+
+//FIXME If printing multiple objects at once, this incorrectly applies cooling logic to a single object's layer instead
+// of all the objects printed.
+void
+PrintGCode::process_layer(LayerPlan &plan)
+{
+    const Layer &layer = *plan.layer;
+    std::string gcode;
+    GCode &gcodegen = this->_gcodegen;
+    const PrintConfig &config = this->_config;
+    const PrintObject &object = *layer.object();
+    const SupportLayer *support_layer = dynamic_cast<const SupportLayer*>(&layer);
+    gcodegen.config.apply(object.config, true);
+    // The CoolingBuffer estimates the layer time from the moves and formats the marked feedrates.
+    if (this->_cooling_buffer != NULL)
+        this->_cooling_buffer->record_moves();
+
+    if (! this->_second_layer_things_done && layer.id() == 1) {
+        for (const auto &it : gcodegen.writer.extruders) {
+            unsigned int extruder_id = it.first;
+            int temperature = config.temperature.get_at(extruder_id);
+            if (temperature != 0 && temperature != config.first_layer_temperature.get_at(extruder_id))
+                gcode += gcodegen.writer.set_temperature(temperature, false, extruder_id);
+        }
+        if (config.bed_temperature.value != 0 && config.bed_temperature.value != config.first_layer_bed_temperature.value)
+            gcode += gcodegen.writer.set_bed_temperature(config.bed_temperature.value);
+        this->_second_layer_things_done = true;
+    }
+
+    // set new layer - this will change Z and force a retraction if retract_layer_change is enabled
+    if (! config.before_layer_gcode.value.empty()) {
+        PlaceholderParser pp = *gcodegen.placeholder_parser;
+        pp.set("layer_num", gcodegen.layer_index + 1);
+        pp.set("layer_z",   float_to_string(layer.print_z));
+        gcode += pp.process(config.before_layer_gcode.value) + "\n";
+    }
+    // this will increase gcodegen.layer_index, the distance field and the motion planner are handed over to gcodegen
+    gcode += gcodegen.change_layer(layer, plan.lower_layer_edge_grid.release());
+    if (! config.layer_gcode.value.empty()) {
+        PlaceholderParser pp = *gcodegen.placeholder_parser;
+        pp.set("layer_num", gcodegen.layer_index);
+        pp.set("layer_z",   float_to_string(layer.print_z));
+        gcode += pp.process(config.layer_gcode.value) + "\n";
+    }
+
+    // Extrude skirt at the print_z of the raft layers and normal object layers
+    // not at the print_z of the interlaced support material layers.
+    //FIXME this will print the support 1st, skirt 2nd and an object 3rd
+    // if they are at the same print_z, it is not the 1st print layer and the support is printed before object.
+    if (
+        // Not enough skirt layers printed yet
+        (this->_skirt_done.size() < size_t(std::max(0, config.skirt_height.value)) || this->_print.has_infinite_skirt())
+        // This print_z has not been extruded yet
+        && ! has_print_z(this->_skirt_done, layer.print_z)
+        // and this layer is the 1st layer, or it is an object layer, or it is a raft layer.
+        && (layer.id() == 0 || support_layer == NULL || int(layer.id()) < object.config.raft_layers.value)) {
+        gcodegen.set_origin(Pointf(0, 0));
+        gcodegen.avoid_crossing_perimeters.use_external_mp = true;
+        std::vector<unsigned int> extruder_ids;
+        for (const auto &it : gcodegen.writer.extruders)
+            extruder_ids.push_back(it.first);
+        gcode += gcodegen.set_extruder(extruder_ids.front());
+        // skip skirt if we have a large brim
+        if (int(layer.id()) < config.skirt_height.value || this->_print.has_infinite_skirt()) {
+            // adjust flow according to this layer's layer height
+            Flow layer_skirt_flow = this->_print.skirt_flow();
+            layer_skirt_flow.height = float(layer.height);
+            const double mm3_per_mm = layer_skirt_flow.mm3_per_mm();
+            // distribute skirt loops across all extruders
+            const ExtrusionEntitiesPtr &skirt_loops = this->_print.skirt.entities;
+            for (size_t i = 0; i < skirt_loops.size(); ++ i) {
+                // when printing layers > 0 ignore 'min_skirt_length' and
+                // just use the 'skirts' setting; also just use the current extruder
+                if (layer.id() > 0 && int(i) >= config.skirts.value)
+                    break;
+                if (layer.id() == 0)
+                    gcode += gcodegen.set_extruder(extruder_ids[(i / extruder_ids.size()) % extruder_ids.size()]);
+                ExtrusionLoop loop(*dynamic_cast<const ExtrusionLoop*>(skirt_loops[i]));
+                for (ExtrusionPath &path : loop.paths) {
+                    path.height     = float(layer.height);
+                    path.mm3_per_mm = mm3_per_mm;
+                }
+                gcode += gcodegen.extrude(loop, "skirt", object.config.support_material_speed.value);
+            }
+        }
+        this->_skirt_done.insert(layer.print_z);
+        gcodegen.avoid_crossing_perimeters.use_external_mp = false;
+
+        // allow a straight travel move to the first object point if this is the first layer
+        // (but don't in next layers)
+        if (layer.id() == 0)
+            gcodegen.avoid_crossing_perimeters.disable_once = true;
+    }
+
+    // extrude brim
+    if (! this->_brim_done) {
+        gcode += gcodegen.set_extruder(this->_print.regions.front()->config.perimeter_extruder.value - 1);
+        gcodegen.set_origin(Pointf(0, 0));
+        gcodegen.avoid_crossing_perimeters.use_external_mp = true;
+        for (const ExtrusionEntity *loop : this->_print.brim.entities)
+            gcode += gcodegen.extrude(*loop, "brim", object.config.support_material_speed.value);
+        this->_brim_done = true;
+        gcodegen.avoid_crossing_perimeters.use_external_mp = false;
+
+        // allow a straight travel move to the first object point
+        gcodegen.avoid_crossing_perimeters.disable_once = true;
+    }
+
+    for (const Point &copy : *plan.copies) {
+        // when starting a new object, use the external motion planner for the first travel move
+        if (this->_last_obj != &object || ! this->_last_obj_copy.coincides_with(copy))
+            gcodegen.avoid_crossing_perimeters.use_external_mp_once = true;
+        this->_last_obj      = &object;
+        this->_last_obj_copy = copy;
+
+        gcodegen.set_origin(Pointf::new_unscale(copy));
+
+        // extrude support material before other things because it might use a lower Z
+        // and also because we avoid travelling on other things when printing it
+        if (support_layer != NULL) {
+            if (! support_layer->support_interface_fills.entities.empty()) {
+                // Don't change extruder if the extruder is set to 0. Use the current extruder instead.
+                if (object.config.support_material_interface_extruder.value > 0)
+                    gcode += gcodegen.set_extruder(object.config.support_material_interface_extruder.value - 1);
+                ExtrusionEntityCollection chained;
+                support_layer->support_interface_fills.chained_path_from(gcodegen.last_pos(), &chained, false);
+                const double speed = object.config.get_abs_value("support_material_interface_speed");
+                for (const ExtrusionEntity *path : chained.entities)
+                    gcode += gcodegen.extrude(*path, "support material interface", speed);
+            }
+            if (! support_layer->support_fills.entities.empty()) {
+                // Don't change extruder if the extruder is set to 0. Use the current extruder instead.
+                if (object.config.support_material_extruder.value > 0)
+                    gcode += gcodegen.set_extruder(object.config.support_material_extruder.value - 1);
+                ExtrusionEntityCollection chained;
+                support_layer->support_fills.chained_path_from(gcodegen.last_pos(), &chained, false);
+                const double speed = object.config.get_abs_value("support_material_speed");
+                for (const ExtrusionEntity *path : chained.entities)
+                    gcode += gcodegen.extrude(*path, "support material", speed);
+            }
+        }
+
+        // The extrusions have been grouped by extruder and island by plan_layer().
+        const std::map<unsigned int,std::vector<Island>> &by_extruder = plan.by_extruder;
+
+        // tweak extruder ordering to save toolchanges
+        std::vector<unsigned int> extruders;
+        for (const auto &it : by_extruder)
+            extruders.push_back(it.first);
+        if (extruders.size() > 1 && gcodegen.writer.extruder() != NULL) {
+            std::vector<unsigned int>::iterator last = std::find(extruders.begin(), extruders.end(), gcodegen.writer.extruder()->id);
+            if (last != extruders.end())
+                std::rotate(extruders.begin(), last, last + 1);
+        }
+
+        for (unsigned int extruder_id : extruders) {
+            gcode += gcodegen.set_extruder(extruder_id);
+            for (const Island &island : by_extruder.at(extruder_id)) {
+                if (config.infill_first.value) {
+                    gcode += this->_extrude_infill(island.infill);
+                    gcode += this->_extrude_perimeters(island.perimeters);
+                } else {
+                    gcode += this->_extrude_perimeters(island.perimeters);
+                    gcode += this->_extrude_infill(island.infill);
+                }
+            }
+        }
+    } // for object copies
+
+    // apply cooling logic; this may alter speeds
+    if (this->_cooling_buffer != NULL) {
+        // differentiate obj_id between normal layers and support layers
+        char obj_id[64];
+        sprintf(obj_id, "%p%s", (const void*)&object, (support_layer == NULL) ? "" : "support");
+        gcode = this->_cooling_buffer->append(gcode, obj_id, layer.id(), float(layer.print_z));
+    }
+
+    this->write(this->filter(gcode));
+}
+
+// Extrude perimeters: Decide where to put seams (hide or align seams).
+std::string
+PrintGCode::_extrude_perimeters(const std::map<size_t,std::vector<const ExtrusionEntity*>> &by_region)
+{
+    std::string gcode;
+    for (const auto &it : by_region) {
+        this->_gcodegen.config.apply(this->_print.get_region(it.first)->config, true);
+        for (const ExtrusionEntity *ee : it.second)
+            gcode += this->_gcodegen.extrude(*ee, "perimeter", -1);
+    }
+    return gcode;
+}
+
+// Chain the paths hierarchically by a greedy algorithm to minimize a travel distance.
+std::string
+PrintGCode::_extrude_infill(const std::map<size_t,std::vector<const ExtrusionEntity*>> &by_region)
+{
+    std::string gcode;
+    for (const auto &it : by_region) {
+        this->_gcodegen.config.apply(this->_print.get_region(it.first)->config, true);
+        ExtrusionEntityCollection collection;
+        for (const ExtrusionEntity *ee : it.second)
+            collection.append(*ee);
+        ExtrusionEntityCollection chained;
+        collection.chained_path_from(this->_gcodegen.last_pos(), &chained, false);
+        for (const ExtrusionEntity *fill : chained.entities) {
+            if (const ExtrusionEntityCollection *coll = dynamic_cast<const ExtrusionEntityCollection*>(fill)) {
+                ExtrusionEntityCollection chained_fill;
+                coll->chained_path_from(this->_gcodegen.last_pos(), &chained_fill, false);
+                for (const ExtrusionEntity *ee : chained_fill.entities)
+                    gcode += this->_gcodegen.extrude(*ee, "infill", -1);
+            } else
+                gcode += this->_gcodegen.extrude(*fill, "infill", -1);
+        }
+    }
+    return gcode;
+}
+
+void
+PrintGCode::flush_filters()
+{
+    this->write(this->filter(this->_cooling_buffer->flush(), true));
+}
+
+std::string
+PrintGCode::filter(const std::string &gcode, bool flush)
+{
+    // apply pressure equalization if enabled
+    if (this->_pressure_equalizer != NULL) {
+        const char *out = this->_pressure_equalizer->process(gcode.c_str(), flush);
+        return std::string(out, this->_pressure_equalizer->get_output_buffer_length());
+    }
+    return gcode;
+}
+
+void
+PrintGCode::writef(const char *format, ...)
+{
+    char    buf[256];
+    va_list args;
+    va_start(args, format);
+    int     len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len > 0)
+        this->_out.write(buf, std::min<size_t>(len, sizeof(buf) - 1));
+}
+
+}
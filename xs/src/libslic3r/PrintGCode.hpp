@@ -0,0 +1,92 @@
+#ifndef slic3r_PrintGCode_hpp_
+#define slic3r_PrintGCode_hpp_
+
+#include "libslic3r.h"
+#include "GCode.hpp"
+#include "Print.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+
+namespace Slic3r {
+
+class CoolingBuffer;
+class GCodePressureEqualizer;
+namespace EdgeGrid { class Grid; }
+
+// Exporter of a complete Print into a G-code file, a C++ port of the Perl Slic3r::Print::GCode.
+// The layers of all objects are fed through the GCode generator, the CoolingBuffer
+// and the PressureEqualizer and the result is written straight into an output stream.
+// The Perl only post-processors (spiral vase, arc fitting, pressure regulator) are not supported,
+// Slic3r::Print::export_gcode() falls back to the Perl exporter if any of them is enabled.
+class PrintGCode {
+    public:
+    PrintGCode(Print &print, std::ostream &out);
+    ~PrintGCode();
+    // Write the G-code of the whole print. Updates the filament statistics of the print.
+    void output();
+
+    private:
+    // Extrusions of a single island for a single extruder, grouped by region ID.
+    struct Island {
+        std::map<size_t,std::vector<const ExtrusionEntity*>> perimeters;
+        std::map<size_t,std::vector<const ExtrusionEntity*>> infill;
+    };
+
+    // A layer to be extruded together with the object copies to be printed.
+    struct LayerToPrint {
+        Layer        *layer;
+        const Points *copies;
+    };
+
+    // Data of a single layer, which do not depend on the state of the G-code generator.
+    // These are calculated in parallel for the layers ahead, while the G-code of the preceding
+    // layers is being generated. The distance field is handed over to the GCode generator by process_layer(),
+    // the motion planner is stored on the layer, see Layer::make_motion_planner().
+    struct LayerPlan {
+        LayerPlan() : layer(NULL), copies(NULL) {}
+        Layer                                       *layer;
+        const Points                                *copies;
+        // extruder_id => islands indexed by the layer slices, the last island collecting the extrusions outside of all slices
+        std::map<unsigned int,std::vector<Island>>   by_extruder;
+        std::unique_ptr<EdgeGrid::Grid>              lower_layer_edge_grid;
+    };
+
+    Print                  &_print;
+    const PrintConfig      &_config;
+    std::ostream           &_out;
+    GCode                   _gcodegen;
+    CoolingBuffer          *_cooling_buffer;
+    GCodePressureEqualizer *_pressure_equalizer;
+    // print_z of the layers, where the skirt has already been extruded.
+    std::set<coordf_t>      _skirt_done;
+    bool                    _brim_done;
+    bool                    _second_layer_things_done;
+    // Object and its copy extruded last, to use the external motion planner when switching to another copy.
+    const PrintObject      *_last_obj;
+    Point                   _last_obj_copy;
+    // Layer processed last, the G-code generator uses its motion planner until the next layer change.
+    Layer                  *_last_layer;
+
+    void plan_layer(LayerPlan &plan) const;
+    // Generate G-code for a sequence of layers. layer_start is called just before a layer is processed.
+    void process_layers(const std::vector<LayerToPrint> &layers, const std::function<void(const Layer&)> &layer_start);
+    void process_layer(LayerPlan &plan);
+    // Release the motion planner of the layer processed last, once the G-code generator does not use it anymore.
+    void release_last_layer();
+    std::string _extrude_perimeters(const std::map<size_t,std::vector<const ExtrusionEntity*>> &by_region);
+    std::string _extrude_infill(const std::map<size_t,std::vector<const ExtrusionEntity*>> &by_region);
+    void _print_first_layer_temperature(bool wait);
+    void flush_filters();
+    std::string filter(const std::string &gcode, bool flush = false);
+    void write(const std::string &gcode) { this->_out.write(gcode.data(), gcode.size()); }
+    // Write a short printf formatted line.
+    void writef(const char *format, ...);
+};
+
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include "Geometry.hpp"
 #include "SupportMaterial.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <utility>
 #include <boost/log/trivial.hpp>
 
@@ -40,7 +42,7 @@ PrintObject::PrintObject(Print* print, ModelObject* model_object, const Bounding
     {
         // Translate meshes so that our toolpath generation algorithms work with smaller
         // XY coordinates; this translation is an optimization and not strictly required.
-        // A cloned mesh will be aligned to 0 before slicing in _slice_region() since we
+        // A cloned mesh will be aligned to 0 before slicing in _update_volume_slicers() since we
         // don't assume it's already aligned and we don't alter the original position in model.
         // We store the XY translation so that we can place copies correctly in the output G-code
         // (copies are expressed in G-code coordinates and this translation is not publicly exposed).
@@ -57,6 +59,12 @@ PrintObject::PrintObject(Print* print, ModelObject* model_object, const Bounding
     this->layer_height_profile = model_object->layer_height_profile;
 }
 
+PrintObject::~PrintObject()
+{
+    for (auto &it : this->_volume_slicers)
+        delete it.second;
+}
+
 bool
 PrintObject::add_copy(const Pointf &point)
 {
@@ -1083,45 +1091,49 @@ void PrintObject::_slice()
         }
     }
     
-    // Slice all non-modifier volumes.
-    for (size_t region_id = 0; region_id < this->print()->regions.size(); ++ region_id) {
-        BOOST_LOG_TRIVIAL(debug) << "Slicing objects - region " << region_id;
-        std::vector<ExPolygons> expolygons_by_layer = this->_slice_region(region_id, slice_zs, false);
-        BOOST_LOG_TRIVIAL(debug) << "Slicing objects - append slices " << region_id << " start";
-        for (size_t layer_id = 0; layer_id < expolygons_by_layer.size(); ++ layer_id)
-            this->layers[layer_id]->regions[region_id]->slices.append(std::move(expolygons_by_layer[layer_id]), stInternal);
-        BOOST_LOG_TRIVIAL(debug) << "Slicing objects - append slices " << region_id << " end";
-    }
+    // Transform the volume meshes and prepare their slicers, reuse the slicers of the unchanged volumes.
+    this->_update_volume_slicers();
+    size_t num_regions = this->print()->regions.size();
+
+    // Slice each volume once, the volumes in parallel.
+    std::vector<std::vector<ExPolygons>> volume_slices = this->_slice_volumes(slice_zs);
 
-    // Slice all modifier volumes.
-    if (this->print()->regions.size() > 1) {
-        for (size_t region_id = 0; region_id < this->print()->regions.size(); ++ region_id) {
-            BOOST_LOG_TRIVIAL(debug) << "Slicing modifier volumes - region " << region_id;
-            std::vector<ExPolygons> expolygons_by_layer = this->_slice_region(region_id, slice_zs, true);
-            // loop through the other regions and 'steal' the slices belonging to this one
-            BOOST_LOG_TRIVIAL(debug) << "Slicing modifier volumes - stealing " << region_id << " start";
-            for (size_t other_region_id = 0; other_region_id < this->print()->regions.size(); ++ other_region_id) {
-                if (region_id == other_region_id)
+    // Assign the slices to the regions, the layers in parallel. The slices of the non-modifier volumes of a region
+    // are merged first, then the regions 'steal' the parts covered by their modifier volumes from the other regions.
+    BOOST_LOG_TRIVIAL(debug) << "Slicing objects - assigning regions in parallel - start";
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, this->layers.size()),
+        [this, num_regions, &volume_slices](const tbb::blocked_range<size_t>& range) {
+            for (size_t layer_id = range.begin(); layer_id < range.end(); ++ layer_id) {
+                Layer *layer = this->layers[layer_id];
+                for (size_t region_id = 0; region_id < num_regions; ++ region_id)
+                    layer->regions[region_id]->slices.append(
+                        this->_merge_volume_slices(volume_slices, region_id, layer_id, false), stInternal);
+                if (num_regions == 1)
                     continue;
-                for (size_t layer_id = 0; layer_id < expolygons_by_layer.size(); ++ layer_id) {
-                    Layer       *layer = layers[layer_id];
-                    LayerRegion *layerm = layer->regions[region_id];
-                    LayerRegion *other_layerm = layer->regions[other_region_id];
-                    if (layerm == nullptr || other_layerm == nullptr)
-                        continue;
-                    Polygons other_slices = to_polygons(other_layerm->slices);
-                    ExPolygons my_parts = intersection_ex(other_slices, to_polygons(expolygons_by_layer[layer_id]));
-                    if (my_parts.empty())
+                for (size_t region_id = 0; region_id < num_regions; ++ region_id) {
+                    Polygons modifier_slices = to_polygons(this->_merge_volume_slices(volume_slices, region_id, layer_id, true));
+                    if (modifier_slices.empty())
                         continue;
-                    // Remove such parts from original region.
-                    other_layerm->slices.set(diff_ex(other_slices, to_polygons(my_parts)), stInternal);
-                    // Append new parts to our region.
-                    layerm->slices.append(std::move(my_parts), stInternal);
+                    // loop through the other regions and 'steal' the slices belonging to this one
+                    LayerRegion *layerm = layer->regions[region_id];
+                    for (size_t other_region_id = 0; other_region_id < num_regions; ++ other_region_id) {
+                        LayerRegion *other_layerm = layer->regions[other_region_id];
+                        if (region_id == other_region_id || layerm == nullptr || other_layerm == nullptr)
+                            continue;
+                        Polygons other_slices = to_polygons(other_layerm->slices);
+                        ExPolygons my_parts = intersection_ex(other_slices, modifier_slices);
+                        if (my_parts.empty())
+                            continue;
+                        // Remove such parts from original region.
+                        other_layerm->slices.set(diff_ex(other_slices, to_polygons(my_parts)), stInternal);
+                        // Append new parts to our region.
+                        layerm->slices.append(std::move(my_parts), stInternal);
+                    }
                 }
             }
-            BOOST_LOG_TRIVIAL(debug) << "Slicing modifier volumes - stealing " << region_id << " end";
-        }
-    }
+        });
+    BOOST_LOG_TRIVIAL(debug) << "Slicing objects - assigning regions in parallel - end";
     
     BOOST_LOG_TRIVIAL(debug) << "Slicing objects - removing top empty layers";
     while (! this->layers.empty()) {
@@ -1176,33 +1188,118 @@ end:
     BOOST_LOG_TRIVIAL(debug) << "Slicing objects - make_slices in parallel - end";
 }
 
-std::vector<ExPolygons> PrintObject::_slice_region(size_t region_id, const std::vector<float> &z, bool modifier)
+// Hash of the vertices and the faces of a mesh, to detect a change of the mesh of a ModelVolume.
+static size_t volume_mesh_hash(const IndexedTriangleSet &its)
 {
-    std::vector<ExPolygons> layers;
-    assert(region_id < this->region_volumes.size());
-    std::vector<int> &volumes = this->region_volumes[region_id];
-    if (! volumes.empty()) {
-        // Compose mesh.
-        //FIXME better to perform slicing over each volume separately and then to use a Boolean operation to merge them.
-        TriangleMesh mesh;
-        for (std::vector<int>::const_iterator it_volume = volumes.begin(); it_volume != volumes.end(); ++ it_volume) {
-            ModelVolume *volume = this->model_object()->volumes[*it_volume];
-            if (volume->modifier == modifier)
-                mesh.merge(volume->mesh);
-        }
-        if (mesh.stl.stats.number_of_facets > 0) {
-            // transform mesh
-            // we ignore the per-instance transformations currently and only 
-            // consider the first one
-            this->model_object()->instances.front()->transform_mesh(&mesh, true);
-            // align mesh to Z = 0 (it should be already aligned actually) and apply XY shift
-            mesh.translate(- unscale(this->_copies_shift.x), - unscale(this->_copies_shift.y), -this->model_object()->bounding_box().min.z);
-            // perform actual slicing
-            TriangleMeshSlicer mslicer(&mesh);
-            mslicer.slice(z, &layers);
+    // FNV-1a over the 32bit words of the vertex coordinates and of the vertex indices.
+    uint64_t hash = 14695981039346656037ULL;
+    auto hash_words = [&hash](const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char*)data;
+        for (size_t i = 0; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t)) {
+            uint32_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            hash = (hash ^ word) * 1099511628211ULL;
         }
+    };
+    hash_words(its.vertices.data(), its.vertices.size() * sizeof(stl_vertex));
+    hash_words(its.indices.data(), its.indices.size() * sizeof(v_indices_struct));
+    return size_t(hash ^ (uint64_t(its.facets_count()) << 32));
+}
+
+void PrintObject::VolumeSlicer::update(const IndexedTriangleSet &volume_its, const ModelInstance &instance, const Pointf3 &shift)
+{
+    size_t hash = volume_mesh_hash(volume_its);
+    if (this->slicer != nullptr && this->mesh_hash == hash && 
+        this->rotation == instance.rotation && this->scaling_factor == instance.scaling_factor &&
+        this->shift.x == shift.x && this->shift.y == shift.y && this->shift.z == shift.z)
+        // Neither the mesh nor its transformation changed, the slicer is valid.
+        return;
+    delete this->slicer;
+    this->slicer         = nullptr;
+    this->mesh_hash      = hash;
+    this->rotation       = instance.rotation;
+    this->scaling_factor = instance.scaling_factor;
+    this->shift          = shift;
+    IndexedTriangleSet its = volume_its;
+    // we ignore the per-instance transformations currently and only 
+    // consider the first one
+    instance.transform_mesh(&its, true);
+    its.translate(float(shift.x), float(shift.y), float(shift.z));
+    if (! its.empty())
+        this->slicer = new TriangleMeshSlicer(std::move(its));
+}
+
+void PrintObject::_update_volume_slicers()
+{
+    ModelObject *model_object = this->model_object();
+    // Drop the slicers of the deleted volumes.
+    for (auto it = this->_volume_slicers.begin(); it != this->_volume_slicers.end();)
+        if (std::find(model_object->volumes.begin(), model_object->volumes.end(), it->first) == model_object->volumes.end()) {
+            delete it->second;
+            it = this->_volume_slicers.erase(it);
+        } else
+            ++ it;
+    std::vector<std::pair<const ModelVolume*, VolumeSlicer*>> slicers;
+    for (const ModelVolume *volume : model_object->volumes) {
+        VolumeSlicer *&slicer = this->_volume_slicers[volume];
+        if (slicer == nullptr)
+            slicer = new VolumeSlicer();
+        slicers.push_back(std::make_pair(volume, slicer));
     }
-    return layers;
+    // Align the meshes to Z = 0 (they should be already aligned actually) and apply the XY shift.
+    Pointf3 shift(- unscale(this->_copies_shift.x), - unscale(this->_copies_shift.y), - model_object->bounding_box().min.z);
+    const ModelInstance &instance = *model_object->instances.front();
+    BOOST_LOG_TRIVIAL(debug) << "Slicing objects - updating volume slicers in parallel - start";
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, slicers.size()),
+        [&slicers, &instance, &shift](const tbb::blocked_range<size_t>& range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                slicers[i].second->update(slicers[i].first->its, instance, shift);
+        });
+    BOOST_LOG_TRIVIAL(debug) << "Slicing objects - updating volume slicers in parallel - end";
+}
+
+// Slice all volumes with the slicers prepared by _update_volume_slicers(). Indexed by the volume ID,
+// empty for an empty volume.
+std::vector<std::vector<ExPolygons>> PrintObject::_slice_volumes(const std::vector<float> &z) const
+{
+    const ModelVolumePtrs &volumes = this->model_object()->volumes;
+    std::vector<std::vector<ExPolygons>> volume_slices(volumes.size());
+    BOOST_LOG_TRIVIAL(debug) << "Slicing objects - volumes in parallel - start";
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, volumes.size()),
+        [this, &volumes, &z, &volume_slices](const tbb::blocked_range<size_t>& range) {
+            for (size_t volume_id = range.begin(); volume_id < range.end(); ++ volume_id) {
+                auto it_slicer = this->_volume_slicers.find(volumes[volume_id]);
+                assert(it_slicer != this->_volume_slicers.end());
+                if (it_slicer->second->slicer != nullptr)
+                    it_slicer->second->slicer->slice(z, &volume_slices[volume_id]);
+            }
+        });
+    BOOST_LOG_TRIVIAL(debug) << "Slicing objects - volumes in parallel - end";
+    return volume_slices;
+}
+
+// Collect the slices of the modifier or non-modifier volumes of a region at a layer, merge the slices
+// of multiple volumes by a Boolean union. The slices are moved out of volume_slices.
+ExPolygons PrintObject::_merge_volume_slices(std::vector<std::vector<ExPolygons>> &volume_slices, size_t region_id, size_t layer_id, bool modifier) const
+{
+    ExPolygons slices;
+    auto it_region = this->region_volumes.find(region_id);
+    if (it_region == this->region_volumes.end())
+        return slices;
+    size_t num_volumes = 0;
+    for (int volume_id : it_region->second) {
+        if (this->model_object()->volumes[volume_id]->modifier != modifier || volume_slices[volume_id].empty())
+            continue;
+        ExPolygons &volume = volume_slices[volume_id][layer_id];
+        if (slices.empty())
+            slices = std::move(volume);
+        else
+            expolygons_append(slices, std::move(volume));
+        ++ num_volumes;
+    }
+    return (num_volumes > 1) ? union_ex(to_polygons(std::move(slices))) : slices;
 }
 
 std::string PrintObject::_fix_slicing_errors()
@@ -1442,6 +1539,32 @@ void PrintObject::_generate_support_material()
     support_material.generate(*this);
 }
 
+// Prepare the motion planners of the object and support layers for avoid_crossing_perimeters in parallel,
+// so that the G-code export does not calculate their configuration spaces.
+// The motion planners are kept by the layers until clear_motion_planners() is called.
+void PrintObject::make_motion_planners()
+{
+    BOOST_LOG_TRIVIAL(info) << "Preparing the motion planners...";
+    const bool visibility_graph = this->_print->config.avoid_crossing_perimeters_visibility.value;
+    std::vector<Layer*> layers(this->layers.begin(), this->layers.end());
+    layers.insert(layers.end(), this->support_layers.begin(), this->support_layers.end());
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, layers.size()),
+        [&layers, visibility_graph](const tbb::blocked_range<size_t>& range) {
+            for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx)
+                layers[layer_idx]->make_motion_planner(visibility_graph);
+        }
+    );
+}
+
+void PrintObject::clear_motion_planners()
+{
+    for (Layer *layer : this->layers)
+        layer->clear_motion_planner();
+    for (SupportLayer *layer : this->support_layers)
+        layer->clear_motion_planner();
+}
+
 void PrintObject::reset_layer_height_profile()
 {
     // Reset the layer_heigth_profile.
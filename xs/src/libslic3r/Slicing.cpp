@@ -1,3 +1,4 @@
+#include <deque>
 #include <limits>
 
 #include "Slicing.hpp"
@@ -221,11 +222,15 @@ std::vector<coordf_t> layer_height_profile_adaptive(
     const ModelVolumePtrs		&volumes)
 {
     // 1) Initialize the SlicingAdaptive class with the object meshes.
+    // The facets with their normals are rebuilt from the indexed volumes, a deque keeps their addresses stable.
+    std::deque<TriangleMesh> meshes;
     SlicingAdaptive as;
     as.set_slicing_parameters(slicing_params);
     for (ModelVolumePtrs::const_iterator it = volumes.begin(); it != volumes.end(); ++ it)
-        if (! (*it)->modifier)
-            as.add_mesh(&(*it)->mesh);
+        if (! (*it)->modifier) {
+            meshes.emplace_back((*it)->mesh());
+            as.add_mesh(&meshes.back());
+        }
     as.prepare();
 
     // 2) Generate layers using the algorithm of @platsch 
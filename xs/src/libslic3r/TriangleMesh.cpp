@@ -1,6 +1,8 @@
 #include "TriangleMesh.hpp"
 #include "ClipperUtils.hpp"
 #include "Geometry.hpp"
+#include "TriangleMeshRepair.hpp"
+#include "Format/STL.hpp"
 #include <cmath>
 #include <deque>
 #include <queue>
@@ -8,12 +10,20 @@
 #include <vector>
 #include <map>
 #include <utility>
+#include <limits>
 #include <algorithm>
 #include <math.h>
 
 #include <boost/log/trivial.hpp>
 
 #include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/parallel_sort.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SLIC3R_TRIANGLEMESH_SSE2
+#endif
 
 #if 0
     #define DEBUG
@@ -30,6 +40,315 @@
 
 namespace Slic3r {
 
+// Kernels of the mesh transformations and of the bounding box reductions. With SSE2 available, a vertex is held
+// in a single register (x, y, z, 0), the X and Y coordinates are rotated at once and the coordinates are scaled,
+// translated and reduced to the bounding box at once. The floating point operations are the same as admesh's:
+// the rotation in double precision as by stl_rotate_z(), the scaling and the translation in single precision
+// as by stl_scale() and stl_translate_relative(), the normals as by stl_calculate_normal() and stl_normalize_vector(),
+// so the results do not depend on whether the SSE2 or the scalar code path is taken.
+// The scalar kernels are compiled in any case: they are used without SSE2, and with simd = false to test
+// the SSE2 kernels against them.
+#ifdef SLIC3R_TRIANGLEMESH_SSE2
+static inline __m128 vertex_load(const stl_vertex &v)
+{
+    return _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&v.x), _mm_load_ss(&v.z));
+}
+
+static inline void vertex_store(__m128 p, stl_vertex &v)
+{
+    _mm_storel_pi((__m64*)&v.x, p);
+    _mm_store_ss(&v.z, _mm_movehl_ps(p, p));
+}
+
+// Unit normal of a triangle. The products of the single precision edge vectors are exact in double precision.
+static inline void facet_normal(__m128 v0, __m128 v1, __m128 v2, stl_normal &normal)
+{
+    __m128  e1  = _mm_sub_ps(v1, v0);
+    __m128  e2  = _mm_sub_ps(v2, v0);
+    // (e1.y * e2.z, e1.z * e2.x, e1.x * e2.y) rounded to single precision, minus (e1.z * e2.y, e1.x * e2.z, e1.y * e2.x).
+    __m128  a   = _mm_mul_ps(_mm_shuffle_ps(e1, e1, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(e2, e2, _MM_SHUFFLE(3, 1, 0, 2)));
+    __m128  b1  = _mm_shuffle_ps(e1, e1, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128  b2  = _mm_shuffle_ps(e2, e2, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128d nxy = _mm_sub_pd(_mm_cvtps_pd(a), _mm_mul_pd(_mm_cvtps_pd(b1), _mm_cvtps_pd(b2)));
+    __m128d nz  = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)), 
+                             _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(b1, b1)), _mm_cvtps_pd(_mm_movehl_ps(b2, b2))));
+    // Round to single precision, normalize in double precision.
+    nxy = _mm_cvtps_pd(_mm_cvtpd_ps(nxy));
+    nz  = _mm_cvtps_pd(_mm_cvtpd_ps(nz));
+    __m128d sq  = _mm_mul_pd(nxy, nxy);
+    __m128d nz2 = _mm_mul_sd(nz, nz);
+    double  length = _mm_cvtsd_f64(_mm_sqrt_sd(nz2, _mm_add_sd(_mm_add_sd(sq, _mm_unpackhi_pd(sq, sq)), nz2)));
+    if (length < 0.000000000001f) {
+        normal.x = normal.y = normal.z = 0.f;
+        return;
+    }
+    __m128d factor = _mm_set1_pd(1.0 / length);
+    _mm_storel_pi((__m64*)&normal.x, _mm_cvtpd_ps(_mm_mul_pd(nxy, factor)));
+    _mm_store_ss(&normal.z, _mm_cvtpd_ps(_mm_mul_sd(nz, factor)));
+}
+#endif /* SLIC3R_TRIANGLEMESH_SSE2 */
+
+// Running minimum and maximum of the vertex coordinates with the semantics of STL_MIN() / STL_MAX():
+// on equality the later value wins, which only matters for the sign of a zero.
+template<bool SSE2> class VertexMinMax;
+
+template<> class VertexMinMax<false>
+{
+public:
+    VertexMinMax()
+    {
+        m_min.x = m_min.y = m_min.z = std::numeric_limits<float>::infinity();
+        m_max.x = m_max.y = m_max.z = - std::numeric_limits<float>::infinity();
+    }
+
+    void add(const stl_vertex &v)
+    {
+        m_min.x = STL_MIN(m_min.x, v.x);
+        m_min.y = STL_MIN(m_min.y, v.y);
+        m_min.z = STL_MIN(m_min.z, v.z);
+        m_max.x = STL_MAX(m_max.x, v.x);
+        m_max.y = STL_MAX(m_max.y, v.y);
+        m_max.z = STL_MAX(m_max.z, v.z);
+    }
+
+    // Merge with the extents of the vertices following the vertices of this.
+    void merge(const VertexMinMax &rhs)
+    {
+        m_min.x = STL_MIN(m_min.x, rhs.m_min.x);
+        m_min.y = STL_MIN(m_min.y, rhs.m_min.y);
+        m_min.z = STL_MIN(m_min.z, rhs.m_min.z);
+        m_max.x = STL_MAX(m_max.x, rhs.m_max.x);
+        m_max.y = STL_MAX(m_max.y, rhs.m_max.y);
+        m_max.z = STL_MAX(m_max.z, rhs.m_max.z);
+    }
+
+    stl_vertex min() const { return m_min; }
+    stl_vertex max() const { return m_max; }
+
+private:
+    stl_vertex  m_min;
+    stl_vertex  m_max;
+};
+
+#ifdef SLIC3R_TRIANGLEMESH_SSE2
+template<> class VertexMinMax<true>
+{
+public:
+    VertexMinMax() : 
+        m_min(_mm_set1_ps(std::numeric_limits<float>::infinity())),
+        m_max(_mm_set1_ps(- std::numeric_limits<float>::infinity())) {}
+
+    void add(__m128 p)
+    {
+        m_min = _mm_min_ps(m_min, p);
+        m_max = _mm_max_ps(m_max, p);
+    }
+    void add(const stl_vertex &v) { this->add(vertex_load(v)); }
+
+    // Merge with the extents of the vertices following the vertices of this.
+    void merge(const VertexMinMax &rhs)
+    {
+        m_min = _mm_min_ps(m_min, rhs.m_min);
+        m_max = _mm_max_ps(m_max, rhs.m_max);
+    }
+
+    stl_vertex min() const { stl_vertex v; vertex_store(m_min, v); return v; }
+    stl_vertex max() const { stl_vertex v; vertex_store(m_max, v); return v; }
+
+private:
+    __m128      m_min;
+    __m128      m_max;
+};
+#endif /* SLIC3R_TRIANGLEMESH_SSE2 */
+
+// Cosine and sine of an angle in radians as calculated by TriangleMesh::rotate_z(), which used to pass
+// the angle to stl_rotate_z() in degrees.
+static void admesh_rotation(float angle, double &c, double &s)
+{
+    double radian_angle = (float(Slic3r::Geometry::rad2deg(angle)) / 180.0) * M_PI;
+    c = cos(radian_angle);
+    s = sin(radian_angle);
+}
+
+// Parameters of a rotation around the Z axis followed by a uniform scaling and a translation.
+class VertexTransformParams
+{
+public:
+    // The rotation is given by the cosine and sine of the angle.
+    VertexTransformParams(bool rotate, double c, double s, float factor, float dx, float dy, float dz) :
+        m_rotate(rotate), m_translate(dx != 0.f || dy != 0.f || dz != 0.f), 
+        m_c(c), m_s(s), m_factor(factor), m_dx(dx), m_dy(dy), m_dz(dz) {}
+
+    bool rotates() const { return m_rotate; }
+
+protected:
+    bool    m_rotate;
+    // Not translating by a zero vector keeps the sign of zero coordinates as admesh does.
+    bool    m_translate;
+    double  m_c;
+    double  m_s;
+    float   m_factor;
+    float   m_dx;
+    float   m_dy;
+    float   m_dz;
+};
+
+// Rotation around the Z axis followed by a uniform scaling and a translation.
+template<bool SSE2> class VertexTransform;
+
+template<> class VertexTransform<false> : public VertexTransformParams
+{
+public:
+    VertexTransform(const VertexTransformParams &params) : VertexTransformParams(params) {}
+
+    void operator()(stl_vertex &v) const
+    {
+        if (m_rotate)
+            this->rotate(v);
+        this->scale_translate(v);
+    }
+
+    // Add the transformed vertex to the extents, leave the vertex unchanged.
+    void operator()(const stl_vertex &v, VertexMinMax<false> &extents) const
+    {
+        stl_vertex p = v;
+        (*this)(p);
+        extents.add(p);
+    }
+
+    // Transform the vertices of a facet. If rotating, recalculate the facet normal after the rotation
+    // and before the scaling as stl_rotate_z() does, and collect the extents of the rotated vertices.
+    void operator()(stl_facet &facet, VertexMinMax<false> &rotated) const
+    {
+        if (m_rotate) {
+            for (int j = 0; j < 3; ++ j) {
+                this->rotate(facet.vertex[j]);
+                rotated.add(facet.vertex[j]);
+            }
+            float normal[3];
+            stl_calculate_normal(normal, &facet);
+            stl_normalize_vector(normal);
+            facet.normal.x = normal[0];
+            facet.normal.y = normal[1];
+            facet.normal.z = normal[2];
+        }
+        for (int j = 0; j < 3; ++ j)
+            this->scale_translate(facet.vertex[j]);
+    }
+
+private:
+    void rotate(stl_vertex &v) const
+    {
+        double xold = v.x;
+        double yold = v.y;
+        v.x = float(m_c * xold - m_s * yold);
+        v.y = float(m_s * xold + m_c * yold);
+    }
+
+    void scale_translate(stl_vertex &v) const
+    {
+        v.x *= m_factor;
+        v.y *= m_factor;
+        v.z *= m_factor;
+        if (m_translate) {
+            v.x += m_dx;
+            v.y += m_dy;
+            v.z += m_dz;
+        }
+    }
+};
+
+#ifdef SLIC3R_TRIANGLEMESH_SSE2
+template<> class VertexTransform<true> : public VertexTransformParams
+{
+public:
+    VertexTransform(const VertexTransformParams &params) : VertexTransformParams(params) {}
+
+    void operator()(stl_vertex &v) const
+    {
+        __m128 p = vertex_load(v);
+        if (m_rotate)
+            p = this->rotate(p);
+        vertex_store(this->scale_translate(p), v);
+    }
+
+    // Add the transformed vertex to the extents, leave the vertex unchanged.
+    void operator()(const stl_vertex &v, VertexMinMax<true> &extents) const
+    {
+        __m128 p = vertex_load(v);
+        if (m_rotate)
+            p = this->rotate(p);
+        extents.add(this->scale_translate(p));
+    }
+
+    // Transform the vertices of a facet. If rotating, recalculate the facet normal after the rotation
+    // and before the scaling as stl_rotate_z() does, and collect the extents of the rotated vertices.
+    void operator()(stl_facet &facet, VertexMinMax<true> &rotated) const
+    {
+        __m128 v[3] = { vertex_load(facet.vertex[0]), vertex_load(facet.vertex[1]), vertex_load(facet.vertex[2]) };
+        if (m_rotate) {
+            for (int j = 0; j < 3; ++ j) {
+                v[j] = this->rotate(v[j]);
+                rotated.add(v[j]);
+            }
+            facet_normal(v[0], v[1], v[2], facet.normal);
+        }
+        for (int j = 0; j < 3; ++ j)
+            vertex_store(this->scale_translate(v[j]), facet.vertex[j]);
+    }
+
+private:
+    __m128 rotate(__m128 p) const
+    {
+        // (c x - s y, s x - (-c) y), both coordinates at once.
+        __m128d xy = _mm_cvtps_pd(p);
+        __m128d r  = _mm_sub_pd(
+            _mm_mul_pd(_mm_set_pd(m_s, m_c), _mm_unpacklo_pd(xy, xy)), 
+            _mm_mul_pd(_mm_set_pd(- m_c, m_s), _mm_unpackhi_pd(xy, xy)));
+        return _mm_movelh_ps(_mm_cvtpd_ps(r), _mm_movehl_ps(p, p));
+    }
+
+    __m128 scale_translate(__m128 p) const
+    {
+        p = _mm_mul_ps(p, _mm_set1_ps(m_factor));
+        return m_translate ? _mm_add_ps(p, _mm_set_ps(0.f, m_dz, m_dy, m_dx)) : p;
+    }
+};
+
+// The kernels used where the code path is not selected by the caller.
+static const bool kernels_sse2 = true;
+#else
+static const bool kernels_sse2 = false;
+#endif /* SLIC3R_TRIANGLEMESH_SSE2 */
+
+// Extents of a vertex array, reduced in parallel.
+template<bool SSE2>
+static VertexMinMax<SSE2> vertices_min_max(const stl_vertex *vertices, size_t num_vertices)
+{
+    return tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, num_vertices, 16384),
+        VertexMinMax<SSE2>(),
+        [vertices](const tbb::blocked_range<size_t> &range, VertexMinMax<SSE2> mm) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                mm.add(vertices[i]);
+            return mm;
+        },
+        [](VertexMinMax<SSE2> a, const VertexMinMax<SSE2> &b) { a.merge(b); return a; });
+}
+
+// Bounding box of a non-empty set of vertices. A flat bounding box is defined as well.
+template<bool SSE2>
+static BoundingBoxf3 to_bounding_box(const VertexMinMax<SSE2> &mm)
+{
+    stl_vertex min = mm.min();
+    stl_vertex max = mm.max();
+    BoundingBoxf3 bb;
+    bb.min     = Pointf3(min.x, min.y, min.z);
+    bb.max     = Pointf3(max.x, max.y, max.z);
+    bb.defined = true;
+    return bb;
+}
+
 TriangleMesh::TriangleMesh()
     : repaired(false)
 {
@@ -78,6 +397,41 @@ TriangleMesh::TriangleMesh(const Pointf3s &points, const std::vector<Point3>& fa
     stl_get_size(&stl);
 }
 
+TriangleMesh::TriangleMesh(const IndexedTriangleSet &its)
+    : repaired(false)
+{
+    stl_initialize(&this->stl);
+    stl_file &stl = this->stl;
+    stl.error = 0;
+    stl.stats.type = inmemory;
+    stl.stats.number_of_facets = int(its.facets_count());
+    stl.stats.original_num_facets = stl.stats.number_of_facets;
+    stl_allocate(&stl);
+    for (int i = 0; i < stl.stats.number_of_facets; ++ i) {
+        stl_facet &facet = stl.facet_start[i];
+        for (int j = 0; j < 3; ++ j)
+            facet.vertex[j] = its.vertex(i, j);
+        float normal[3];
+        stl_calculate_normal(normal, &facet);
+        stl_normalize_vector(normal);
+        facet.normal.x = normal[0];
+        facet.normal.y = normal[1];
+        facet.normal.z = normal[2];
+        facet.extra[0] = 0;
+        facet.extra[1] = 0;
+    }
+    stl_get_size(&stl);
+    // Keep the indexing, so that the vertices do not need to be welded again.
+    if (stl.stats.number_of_facets > 0) {
+        stl.v_indices = (v_indices_struct*)calloc(stl.stats.number_of_facets, sizeof(v_indices_struct));
+        stl.v_shared  = (stl_vertex*)calloc(its.vertices.size(), sizeof(stl_vertex));
+        std::copy(its.indices.begin(), its.indices.end(), stl.v_indices);
+        std::copy(its.vertices.begin(), its.vertices.end(), stl.v_shared);
+        stl.stats.shared_vertices = int(its.vertices.size());
+        stl.stats.shared_malloced = stl.stats.shared_vertices;
+    }
+}
+
 TriangleMesh::TriangleMesh(const TriangleMesh &other)
     : stl(other.stl), repaired(other.repaired)
 {
@@ -133,8 +487,11 @@ TriangleMesh::~TriangleMesh() {
 }
 
 void
-TriangleMesh::ReadSTLFile(const char* input_file) {
-    stl_open(&stl, input_file);
+TriangleMesh::ReadSTLFile(const char* input_file, bool parallel) {
+    if (parallel)
+        stl_open_parallel(&stl, input_file);
+    else
+        stl_open(&stl, input_file);
 }
 
 void
@@ -150,7 +507,7 @@ TriangleMesh::write_binary(const char* output_file)
 }
 
 void
-TriangleMesh::repair() {
+TriangleMesh::repair(bool parallel) {
     if (this->repaired) return;
     
     // admesh fails when repairing empty meshes
@@ -158,30 +515,7 @@ TriangleMesh::repair() {
 
     BOOST_LOG_TRIVIAL(debug) << "TriangleMesh::repair() started";
     
-    // checking exact
-    stl_check_facets_exact(&stl);
-    stl.stats.facets_w_1_bad_edge = (stl.stats.connected_facets_2_edge - stl.stats.connected_facets_3_edge);
-    stl.stats.facets_w_2_bad_edge = (stl.stats.connected_facets_1_edge - stl.stats.connected_facets_2_edge);
-    stl.stats.facets_w_3_bad_edge = (stl.stats.number_of_facets - stl.stats.connected_facets_1_edge);
-    
-    // checking nearby
-    //int last_edges_fixed = 0;
-    float tolerance = stl.stats.shortest_edge;
-    float increment = stl.stats.bounding_diameter / 10000.0;
-    int iterations = 2;
-    if (stl.stats.connected_facets_3_edge < stl.stats.number_of_facets) {
-        for (int i = 0; i < iterations; i++) {
-            if (stl.stats.connected_facets_3_edge < stl.stats.number_of_facets) {
-                //printf("Checking nearby. Tolerance= %f Iteration=%d of %d...", tolerance, i + 1, iterations);
-                stl_check_facets_nearby(&stl, tolerance);
-                //printf("  Fixed %d edges.\n", stl.stats.edges_fixed - last_edges_fixed);
-                //last_edges_fixed = stl.stats.edges_fixed;
-                tolerance += increment;
-            } else {
-                break;
-            }
-        }
-    }
+    this->check_facets(parallel);
     
     // remove_unconnected
     if (stl.stats.connected_facets_3_edge <  stl.stats.number_of_facets) {
@@ -195,7 +529,10 @@ TriangleMesh::repair() {
     }
     
     // normal_directions
-    stl_fix_normal_directions(&stl);
+    if (parallel)
+        stl_fix_normal_directions_parallel(&stl);
+    else
+        stl_fix_normal_directions(&stl);
     
     // normal_values
     stl_fix_normal_values(&stl);
@@ -211,6 +548,40 @@ TriangleMesh::repair() {
     BOOST_LOG_TRIVIAL(debug) << "TriangleMesh::repair() finished";
 }
 
+void
+TriangleMesh::check_facets(bool parallel) {
+    // checking exact
+    if (parallel)
+        stl_check_facets_exact_parallel(&stl);
+    else
+        stl_check_facets_exact(&stl);
+    stl.stats.facets_w_1_bad_edge = (stl.stats.connected_facets_2_edge - stl.stats.connected_facets_3_edge);
+    stl.stats.facets_w_2_bad_edge = (stl.stats.connected_facets_1_edge - stl.stats.connected_facets_2_edge);
+    stl.stats.facets_w_3_bad_edge = (stl.stats.number_of_facets - stl.stats.connected_facets_1_edge);
+    
+    // checking nearby
+    //int last_edges_fixed = 0;
+    float tolerance = stl.stats.shortest_edge;
+    float increment = stl.stats.bounding_diameter / 10000.0;
+    int iterations = 2;
+    if (stl.stats.connected_facets_3_edge < stl.stats.number_of_facets) {
+        for (int i = 0; i < iterations; i++) {
+            if (stl.stats.connected_facets_3_edge < stl.stats.number_of_facets) {
+                //printf("Checking nearby. Tolerance= %f Iteration=%d of %d...", tolerance, i + 1, iterations);
+                if (parallel)
+                    stl_check_facets_nearby_hashed(&stl, tolerance);
+                else
+                    stl_check_facets_nearby(&stl, tolerance);
+                //printf("  Fixed %d edges.\n", stl.stats.edges_fixed - last_edges_fixed);
+                //last_edges_fixed = stl.stats.edges_fixed;
+                tolerance += increment;
+            } else {
+                break;
+            }
+        }
+    }
+}
+
 void
 TriangleMesh::reset_repair_stats() {
     this->stl.stats.degenerate_facets   = 0;
@@ -241,14 +612,13 @@ TriangleMesh::facets_count() const
 
 void
 TriangleMesh::WriteOBJFile(char* output_file) {
-    stl_generate_shared_vertices(&stl);
+    this->require_shared_vertices();
     stl_write_obj(&stl, output_file);
 }
 
 void TriangleMesh::scale(float factor)
 {
-    stl_scale(&(this->stl), factor);
-    stl_invalidate_shared_vertices(&this->stl);
+    this->rotate_z_scale_translate(0.f, factor, 0.f, 0.f, 0.f);
 }
 
 void TriangleMesh::scale(const Pointf3 &versor)
@@ -265,14 +635,134 @@ void TriangleMesh::translate(float x, float y, float z)
 {
     if (x == 0.f && y == 0.f && z == 0.f)
         return;
-    stl_translate_relative(&(this->stl), x, y, z);
-    stl_invalidate_shared_vertices(&this->stl);
+    this->rotate_z_scale_translate(0.f, 1.f, x, y, z);
+}
+
+// Transform the facets, collect the extents of the rotated vertices before the scaling and the translation.
+template<bool SSE2>
+static void facets_rotate_z_scale_translate(stl_file &stl, const VertexTransformParams &params, stl_vertex &rotated_min, stl_vertex &rotated_max)
+{
+    VertexTransform<SSE2> transform(params);
+    VertexMinMax<SSE2> rotated = tbb::parallel_reduce(
+        tbb::blocked_range<int>(0, stl.stats.number_of_facets, 4096),
+        VertexMinMax<SSE2>(),
+        [&stl, &transform](const tbb::blocked_range<int> &range, VertexMinMax<SSE2> mm) {
+            for (int i = range.begin(); i < range.end(); ++ i)
+                transform(stl.facet_start[i], mm);
+            return mm;
+        },
+        [](VertexMinMax<SSE2> a, const VertexMinMax<SSE2> &b) { a.merge(b); return a; });
+    rotated_min = rotated.min();
+    rotated_max = rotated.max();
+}
+
+void TriangleMesh::rotate_z_scale_translate(float angle, float factor, float x, float y, float z, bool simd)
+{
+    stl_file &stl = this->stl;
+    if (stl.error)
+        return;
+    const bool rotate = angle != 0.f;
+    double c = 1., s = 0.;
+    if (rotate)
+        admesh_rotation(angle, c, s);
+    VertexTransformParams params(rotate, c, s, factor, x, y, z);
+    stl_vertex rotated_min, rotated_max;
+#ifdef SLIC3R_TRIANGLEMESH_SSE2
+    if (simd)
+        facets_rotate_z_scale_translate<true>(stl, params, rotated_min, rotated_max);
+    else
+#endif
+        facets_rotate_z_scale_translate<false>(stl, params, rotated_min, rotated_max);
+
+    // Update the statistics the way the admesh rotation, scaling and translation do.
+    stl_stats &stats = stl.stats;
+    if (rotate && stats.number_of_facets > 0) {
+        // stl_get_size()
+        stats.min = rotated_min;
+        stats.max = rotated_max;
+        stats.size.x = stats.max.x - stats.min.x;
+        stats.size.y = stats.max.y - stats.min.y;
+        stats.size.z = stats.max.z - stats.min.z;
+        stats.bounding_diameter = sqrt(stats.size.x * stats.size.x + stats.size.y * stats.size.y + stats.size.z * stats.size.z);
+    }
+    // stl_scale()
+    stats.min.x *= factor;
+    stats.min.y *= factor;
+    stats.min.z *= factor;
+    stats.max.x *= factor;
+    stats.max.y *= factor;
+    stats.max.z *= factor;
+    stats.size.x *= factor;
+    stats.size.y *= factor;
+    stats.size.z *= factor;
+    if (stats.volume > 0.0)
+        stats.volume *= (factor * factor * factor);
+    // stl_translate_relative()
+    if (x != 0.f || y != 0.f || z != 0.f) {
+        stats.min.x += x;
+        stats.min.y += y;
+        stats.min.z += z;
+        stats.max.x += x;
+        stats.max.y += y;
+        stats.max.z += z;
+    }
+    stl_invalidate_shared_vertices(&stl);
+}
+
+// Bounding box of the vertices transformed by a VertexTransform, reduced in parallel. vertex(i) returns the i-th vertex.
+template<bool SSE2, typename VertexAccessor>
+static BoundingBoxf3 vertices_transformed_bounding_box(const VertexTransformParams &params, size_t num_vertices, VertexAccessor vertex)
+{
+    VertexTransform<SSE2> transform(params);
+    return to_bounding_box(tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, num_vertices, 16384),
+        VertexMinMax<SSE2>(),
+        [&transform, &vertex](const tbb::blocked_range<size_t> &range, VertexMinMax<SSE2> mm) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                transform(vertex(i), mm);
+            return mm;
+        },
+        [](VertexMinMax<SSE2> a, const VertexMinMax<SSE2> &b) { a.merge(b); return a; }));
+}
+
+// Bounding box of the vertices rotated around the Z axis and scaled. The rotation is calculated as by rotate_z(),
+// so that the bounding box is exactly that of the vertices transformed by rotate_z_scale_translate().
+template<typename VertexAccessor>
+static BoundingBoxf3 vertices_transformed_bounding_box(bool simd, double angle, float factor, size_t num_vertices, VertexAccessor vertex)
+{
+    if (num_vertices == 0)
+        return BoundingBoxf3();
+    const bool rotate = float(angle) != 0.f;
+    double c = 1., s = 0.;
+    if (rotate)
+        admesh_rotation(float(angle), c, s);
+    VertexTransformParams params(rotate, c, s, factor, 0.f, 0.f, 0.f);
+#ifdef SLIC3R_TRIANGLEMESH_SSE2
+    if (simd)
+        return vertices_transformed_bounding_box<true>(params, num_vertices, vertex);
+#endif
+    return vertices_transformed_bounding_box<false>(params, num_vertices, vertex);
+}
+
+BoundingBoxf3 TriangleMesh::transformed_bounding_box(double angle, float factor, bool simd) const
+{
+    // The shared vertices, if available, are a sixth of the facet vertices.
+    const stl_file &stl = this->stl;
+    return (stl.v_shared != NULL) ?
+        vertices_transformed_bounding_box(simd, angle, factor, size_t(stl.stats.shared_vertices),
+            [&stl](size_t i) -> const stl_vertex& { return stl.v_shared[i]; }) :
+        vertices_transformed_bounding_box(simd, angle, factor, size_t(stl.stats.number_of_facets) * 3,
+            [&stl](size_t i) -> const stl_vertex& { return stl.facet_start[i / 3].vertex[i % 3]; });
 }
 
 void TriangleMesh::rotate(float angle, const Axis &axis)
 {
     if (angle == 0.f)
         return;
+    if (axis == Z) {
+        this->rotate_z_scale_translate(angle, 1.f, 0.f, 0.f, 0.f);
+        return;
+    }
 
     // admesh uses degrees
     angle = Slic3r::Geometry::rad2deg(angle);
@@ -281,8 +771,6 @@ void TriangleMesh::rotate(float angle, const Axis &axis)
         stl_rotate_x(&(this->stl), angle);
     } else if (axis == Y) {
         stl_rotate_y(&(this->stl), angle);
-    } else if (axis == Z) {
-        stl_rotate_z(&(this->stl), angle);
     }
     stl_invalidate_shared_vertices(&this->stl);
 }
@@ -492,38 +980,91 @@ TriangleMesh::merge(const TriangleMesh &mesh)
     stl_get_size(&this->stl);
 }
 
+// Union of the projections of the facets to the XY plane, scaled. facet_vertex(i, j) returns the j-th vertex of the i-th facet.
+template<typename FacetVertexAccessor>
+static ExPolygons facets_horizontal_projection(int num_facets, FacetVertexAccessor facet_vertex)
+{
+    // the offset factor was tuned using groovemount.stl
+    const float delta = float(0.01 / SCALING_FACTOR);
+    // Offset and merge the projections of blocks of facets in parallel, then merge the blocks pairwise
+    // in a reduction tree, so that no single union operates on all the facets at once.
+    Polygons pp = tbb::parallel_reduce(
+        tbb::blocked_range<int>(0, num_facets, 4096),
+        Polygons(),
+        [&facet_vertex, delta](const tbb::blocked_range<int> &range, Polygons merged) {
+            Polygons pp;
+            pp.reserve(range.size());
+            for (int i = range.begin(); i < range.end(); ++ i) {
+                Polygon p;
+                p.points.resize(3);
+                for (int j = 0; j < 3; ++ j) {
+                    const stl_vertex &v = facet_vertex(i, j);
+                    p.points[j] = Point(v.x / SCALING_FACTOR, v.y / SCALING_FACTOR);
+                }
+                p.make_counter_clockwise();  // do this after scaling, as winding order might change while doing that
+                pp.push_back(p);
+            }
+            // offset() merges the offsetted polygons.
+            pp = offset(pp, delta);
+            return merged.empty() ? pp : union_(merged, pp);
+        },
+        [](const Polygons &pp1, const Polygons &pp2) {
+            return pp1.empty() ? pp2 : pp2.empty() ? pp1 : union_(pp1, pp2);
+        });
+    return union_ex(pp, true);
+}
+
+// Convex hull of the vertices projected to the XY plane, scaled. vertex(i) returns the i-th vertex.
+template<typename VertexAccessor>
+static Polygon vertices_convex_hull(size_t num_vertices, VertexAccessor vertex)
+{
+    // Reduce blocks of vertices to their convex hulls in parallel. The convex hull of the vertices of the partial hulls
+    // is the convex hull of all the vertices, and the monotone chain produces the same polygon for both.
+    auto hull_points = [](Points &pts) {
+        if (pts.size() > 3)
+            pts = Slic3r::Geometry::convex_hull(pts).points;
+    };
+    Points pp = tbb::parallel_reduce(
+        tbb::blocked_range<size_t>(0, num_vertices, 16384),
+        Points(),
+        [&vertex, &hull_points](const tbb::blocked_range<size_t> &range, Points hull) {
+            Points pp;
+            pp.reserve(range.size() + hull.size());
+            for (size_t i = range.begin(); i < range.end(); ++ i) {
+                const stl_vertex &v = vertex(i);
+                pp.push_back(Point(v.x / SCALING_FACTOR, v.y / SCALING_FACTOR));
+            }
+            pp.insert(pp.end(), hull.begin(), hull.end());
+            hull_points(pp);
+            return pp;
+        },
+        [&hull_points](Points pp1, const Points &pp2) {
+            pp1.insert(pp1.end(), pp2.begin(), pp2.end());
+            hull_points(pp1);
+            return pp1;
+        });
+    return (pp.size() < 3) ? Polygon(pp) : Slic3r::Geometry::convex_hull(pp);
+}
+
 /* this will return scaled ExPolygons */
 ExPolygons
 TriangleMesh::horizontal_projection() const
 {
-    Polygons pp;
-    pp.reserve(this->stl.stats.number_of_facets);
-    for (int i = 0; i < this->stl.stats.number_of_facets; i++) {
-        stl_facet* facet = &this->stl.facet_start[i];
-        Polygon p;
-        p.points.resize(3);
-        p.points[0] = Point(facet->vertex[0].x / SCALING_FACTOR, facet->vertex[0].y / SCALING_FACTOR);
-        p.points[1] = Point(facet->vertex[1].x / SCALING_FACTOR, facet->vertex[1].y / SCALING_FACTOR);
-        p.points[2] = Point(facet->vertex[2].x / SCALING_FACTOR, facet->vertex[2].y / SCALING_FACTOR);
-        p.make_counter_clockwise();  // do this after scaling, as winding order might change while doing that
-        pp.push_back(p);
-    }
-    
-    // the offset factor was tuned using groovemount.stl
-    return union_ex(offset(pp, 0.01 / SCALING_FACTOR), true);
+    const stl_file &stl = this->stl;
+    return facets_horizontal_projection(stl.stats.number_of_facets,
+        [&stl](int i, int j) -> const stl_vertex& { return stl.facet_start[i].vertex[j]; });
 }
 
 Polygon
-TriangleMesh::convex_hull()
+TriangleMesh::convex_hull() const
 {
-    this->require_shared_vertices();
-    Points pp;
-    pp.reserve(this->stl.stats.shared_vertices);
-    for (int i = 0; i < this->stl.stats.shared_vertices; i++) {
-        stl_vertex* v = &this->stl.v_shared[i];
-        pp.push_back(Point(v->x / SCALING_FACTOR, v->y / SCALING_FACTOR));
-    }
-    return Slic3r::Geometry::convex_hull(pp);
+    // Use the shared vertices if available, otherwise the facet vertices, so that the vertices do not need to be welded.
+    const stl_file &stl = this->stl;
+    return (stl.v_shared != NULL) ?
+        vertices_convex_hull(size_t(stl.stats.shared_vertices),
+            [&stl](size_t i) -> const stl_vertex& { return stl.v_shared[i]; }) :
+        vertices_convex_hull(size_t(stl.stats.number_of_facets) * 3,
+            [&stl](size_t i) -> const stl_vertex& { return stl.facet_start[i / 3].vertex[i % 3]; });
 }
 
 BoundingBoxf3
@@ -539,28 +1080,399 @@ TriangleMesh::bounding_box() const
     return bb;
 }
 
+// Hash of the vertex coordinates, consistent with the comparison of the coordinates as floats: -0 hashes as +0.
+static inline uint64_t vertex_hash(const stl_vertex &v)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const float *c = &v.x; c != &v.x + 3; ++ c) {
+        uint32_t bits = 0;
+        if (*c != 0.f)
+            memcpy(&bits, c, sizeof(bits));
+        hash = (hash ^ bits) * 1099511628211ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+static inline bool vertex_equal(const stl_vertex &a, const stl_vertex &b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// Replacement of admesh stl_generate_shared_vertices(), which walks the fans of the neighbor facets
+// and therefore requires the mesh to be repaired. Here the vertices with equal coordinates are welded:
+// the vertices are distributed into buckets by a hash of their coordinates using a counting sort,
+// each vertex is then matched against the preceding vertices of its bucket in parallel.
+// The shared vertices are numbered in the order of their first reference by the facets as by admesh,
+// therefore the result is the same as admesh's for a manifold mesh, while a vertex shared by two fans
+// of a non-manifold mesh is welded into one.
+static void stl_generate_shared_vertices_welded(stl_file *stl)
+{
+    if (stl->error)
+        return;
+    stl_invalidate_shared_vertices(stl);
+
+    const size_t num_vertices = size_t(stl->stats.number_of_facets) * 3;
+    auto         vertex       = [stl](size_t i) -> const stl_vertex& { return stl->facet_start[i / 3].vertex[i % 3]; };
+
+    size_t num_buckets = 1;
+    while (num_buckets < num_vertices)
+        num_buckets <<= 1;
+    std::vector<uint32_t> vertex_bucket(num_vertices);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_vertices),
+        [&vertex, &vertex_bucket, num_buckets](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                vertex_bucket[i] = uint32_t(vertex_hash(vertex(i)) & (num_buckets - 1));
+        });
+    std::vector<uint32_t> bucket_start(num_buckets + 1, 0);
+    for (uint32_t bucket : vertex_bucket)
+        ++ bucket_start[bucket + 1];
+    for (size_t i = 1; i <= num_buckets; ++ i)
+        bucket_start[i] += bucket_start[i - 1];
+    std::vector<uint32_t> bucket_vertices(num_vertices);
+    {
+        std::vector<uint32_t> bucket_end(bucket_start.begin(), bucket_start.end() - 1);
+        for (size_t i = 0; i < num_vertices; ++ i)
+            bucket_vertices[bucket_end[vertex_bucket[i]] ++] = uint32_t(i);
+    }
+
+    // For each vertex, find the first vertex with the same coordinates. A bucket is sorted by the vertex index.
+    std::vector<uint32_t> &first_equal = vertex_bucket;
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_buckets),
+        [&vertex, &bucket_start, &bucket_vertices, &first_equal](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                for (uint32_t j = bucket_start[i]; j < bucket_start[i + 1]; ++ j) {
+                    uint32_t idx = bucket_vertices[j];
+                    first_equal[idx] = idx;
+                    for (uint32_t k = bucket_start[i]; k < j; ++ k)
+                        if (vertex_equal(vertex(bucket_vertices[k]), vertex(idx))) {
+                            first_equal[idx] = first_equal[bucket_vertices[k]];
+                            break;
+                        }
+                }
+        });
+
+    // Number the shared vertices and fill in v_shared and v_indices in a single pass.
+    int num_shared = 0;
+    for (size_t i = 0; i < num_vertices; ++ i)
+        num_shared += first_equal[i] == i;
+    stl->v_indices = (v_indices_struct*)calloc(stl->stats.number_of_facets, sizeof(v_indices_struct));
+    stl->v_shared  = (stl_vertex*)calloc(num_shared, sizeof(stl_vertex));
+    num_shared = 0;
+    for (size_t i = 0; i < num_vertices; ++ i) {
+        int &idx = stl->v_indices[i / 3].vertex[i % 3];
+        if (first_equal[i] == i) {
+            idx = num_shared;
+            stl->v_shared[num_shared ++] = vertex(i);
+        } else
+            idx = stl->v_indices[first_equal[i] / 3].vertex[first_equal[i] % 3];
+    }
+    stl->stats.shared_vertices = num_shared;
+    stl->stats.shared_malloced = num_shared;
+}
+
+// Generate stl->v_shared and stl->v_indices, which are expected to be null.
+static void generate_shared_vertices(stl_file *stl, bool repaired)
+{
+    if (repaired) {
+        // Walking the fans of the neighbors computed by the repair is an order of magnitude faster than welding.
+        BOOST_LOG_TRIVIAL(trace) << "TriangleMeshSlicer::require_shared_vertices - stl_generate_shared_vertices";
+        stl_generate_shared_vertices(stl);
+    } else {
+        BOOST_LOG_TRIVIAL(trace) << "TriangleMeshSlicer::require_shared_vertices - stl_generate_shared_vertices_welded";
+        stl_generate_shared_vertices_welded(stl);
+    }
+}
+
 void
 TriangleMesh::require_shared_vertices()
 {
     BOOST_LOG_TRIVIAL(trace) << "TriangleMeshSlicer::require_shared_vertices - start";
-    if (!this->repaired) 
+    if (! this->repaired)
         this->repair();
+    if (this->stl.v_shared == NULL)
+        generate_shared_vertices(&this->stl, this->repaired);
+    BOOST_LOG_TRIVIAL(trace) << "TriangleMeshSlicer::require_shared_vertices - end";
+}
+
+void
+TriangleMesh::generate_shared_vertices_welded()
+{
+    stl_generate_shared_vertices_welded(&this->stl);
+}
+
+IndexedTriangleSet TriangleMesh::indexed_triangle_set(bool keep_degenerate) const
+{
+    IndexedTriangleSet its;
+    if (this->stl.stats.number_of_facets == 0)
+        return its;
+    stl_file stl = this->stl;
+    if (stl.v_shared == NULL) {
+        // Generate the shared vertices into a shallow copy of the stl_file referencing the facets and the neighbors
+        // of this mesh. Both generators only fill in v_shared, v_indices and the shared vertex statistics.
+        stl.v_indices = NULL;
+        stl.v_shared  = NULL;
+        generate_shared_vertices(&stl, this->repaired);
+    }
+    its.vertices.assign(stl.v_shared, stl.v_shared + stl.stats.shared_vertices);
+    // Leave out the degenerate facets, which have two equal vertices, mostly left by the welding of an unrepaired mesh.
+    its.indices.reserve(stl.stats.number_of_facets);
+    for (const v_indices_struct *facet = stl.v_indices; facet != stl.v_indices + stl.stats.number_of_facets; ++ facet)
+        if (keep_degenerate || (facet->vertex[0] != facet->vertex[1] && facet->vertex[1] != facet->vertex[2] && facet->vertex[2] != facet->vertex[0]))
+            its.indices.push_back(*facet);
     if (this->stl.v_shared == NULL) {
-        BOOST_LOG_TRIVIAL(trace) << "TriangleMeshSlicer::require_shared_vertices - stl_generate_shared_vertices";
-        stl_generate_shared_vertices(&(this->stl));
+        free(stl.v_indices);
+        free(stl.v_shared);
+    }
+    return its;
+}
+
+float IndexedTriangleSet::normal_z(size_t facet_idx) const
+{
+    // Same as the Z component of stl_calculate_normal(), so that the sign matches the normals of the admesh facets.
+    const stl_vertex &v0 = this->vertex(facet_idx, 0);
+    const stl_vertex &v1 = this->vertex(facet_idx, 1);
+    const stl_vertex &v2 = this->vertex(facet_idx, 2);
+    float v1x = v1.x - v0.x;
+    float v1y = v1.y - v0.y;
+    float v2x = v2.x - v0.x;
+    float v2y = v2.y - v0.y;
+    return (float)((double)v1x * (double)v2y) - ((double)v1y * (double)v2x);
+}
+
+BoundingBoxf3 IndexedTriangleSet::bounding_box() const
+{
+    return this->vertices.empty() ? BoundingBoxf3() : to_bounding_box(vertices_min_max<kernels_sse2>(this->vertices.data(), this->vertices.size()));
+}
+
+void IndexedTriangleSet::rotate_z_scale_translate(float angle, float factor, float x, float y, float z)
+{
+    double c = 1., s = 0.;
+    if (angle != 0.f)
+        admesh_rotation(angle, c, s);
+    VertexTransform<kernels_sse2> transform(VertexTransformParams(angle != 0.f, c, s, factor, x, y, z));
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, this->vertices.size(), 16384),
+        [this, &transform](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                transform(this->vertices[i]);
+        });
+}
+
+void IndexedTriangleSet::translate(float x, float y, float z)
+{
+    if (x == 0.f && y == 0.f && z == 0.f)
+        return;
+    this->rotate_z_scale_translate(0.f, 1.f, x, y, z);
+}
+
+void IndexedTriangleSet::scale(float factor)
+{
+    this->rotate_z_scale_translate(0.f, factor, 0.f, 0.f, 0.f);
+}
+
+void IndexedTriangleSet::scale(const Pointf3 &versor)
+{
+    float fversor[3] = { float(versor.x), float(versor.y), float(versor.z) };
+    for (stl_vertex &v : this->vertices) {
+        v.x *= fversor[0];
+        v.y *= fversor[1];
+        v.z *= fversor[2];
+    }
+}
+
+void IndexedTriangleSet::rotate_z(float angle)
+{
+    if (angle == 0.f)
+        return;
+    this->rotate_z_scale_translate(angle, 1.f, 0.f, 0.f, 0.f);
+}
+
+void IndexedTriangleSet::rotate(float angle, const Axis &axis)
+{
+    if (angle == 0.f)
+        return;
+    if (axis == Z) {
+        this->rotate_z(angle);
+        return;
+    }
+    // Same arithmetic as stl_rotate_x() and stl_rotate_y().
+    double c, s;
+    admesh_rotation(angle, c, s);
+    for (stl_vertex &v : this->vertices) {
+        float &a = (axis == X) ? v.y : v.z;
+        float &b = (axis == X) ? v.z : v.x;
+        double aold = a;
+        double bold = b;
+        a = float(c * aold - s * bold);
+        b = float(s * aold + c * bold);
     }
-    BOOST_LOG_TRIVIAL(trace) << "TriangleMeshSlicer::require_shared_vertices - end";
 }
 
+void IndexedTriangleSet::mirror(const Axis &axis)
+{
+    for (stl_vertex &v : this->vertices) {
+        float &coord = (axis == X) ? v.x : (axis == Y) ? v.y : v.z;
+        coord *= -1.f;
+    }
+    // Keep the facets oriented outwards, as stl_reverse_all_facets() does after the admesh mirroring.
+    for (v_indices_struct &facet : this->indices)
+        std::swap(facet.vertex[0], facet.vertex[1]);
+}
+
+BoundingBoxf3 IndexedTriangleSet::transformed_bounding_box(double angle, float factor) const
+{
+    return vertices_transformed_bounding_box(kernels_sse2, angle, factor, this->vertices.size(),
+        [this](size_t i) -> const stl_vertex& { return this->vertices[i]; });
+}
+
+ExPolygons IndexedTriangleSet::horizontal_projection() const
+{
+    return facets_horizontal_projection(int(this->indices.size()),
+        [this](int i, int j) -> const stl_vertex& { return this->vertex(i, j); });
+}
+
+Polygon IndexedTriangleSet::convex_hull() const
+{
+    return vertices_convex_hull(this->vertices.size(),
+        [this](size_t i) -> const stl_vertex& { return this->vertices[i]; });
+}
+
+void FacetZIndex::build(const IndexedTriangleSet &its)
+{
+    this->clear();
+    const size_t num_facets = its.facets_count();
+    if (num_facets == 0)
+        return;
+    m_min_z.assign(num_facets, 0.f);
+    m_max_z.assign(num_facets, 0.f);
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_facets),
+        [this, &its](const tbb::blocked_range<size_t>& range) {
+            for (size_t facet_idx = range.begin(); facet_idx < range.end(); ++ facet_idx) {
+                float z0 = its.vertex(facet_idx, 0).z;
+                float z1 = its.vertex(facet_idx, 1).z;
+                float z2 = its.vertex(facet_idx, 2).z;
+                m_min_z[facet_idx] = fminf(z0, fminf(z1, z2));
+                m_max_z[facet_idx] = fmaxf(z0, fmaxf(z1, z2));
+            }
+        });
+    m_min_z_sorted = m_min_z;
+    m_max_z_sorted = m_max_z;
+    tbb::parallel_sort(m_min_z_sorted.begin(), m_min_z_sorted.end());
+    tbb::parallel_sort(m_max_z_sorted.begin(), m_max_z_sorted.end());
+    std::vector<int> facets(num_facets, 0);
+    for (size_t facet_idx = 0; facet_idx < num_facets; ++ facet_idx)
+        facets[facet_idx] = int(facet_idx);
+    m_by_min_z.reserve(num_facets);
+    m_by_max_z.reserve(num_facets);
+    this->build_node(facets.data(), facets.data() + num_facets);
+}
+
+void FacetZIndex::clear()
+{
+    m_nodes.clear();
+    m_by_min_z.clear();
+    m_by_max_z.clear();
+    m_min_z.clear();
+    m_max_z.clear();
+    m_min_z_sorted.clear();
+    m_max_z_sorted.clear();
+}
+
+int FacetZIndex::build_node(int *begin, int *end)
+{
+    // Split at the median of the facet centers, so that both subtrees contain at most half of the facets.
+    // The median facet contains the center, therefore each node stores at least one facet.
+    int *median = begin + (end - begin) / 2;
+    std::nth_element(begin, median, end, [this](int f1, int f2)
+        { return m_min_z[f1] + m_max_z[f1] < m_min_z[f2] + m_max_z[f2]; });
+    const float center = 0.5f * (m_min_z[*median] + m_max_z[*median]);
+    // Partition the facets to those below the center, containing the center and above the center.
+    int *it_contains = std::partition(begin, end, [this, center](int f) { return m_max_z[f] < center; });
+    int *it_above    = std::partition(it_contains, end, [this, center](int f) { return m_min_z[f] <= center; });
+    assert(it_contains < it_above);
+    Node node;
+    node.center = center;
+    node.begin  = m_by_min_z.size();
+    m_by_min_z.insert(m_by_min_z.end(), it_contains, it_above);
+    m_by_max_z.insert(m_by_max_z.end(), it_contains, it_above);
+    node.end    = m_by_min_z.size();
+    std::sort(m_by_min_z.begin() + node.begin, m_by_min_z.end(), [this](int f1, int f2) { return m_min_z[f1] < m_min_z[f2]; });
+    std::sort(m_by_max_z.begin() + node.begin, m_by_max_z.end(), [this](int f1, int f2) { return m_max_z[f1] > m_max_z[f2]; });
+    int node_idx = int(m_nodes.size());
+    m_nodes.push_back(node);
+    int left  = (begin < it_contains) ? this->build_node(begin, it_contains) : -1;
+    int right = (it_above < end) ? this->build_node(it_above, end) : -1;
+    m_nodes[node_idx].left  = left;
+    m_nodes[node_idx].right = right;
+    return node_idx;
+}
+
+size_t FacetZIndex::count_facets(float z_min, float z_max) const
+{
+    // Facets completely above z_max and completely below z_min are disjoint sets.
+    size_t above = m_min_z_sorted.end() - std::upper_bound(m_min_z_sorted.begin(), m_min_z_sorted.end(), z_max);
+    size_t below = std::lower_bound(m_max_z_sorted.begin(), m_max_z_sorted.end(), z_min) - m_max_z_sorted.begin();
+    return m_min_z.size() - above - below;
+}
+
+void FacetZIndex::stab(float z, float z_min, std::vector<int> &out) const
+{
+    for (int node_idx = m_nodes.empty() ? -1 : 0; node_idx != -1;) {
+        const Node &node = m_nodes[node_idx];
+        if (z < node.center) {
+            // All facets of this node end above z. Report those starting at or below z.
+            for (size_t i = node.begin; i < node.end && m_min_z[m_by_min_z[i]] <= z; ++ i)
+                if (m_min_z[m_by_min_z[i]] > z_min)
+                    out.push_back(m_by_min_z[i]);
+            node_idx = node.left;
+        } else {
+            // All facets of this node start at or below z. Report those ending at or above z.
+            for (size_t i = node.begin; i < node.end && m_max_z[m_by_max_z[i]] >= z; ++ i)
+                if (m_min_z[m_by_max_z[i]] > z_min)
+                    out.push_back(m_by_max_z[i]);
+            node_idx = node.right;
+        }
+    }
+}
+
+void FacetZIndex::facets_crossed(const std::vector<float> &z, std::vector<int> &out) const
+{
+    out.clear();
+    // A facet crossed by a plane and starting at or below the previous plane is crossed by the previous plane as well,
+    // therefore each facet is reported just once, by the lowest plane crossing it.
+    float z_prev = - std::numeric_limits<float>::max();
+    for (float slice_z : z) {
+        this->stab(slice_z, z_prev, out);
+        z_prev = slice_z;
+    }
+    std::sort(out.begin(), out.end());
+}
 
 TriangleMeshSlicer::TriangleMeshSlicer(TriangleMesh* _mesh) : 
-    mesh(_mesh)
+    band_facets(1 << 18), mesh(_mesh)
 {
     _mesh->require_shared_vertices();
-    facets_edges.assign(_mesh->stl.stats.number_of_facets * 3, -1);
-    v_scaled_shared.assign(_mesh->stl.v_shared, _mesh->stl.v_shared + _mesh->stl.stats.shared_vertices);
+    // cut() addresses the facets of its by the indices of the stl facets.
+    this->its = _mesh->indexed_triangle_set(true);
+    this->_init();
+}
+
+TriangleMeshSlicer::TriangleMeshSlicer(IndexedTriangleSet &&its) : 
+    band_facets(1 << 18), mesh(nullptr), its(std::move(its))
+{
+    this->_init();
+}
+
+void TriangleMeshSlicer::_init()
+{
+    const int num_facets = int(this->its.facets_count());
+    facets_edges.assign(num_facets * 3, -1);
+    v_scaled_shared = this->its.vertices;
     // Scale the copied vertices.
-    for (int i = 0; i < this->mesh->stl.stats.shared_vertices; ++ i) {
+    for (size_t i = 0; i < this->v_scaled_shared.size(); ++ i) {
         this->v_scaled_shared[i].x /= float(SCALING_FACTOR);
         this->v_scaled_shared[i].y /= float(SCALING_FACTOR);
         this->v_scaled_shared[i].z /= float(SCALING_FACTOR);
@@ -580,12 +1492,12 @@ TriangleMeshSlicer::TriangleMeshSlicer(TriangleMesh* _mesh) :
         bool operator<(const EdgeToFace &other) const { return vertex_low < other.vertex_low || (vertex_low == other.vertex_low && vertex_high < other.vertex_high); }
     };
     std::vector<EdgeToFace> edges_map;
-    edges_map.assign(this->mesh->stl.stats.number_of_facets * 3, EdgeToFace());
-    for (int facet_idx = 0; facet_idx < this->mesh->stl.stats.number_of_facets; ++ facet_idx)
+    edges_map.assign(num_facets * 3, EdgeToFace());
+    for (int facet_idx = 0; facet_idx < num_facets; ++ facet_idx)
         for (int i = 0; i < 3; ++ i) {
             EdgeToFace &e2f = edges_map[facet_idx*3+i];
-            e2f.vertex_low  = this->mesh->stl.v_indices[facet_idx].vertex[i];
-            e2f.vertex_high = this->mesh->stl.v_indices[facet_idx].vertex[(i + 1) % 3];
+            e2f.vertex_low  = this->its.indices[facet_idx].vertex[i];
+            e2f.vertex_high = this->its.indices[facet_idx].vertex[(i + 1) % 3];
             e2f.face        = facet_idx;
             // 1 based indexing, to be always strictly positive.
             e2f.face_edge   = i + 1;
@@ -636,6 +1548,8 @@ TriangleMeshSlicer::TriangleMeshSlicer(TriangleMesh* _mesh) :
 		}
         ++ num_edges;
     }
+
+    this->facets_z_index.build(this->its);
 }
 
 void
@@ -670,48 +1584,99 @@ TriangleMeshSlicer::slice(const std::vector<float> &z, std::vector<Polygons>* la
         type is float.
     */
     
-    BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::_slice_do";
-    std::vector<IntersectionLines> lines(z.size());
-    {
-        boost::mutex lines_mutex;
+    layers->assign(z.size(), Polygons());
+    this->slice(z, [layers](size_t layer_idx, Polygons &loops) { (*layers)[layer_idx] = std::move(loops); });
+}
+
+void TriangleMeshSlicer::slice(const std::vector<float> &z, const LayerCallback &layer_done) const
+{
+    BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::slice in bands of layers";
+    // Both the bands and the Z index expect the planes sorted. Slice at the sorted planes
+    // and report the layers by their index in the input z list.
+    std::vector<size_t> order;
+    std::vector<float>  z_sorted;
+    const bool          sorted = std::is_sorted(z.begin(), z.end());
+    if (! sorted) {
+        order.assign(z.size(), 0);
+        for (size_t i = 0; i < z.size(); ++ i)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&z](size_t i1, size_t i2) { return z[i1] < z[i2]; });
+        z_sorted.assign(z.size(), 0.f);
+        for (size_t i = 0; i < z.size(); ++ i)
+            z_sorted[i] = z[order[i]];
+    }
+    const std::vector<float> &zs = sorted ? z : z_sorted;
+    for (size_t band_begin = 0; band_begin < zs.size();) {
+        // Grow the band of layers while the number of facets crossing it stays within the budget.
+        size_t band_end = band_begin + 1;
+        while (band_end < zs.size() && this->facets_z_index.count_facets(zs[band_begin], zs[band_end]) <= this->band_facets)
+            ++ band_end;
+        std::vector<float> z_band(zs.begin() + band_begin, zs.begin() + band_end);
+
+        BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::_slice_do - layers " << band_begin << " to " << band_end;
+        std::vector<IntersectionLines> lines(z_band.size());
+        this->_slice_lines(z_band, &lines);
+
+        // build loops, release the intersection lines of a layer as soon as its loops are built
+        BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::_make_loops_do - layers " << band_begin << " to " << band_end;
+        std::vector<Polygons> loops(z_band.size());
         tbb::parallel_for(
-            tbb::blocked_range<int>(0,this->mesh->stl.stats.number_of_facets),
-            [&lines, &lines_mutex, &z, this](const tbb::blocked_range<int>& range) {
-                for (int facet_idx = range.begin(); facet_idx < range.end(); ++ facet_idx)
-                    this->_slice_do(facet_idx, &lines, &lines_mutex, z);
+            tbb::blocked_range<size_t>(0, z_band.size()),
+            [&lines, &loops, this](const tbb::blocked_range<size_t>& range) {
+                for (size_t line_idx = range.begin(); line_idx < range.end(); ++ line_idx) {
+                    this->make_loops(lines[line_idx], &loops[line_idx]);
+                    IntersectionLines().swap(lines[line_idx]);
+                }
             }
         );
+        for (size_t i = 0; i < loops.size(); ++ i)
+            layer_done(sorted ? band_begin + i : order[band_begin + i], loops[i]);
+        band_begin = band_end;
     }
-    
-    // v_scaled_shared could be freed here
-    
-    // build loops
-    BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::_make_loops_do";
-    layers->resize(z.size());
+    BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::slice finished";
+}
+
+void TriangleMeshSlicer::_slice_lines(const std::vector<float> &z, std::vector<IntersectionLines>* lines) const
+{
+    // Visit only the facets crossed by the slicing planes, if the planes cross a minor part of the mesh
+    // (partial re-slicing, preview of a few layers, a band of a large mesh). Otherwise visit all facets.
+    const size_t     num_facets_total = this->its.facets_count();
+    std::vector<int> facets_crossed;
+    const bool       use_z_index = ! z.empty() && ! this->facets_z_index.empty() &&
+        (z.size() <= 8 || 2 * this->facets_z_index.count_facets(z.front(), z.back()) < num_facets_total);
+    if (use_z_index)
+        this->facets_z_index.facets_crossed(z, facets_crossed);
+    const size_t     num_facets = use_z_index ? facets_crossed.size() : num_facets_total;
+    // The facets are split into fixed ranges, each range collects its intersection lines into its own bucket,
+    // so that no lock is taken inside the facet loop. The buckets are scattered into the layers afterwards.
+    const size_t num_buckets = std::max<size_t>(1, std::min<size_t>(256, num_facets / 16384));
+    std::vector<LayerIntersectionLines> buckets(num_buckets);
     tbb::parallel_for(
-        tbb::blocked_range<size_t>(0, z.size()),
-        [&lines, &layers, this](const tbb::blocked_range<size_t>& range) {
-            for (size_t line_idx = range.begin(); line_idx < range.end(); ++ line_idx)
-                this->make_loops(lines[line_idx], &(*layers)[line_idx]);
+        tbb::blocked_range<size_t>(0, num_buckets, 1),
+        [&buckets, &z, &facets_crossed, use_z_index, num_facets, num_buckets, this](const tbb::blocked_range<size_t>& range) {
+            for (size_t bucket_idx = range.begin(); bucket_idx < range.end(); ++ bucket_idx) {
+                size_t end = num_facets * (bucket_idx + 1) / num_buckets;
+                for (size_t i = num_facets * bucket_idx / num_buckets; i < end; ++ i)
+                    this->_slice_do(use_z_index ? size_t(facets_crossed[i]) : i, &buckets[bucket_idx], z);
+            }
         }
     );
-    BOOST_LOG_TRIVIAL(debug) << "TriangleMeshSlicer::slice finished";
+    this->_merge_buckets(buckets, lines);
 }
 
-void TriangleMeshSlicer::_slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, 
-    const std::vector<float> &z) const
+void TriangleMeshSlicer::_slice_do(size_t facet_idx, LayerIntersectionLines* lines, const std::vector<float> &z) const
 {
-    const stl_facet &facet = this->mesh->stl.facet_start[facet_idx];
+    const stl_vertex &v0 = this->its.vertex(facet_idx, 0);
+    const stl_vertex &v1 = this->its.vertex(facet_idx, 1);
+    const stl_vertex &v2 = this->its.vertex(facet_idx, 2);
     
     // find facet extents
-    const float min_z = fminf(facet.vertex[0].z, fminf(facet.vertex[1].z, facet.vertex[2].z));
-    const float max_z = fmaxf(facet.vertex[0].z, fmaxf(facet.vertex[1].z, facet.vertex[2].z));
+    const float min_z = fminf(v0.z, fminf(v1.z, v2.z));
+    const float max_z = fmaxf(v0.z, fmaxf(v1.z, v2.z));
     
     #ifdef SLIC3R_DEBUG
     printf("\n==> FACET %d (%f,%f,%f - %f,%f,%f - %f,%f,%f):\n", facet_idx,
-        facet.vertex[0].x, facet.vertex[0].y, facet.vertex[0].z,
-        facet.vertex[1].x, facet.vertex[1].y, facet.vertex[1].z,
-        facet.vertex[2].x, facet.vertex[2].y, facet.vertex[2].z);
+        v0.x, v0.y, v0.z, v1.x, v1.y, v1.z, v2.x, v2.y, v2.z);
     printf("z: min = %.2f, max = %.2f\n", min_z, max_z);
     #endif
     
@@ -726,12 +1691,13 @@ void TriangleMeshSlicer::_slice_do(size_t facet_idx, std::vector<IntersectionLin
     for (std::vector<float>::const_iterator it = min_layer; it != max_layer + 1; ++it) {
         std::vector<float>::size_type layer_idx = it - z.begin();
         IntersectionLine il;
-        if (this->slice_facet(*it / SCALING_FACTOR, facet, facet_idx, min_z, max_z, &il)) {
-            boost::lock_guard<boost::mutex> l(*lines_mutex);
+        if (this->slice_facet(*it / SCALING_FACTOR, facet_idx, min_z, max_z, &il)) {
+            LayerIntersectionLine lil;
+            lil.layer_idx = layer_idx;
             if (il.edge_type == feHorizontal) {
                 // Insert all three edges of the face.
-                const int *vertices = this->mesh->stl.v_indices[facet_idx].vertex;
-                const bool reverse  = this->mesh->stl.facet_start[facet_idx].normal.z < 0;
+                const int *vertices = this->its.indices[facet_idx].vertex;
+                const bool reverse  = this->its.normal_z(facet_idx) < 0;
                 for (int j = 0; j < 3; ++ j) {
                     int               a_id     = vertices[j % 3];
                     int               b_id     = vertices[(j+1) % 3];
@@ -745,14 +1711,54 @@ void TriangleMeshSlicer::_slice_do(size_t facet_idx, std::vector<IntersectionLin
                     il.b.y    = b->y;
                     il.a_id   = a_id;
                     il.b_id   = b_id;
-                    (*lines)[layer_idx].push_back(il);
+                    lil.line  = il;
+                    lines->push_back(lil);
                 }
-            } else
-                (*lines)[layer_idx].push_back(il);
+            } else {
+                lil.line = il;
+                lines->push_back(lil);
+            }
         }
     }
 }
 
+void TriangleMeshSlicer::_merge_buckets(const std::vector<LayerIntersectionLines> &buckets, std::vector<IntersectionLines>* lines) const
+{
+    // Number of lines of each bucket per layer, later converted into the bucket's starting position inside the layer.
+    std::vector<std::vector<size_t>> layer_offsets(buckets.size(), std::vector<size_t>(lines->size(), 0));
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, buckets.size(), 1),
+        [&buckets, &layer_offsets](const tbb::blocked_range<size_t>& range) {
+            for (size_t bucket_idx = range.begin(); bucket_idx < range.end(); ++ bucket_idx)
+                for (const LayerIntersectionLine &lil : buckets[bucket_idx])
+                    ++ layer_offsets[bucket_idx][lil.layer_idx];
+        });
+    // The buckets cover consecutive facet ranges, therefore placing the lines of the buckets one after the other
+    // orders the lines of a layer exactly as if the facets were sliced sequentially.
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, lines->size()),
+        [&layer_offsets, lines](const tbb::blocked_range<size_t>& range) {
+            for (size_t layer_idx = range.begin(); layer_idx < range.end(); ++ layer_idx) {
+                size_t num_lines = 0;
+                for (std::vector<size_t> &offsets : layer_offsets) {
+                    size_t cnt = offsets[layer_idx];
+                    offsets[layer_idx] = num_lines;
+                    num_lines += cnt;
+                }
+                (*lines)[layer_idx].resize(num_lines);
+            }
+        });
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, buckets.size(), 1),
+        [&buckets, &layer_offsets, lines](const tbb::blocked_range<size_t>& range) {
+            for (size_t bucket_idx = range.begin(); bucket_idx < range.end(); ++ bucket_idx) {
+                std::vector<size_t> &offsets = layer_offsets[bucket_idx];
+                for (const LayerIntersectionLine &lil : buckets[bucket_idx])
+                    (*lines)[lil.layer_idx][offsets[lil.layer_idx] ++] = lil.line;
+            }
+        });
+}
+
 void
 TriangleMeshSlicer::slice(const std::vector<float> &z, std::vector<ExPolygons>* layers) const
 {
@@ -776,10 +1782,11 @@ TriangleMeshSlicer::slice(const std::vector<float> &z, std::vector<ExPolygons>*
 
 // Return true, if the facet has been sliced and line_out has been filled.
 bool TriangleMeshSlicer::slice_facet(
-    float slice_z, const stl_facet &facet, const int facet_idx,
+    float slice_z, const int facet_idx,
     const float min_z, const float max_z, 
     IntersectionLine *line_out) const
 {
+    const int        *vertices = this->its.indices[facet_idx].vertex;
     IntersectionPoint points[3];
     size_t            num_points = 0;
     size_t            points_on_layer[3];
@@ -788,10 +1795,9 @@ bool TriangleMeshSlicer::slice_facet(
     // Reorder vertices so that the first one is the one with lowest Z.
     // This is needed to get all intersection lines in a consistent order
     // (external on the right of the line)
-    int i = (facet.vertex[1].z == min_z) ? 1 : ((facet.vertex[2].z == min_z) ? 2 : 0);
+    int i = (this->its.vertices[vertices[1]].z == min_z) ? 1 : ((this->its.vertices[vertices[2]].z == min_z) ? 2 : 0);
     for (int j = i; j - i < 3; ++ j) {  // loop through facet edges
         int               edge_id  = this->facets_edges[facet_idx * 3 + (j % 3)];
-        const int        *vertices = this->mesh->stl.v_indices[facet_idx].vertex;
         int               a_id     = vertices[j % 3];
         int               b_id     = vertices[(j+1) % 3];
         const stl_vertex *a = &this->v_scaled_shared[a_id];
@@ -806,7 +1812,7 @@ bool TriangleMeshSlicer::slice_facet(
             if (min_z == max_z) {
                 // All three vertices are aligned with slice_z.
                 line_out->edge_type = feHorizontal;
-                if (this->mesh->stl.facet_start[facet_idx].normal.z < 0) {
+                if (this->its.normal_z(facet_idx) < 0) {
                     // If normal points downwards this is a bottom horizontal facet so we reverse its point order.
                     std::swap(a, b);
                     std::swap(a_id, b_id);
@@ -1172,6 +2178,7 @@ void TriangleMeshSlicer::cut(float z, TriangleMesh* upper, TriangleMesh* lower)
 {
     IntersectionLines upper_lines, lower_lines;
     
+    assert(this->mesh != nullptr);
     float scaled_z = scale_(z);
     for (int facet_idx = 0; facet_idx < this->mesh->stl.stats.number_of_facets; ++ facet_idx) {
         stl_facet* facet = &this->mesh->stl.facet_start[facet_idx];
@@ -1182,7 +2189,7 @@ void TriangleMeshSlicer::cut(float z, TriangleMesh* upper, TriangleMesh* lower)
         
         // intersect facet with cutting plane
         IntersectionLine line;
-        if (this->slice_facet(scaled_z, *facet, facet_idx, min_z, max_z, &line)) {
+        if (this->slice_facet(scaled_z, facet_idx, min_z, max_z, &line)) {
             // Save intersection lines for generating correct triangulations.
             if (line.edge_type == feTop) {
                 lower_lines.push_back(line);
@@ -3,6 +3,7 @@
 
 #include "libslic3r.h"
 #include <admesh/stl.h>
+#include <functional>
 #include <vector>
 #include <boost/thread.hpp>
 #include "BoundingBox.hpp"
@@ -17,21 +18,66 @@ class TriangleMesh;
 class TriangleMeshSlicer;
 typedef std::vector<TriangleMesh*> TriangleMeshPtrs;
 
+// Compact indexed representation of a triangle mesh: an array of vertices and an array of faces referencing
+// the vertices by their indices. It takes about a fifth of the memory of a repaired stl_file, which holds
+// each facet with its three vertices and a normal, the facet neighbors and the shared vertices.
+// Used wherever the mesh topology computed by the admesh repair is not needed (slicing, transformations).
+// Convert to a TriangleMesh for the repair.
+struct IndexedTriangleSet
+{
+    std::vector<stl_vertex>         vertices;
+    std::vector<v_indices_struct>   indices;
+
+    void clear() { this->vertices.clear(); this->indices.clear(); }
+    bool empty() const { return this->indices.empty(); }
+    size_t facets_count() const { return this->indices.size(); }
+    const stl_vertex& vertex(size_t facet_idx, int i) const { return this->vertices[this->indices[facet_idx].vertex[i]]; }
+    // Z component of the facet normal, not normalized.
+    float normal_z(size_t facet_idx) const;
+    BoundingBoxf3 bounding_box() const;
+    // Memory held by the vertex and face arrays, in bytes.
+    size_t memsize() const { return this->vertices.capacity() * sizeof(stl_vertex) + this->indices.capacity() * sizeof(v_indices_struct); }
+
+    void translate(float x, float y, float z);
+    void scale(float factor);
+    void scale(const Pointf3 &versor);
+    // Rotate around the Z axis, angle in radians.
+    void rotate_z(float angle);
+    // Rotate around an axis, angle in radians, with the same results as TriangleMesh::rotate().
+    void rotate(float angle, const Axis &axis);
+    // Same as rotate_z(), scale() and translate() called one after the other, in a single pass over the vertices.
+    void rotate_z_scale_translate(float angle, float factor, float x, float y, float z);
+    // Mirror the vertices and reverse the faces, so that they stay oriented outwards.
+    void mirror(const Axis &axis);
+
+    // Same as the TriangleMesh methods of the same names.
+    BoundingBoxf3 transformed_bounding_box(double angle, float factor) const;
+    ExPolygons horizontal_projection() const;
+    Polygon convex_hull() const;
+};
+
 class TriangleMesh
 {
 public:
     TriangleMesh();
     TriangleMesh(const Pointf3s &points, const std::vector<Point3> &facets);
+    explicit TriangleMesh(const IndexedTriangleSet &its);
     TriangleMesh(const TriangleMesh &other);
     TriangleMesh(TriangleMesh &&other);
     TriangleMesh& operator= (TriangleMesh other);
     TriangleMesh& operator= (TriangleMesh &&other);
     void swap(TriangleMesh &other);
     ~TriangleMesh();
-    void ReadSTLFile(const char* input_file);
+    // Load the STL file through stl_open_parallel(), or through admesh stl_open() with parallel = false.
+    void ReadSTLFile(const char* input_file, bool parallel = true);
     void write_ascii(const char* output_file);
     void write_binary(const char* output_file);
-    void repair();
+    // Repair the mesh with the TriangleMeshRepair replacements of the admesh steps.
+    // With parallel = false, the original admesh steps are called, producing the same mesh.
+    void repair(bool parallel = true);
+    // The first steps of repair(): match the edges of the facets exactly, then the edges left unconnected
+    // within a growing tolerance, which moves their end points to match exactly. Builds the facet neighbors.
+    void check_facets(bool parallel = true);
     void WriteOBJFile(char* output_file);
     void scale(float factor);
     void scale(const Pointf3 &versor);
@@ -40,6 +86,10 @@ public:
     void rotate_x(float angle);
     void rotate_y(float angle);
     void rotate_z(float angle);
+    // Rotate around the Z axis (radians), scale and translate in a single pass over the facets.
+    // The result is the same as of rotate_z(), scale() and translate() called one after the other.
+    // With simd = false, the scalar code path is taken even if SSE2 is available, producing the same mesh.
+    void rotate_z_scale_translate(float angle, float factor, float x, float y, float z, bool simd = true);
     void mirror(const Axis &axis);
     void mirror_x();
     void mirror_y();
@@ -48,9 +98,15 @@ public:
     void rotate(double angle, Point* center);
     TriangleMeshPtrs split() const;
     void merge(const TriangleMesh &mesh);
+    // Union of the projections of the facets to the XY plane, scaled. The facets are merged in parallel.
     ExPolygons horizontal_projection() const;
-    Polygon convex_hull();
+    // Convex hull of the vertices projected to the XY plane, scaled. The vertices are reduced in parallel.
+    Polygon convex_hull() const;
     BoundingBoxf3 bounding_box() const;
+    // Bounding box of this mesh rotated around the Z axis (radians) and scaled, calculated from the vertices
+    // without transforming a copy of the mesh. It is the bounding box of the mesh transformed by
+    // rotate_z_scale_translate(). With simd = false, the scalar code path is taken.
+    BoundingBoxf3 transformed_bounding_box(double angle, float factor, bool simd = true) const;
     void reset_repair_stats();
     bool needed_repair() const;
     size_t facets_count() const;
@@ -62,11 +118,21 @@ public:
     // Count disconnected triangle patches.
     size_t number_of_patches() const;
 
+    // Generate stl.v_shared and stl.v_indices, if not generated yet. An unrepaired mesh is repaired first,
+    // as the slicer expects the degenerate facets removed and the facets oriented consistently.
+    void require_shared_vertices();
+    // Regenerate stl.v_shared and stl.v_indices by welding the vertices with equal coordinates, which does
+    // not need the facet neighbors. For a repaired manifold mesh, the result is that of require_shared_vertices().
+    void generate_shared_vertices_welded();
+    // Indexed copy of this mesh. The mesh is not repaired and the shared vertices are not cached in this mesh
+    // if not generated yet: the vertices of an unrepaired mesh are welded. The degenerate facets, whose vertex indices
+    // are equal, are left out unless keep_degenerate is set, then the facets match stl.facet_start one to one.
+    IndexedTriangleSet indexed_triangle_set(bool keep_degenerate = false) const;
+
     stl_file stl;
     bool repaired;
     
 private:
-    void require_shared_vertices();
     friend class TriangleMeshSlicer;
 };
 
@@ -114,24 +180,94 @@ public:
 typedef std::vector<IntersectionLine> IntersectionLines;
 typedef std::vector<IntersectionLine*> IntersectionLinePtrs;
 
+// Index of the facets of a mesh by their Z span (a static centered interval tree).
+// Used by TriangleMeshSlicer to visit only the facets crossed by a subset of the slicing planes.
+class FacetZIndex
+{
+public:
+    void build(const IndexedTriangleSet &its);
+    void clear();
+    bool empty() const { return m_nodes.empty(); }
+
+    // Number of facets, whose Z span intersects <z_min, z_max>.
+    size_t count_facets(float z_min, float z_max) const;
+    // Collect the indices of the facets crossed by at least one of the sorted z planes, sorted by the facet index.
+    // The cost is proportional to the number of intersections of the planes with the facets.
+    void facets_crossed(const std::vector<float> &z, std::vector<int> &out) const;
+
+private:
+    struct Node {
+        // Facets of this node contain the center, facets of the left / right subtree are below / above the center.
+        float       center;
+        int         left;
+        int         right;
+        // Range of the facets of this node in m_by_min_z and m_by_max_z.
+        size_t      begin;
+        size_t      end;
+    };
+    int         build_node(int *begin, int *end);
+    // Report the facets, whose Z span contains z and whose min_z is above z_min.
+    void        stab(float z, float z_min, std::vector<int> &out) const;
+
+    std::vector<Node>   m_nodes;
+    // Facet indices of a node sorted by an increasing min_z / decreasing max_z.
+    std::vector<int>    m_by_min_z;
+    std::vector<int>    m_by_max_z;
+    // Z span of the facets, indexed by the facet index.
+    std::vector<float>  m_min_z;
+    std::vector<float>  m_max_z;
+    // Sorted Z spans of all facets, for count_facets().
+    std::vector<float>  m_min_z_sorted;
+    std::vector<float>  m_max_z_sorted;
+};
+
 class TriangleMeshSlicer
 {
 public:
     TriangleMeshSlicer(TriangleMesh* _mesh);
+    // Slicer of an indexed mesh, which does not support cut().
+    explicit TriangleMeshSlicer(IndexedTriangleSet &&its);
     void slice(const std::vector<float> &z, std::vector<Polygons>* layers) const;
+    // Called for each layer in the order of increasing z with the index of the layer in the z list
+    // and the loops of the layer, which may be moved out.
+    typedef std::function<void(size_t layer_idx, Polygons &loops)> LayerCallback;
+    // Slice at z planes in bands of layers. The intersection lines of a band are released
+    // before the next band is sliced, so the peak memory is bounded by a band, not by the whole object.
+    // An unsorted z list is sliced at the sorted planes.
+    void slice(const std::vector<float> &z, const LayerCallback &layer_done) const;
     void slice(const std::vector<float> &z, std::vector<ExPolygons>* layers) const;
-    bool slice_facet(float slice_z, const stl_facet &facet, const int facet_idx,
-        const float min_z, const float max_z, IntersectionLine *line_out) const;
+    bool slice_facet(float slice_z, const int facet_idx, const float min_z, const float max_z, IntersectionLine *line_out) const;
     void cut(float z, TriangleMesh* upper, TriangleMesh* lower) const;
+
+    // Maximum number of facets crossed by a band of layers sliced at once.
+    size_t                   band_facets;
     
 private:
+    // Source mesh for cut(), null if the slicer was created from an indexed mesh.
     const TriangleMesh      *mesh;
+    // Indexed mesh to be sliced.
+    IndexedTriangleSet       its;
     // Map from a facet to an edge index.
     std::vector<int>         facets_edges;
-    // Scaled copy of this->mesh->stl.v_shared
+    // Scaled copy of this->its.vertices
     std::vector<stl_vertex>  v_scaled_shared;
+    // Facets indexed by their Z span.
+    FacetZIndex              facets_z_index;
+
+    // Intersection line tagged with its layer, collected into per facet range buckets by _slice_do().
+    struct LayerIntersectionLine {
+        size_t           layer_idx;
+        IntersectionLine line;
+    };
+    typedef std::vector<LayerIntersectionLine> LayerIntersectionLines;
 
-    void _slice_do(size_t facet_idx, std::vector<IntersectionLines>* lines, boost::mutex* lines_mutex, const std::vector<float> &z) const;
+    // Build the scaled vertices, the facet to edge table and the Z index of this->its.
+    void _init();
+    void _slice_lines(const std::vector<float> &z, std::vector<IntersectionLines>* lines) const;
+    void _slice_do(size_t facet_idx, LayerIntersectionLines* lines, const std::vector<float> &z) const;
+    // Scatter the buckets of consecutive facet ranges into the per layer lines. The lines of a layer are ordered
+    // by the facet index, so the result does not depend on the number of threads or on the task scheduling.
+    void _merge_buckets(const std::vector<LayerIntersectionLines> &buckets, std::vector<IntersectionLines>* lines) const;
     void make_loops(std::vector<IntersectionLine> &lines, Polygons* loops) const;
     void make_expolygons(const Polygons &loops, ExPolygons* slices) const;
     void make_expolygons_simple(std::vector<IntersectionLine> &lines, ExPolygons* slices) const;
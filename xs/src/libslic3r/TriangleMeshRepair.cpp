@@ -0,0 +1,467 @@
+#include "TriangleMeshRepair.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include <tbb/atomic.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+
+namespace Slic3r {
+
+// Positive and negative zeros are possible in the floats, which are considered equal by the FP unit.
+// When using a memcmp on raw floats, those numbers report to be different.
+// Unify all +0 and -0 to +0 to make the floats equal under memcmp.
+static inline void unify_zeros(stl_facet &facet)
+{
+    uint32_t *f = (uint32_t*)&facet;
+    for (int j = 0; j < 12; ++ j, ++ f) // 3x vertex + normal: 4x3 = 12 floats
+        if (*f == 0x80000000)
+            // Negative zero, switch to positive zero.
+            *f = 0;
+}
+
+// If any two of the three vertices are exactly the same, the facet is degenerate.
+static inline bool is_degenerate(const stl_facet &facet)
+{
+    return memcmp(&facet.vertex[0], &facet.vertex[1], sizeof(stl_vertex)) == 0
+        || memcmp(&facet.vertex[1], &facet.vertex[2], sizeof(stl_vertex)) == 0
+        || memcmp(&facet.vertex[0], &facet.vertex[2], sizeof(stl_vertex)) == 0;
+}
+
+// Edge of a facet in the edge table of stl_check_facets_exact_parallel().
+struct FacetEdge {
+    // Binary copies of the two end points, sorted the same way as by admesh.
+    uint32_t key[6];
+    int      facet_number;
+    // Index of this edge inside the facet, increased by 3 if stored backwards.
+    int      which_edge;
+
+    bool same_key(const FacetEdge &rhs) const { return memcmp(this->key, rhs.key, sizeof(this->key)) == 0; }
+    uint64_t hash() const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < 6; ++ i)
+            hash = (hash ^ this->key[i]) * 1099511628211ULL;
+        return hash ^ (hash >> 29);
+    }
+};
+
+// Same as admesh stl_load_edge_exact(), returns the length of the edge for the shortest_edge statistics.
+static inline float load_edge_exact(FacetEdge &edge, int facet_number, int which_edge, const stl_vertex *a, const stl_vertex *b)
+{
+    edge.facet_number = facet_number;
+    edge.which_edge   = which_edge;
+    // Ensure identical vertex ordering of equal edges.
+    // This method is numerically robust.
+    if ((a->x != b->x) ?
+            (a->x < b->x) :
+            ((a->y != b->y) ?
+                (a->y < b->y) :
+                (a->z < b->z))) {
+        memcpy(&edge.key[0], a, sizeof(stl_vertex));
+        memcpy(&edge.key[3], b, sizeof(stl_vertex));
+    } else {
+        memcpy(&edge.key[0], b, sizeof(stl_vertex));
+        memcpy(&edge.key[3], a, sizeof(stl_vertex));
+        // this edge is loaded backwards
+        edge.which_edge += 3;
+    }
+    float diff_x = ABS(a->x - b->x);
+    float diff_y = ABS(a->y - b->y);
+    float diff_z = ABS(a->z - b->z);
+    return STL_MAX(diff_z, STL_MAX(diff_x, diff_y));
+}
+
+// Same as admesh stl_record_neighbors(), but the connection statistics are not updated.
+// Two edges of the same facet are never matched, therefore the edges matched concurrently
+// write to different neighbor slots.
+static inline void record_neighbors(stl_file *stl, const FacetEdge &edge_a, const FacetEdge &edge_b)
+{
+    stl_neighbors &neighbors_a = stl->neighbors_start[edge_a.facet_number];
+    stl_neighbors &neighbors_b = stl->neighbors_start[edge_b.facet_number];
+    neighbors_a.neighbor[edge_a.which_edge % 3]         = edge_b.facet_number;
+    neighbors_a.which_vertex_not[edge_a.which_edge % 3] = (edge_b.which_edge + 2) % 3;
+    neighbors_b.neighbor[edge_b.which_edge % 3]         = edge_a.facet_number;
+    neighbors_b.which_vertex_not[edge_b.which_edge % 3] = (edge_a.which_edge + 2) % 3;
+    if ((edge_a.which_edge < 3) == (edge_b.which_edge < 3)) {
+        // these facets are oriented in opposite directions.
+        // their normals are probably messed up.
+        neighbors_a.which_vertex_not[edge_a.which_edge % 3] += 3;
+        neighbors_b.which_vertex_not[edge_b.which_edge % 3] += 3;
+    }
+}
+
+// Match the edges of a bucket of the edge table, stored in the order of their insertion into the admesh hash table.
+// admesh matches an inserted edge with the first edge of the same key and of another facet waiting in the hash table.
+// The waiting vector is a scratch buffer reused between the calls.
+static void match_edges(stl_file *stl, const std::vector<FacetEdge> &edges, const uint32_t *begin, const uint32_t *end,
+    std::vector<const FacetEdge*> &waiting)
+{
+    if (end - begin == 2) {
+        // The most common case, a manifold edge.
+        const FacetEdge &edge_a = edges[begin[0]];
+        const FacetEdge &edge_b = edges[begin[1]];
+        if (edge_a.facet_number != edge_b.facet_number && edge_a.same_key(edge_b))
+            record_neighbors(stl, edge_b, edge_a);
+        return;
+    }
+    waiting.clear();
+    for (const uint32_t *it_edge = begin; it_edge != end; ++ it_edge) {
+        const FacetEdge *edge = &edges[*it_edge];
+        auto it = std::find_if(waiting.begin(), waiting.end(),
+            [edge](const FacetEdge *other) { return other->facet_number != edge->facet_number && other->same_key(*edge); });
+        if (it == waiting.end()) {
+            waiting.push_back(edge);
+        } else {
+            record_neighbors(stl, *edge, **it);
+            waiting.erase(it);
+        }
+    }
+}
+
+void stl_check_facets_exact_parallel(stl_file *stl)
+{
+    if (stl->error)
+        return;
+
+    stl->stats.connected_edges         = 0;
+    stl->stats.connected_facets_1_edge = 0;
+    stl->stats.connected_facets_2_edge = 0;
+    stl->stats.connected_facets_3_edge = 0;
+
+    // initialize neighbors list to -1 to mark unconnected edges
+    for (int i = 0; i < stl->stats.number_of_facets; ++ i) {
+        stl->neighbors_start[i].neighbor[0] = -1;
+        stl->neighbors_start[i].neighbor[1] = -1;
+        stl->neighbors_start[i].neighbor[2] = -1;
+    }
+
+    // Find the degenerate facets in parallel, then remove them in the order of admesh:
+    // a removed facet is replaced by the last facet, which is tested next.
+    std::vector<char> degenerate(stl->stats.number_of_facets, false);
+    tbb::parallel_for(
+        tbb::blocked_range<int>(0, stl->stats.number_of_facets),
+        [stl, &degenerate](const tbb::blocked_range<int> &range) {
+            for (int i = range.begin(); i < range.end(); ++ i) {
+                stl_facet facet = stl->facet_start[i];
+                unify_zeros(facet);
+                degenerate[i] = is_degenerate(facet);
+            }
+        });
+    for (int i = 0; i < stl->stats.number_of_facets;) {
+        if (degenerate[i]) {
+            int last = stl->stats.number_of_facets - 1;
+            stl->facet_start[i] = stl->facet_start[last];
+            degenerate[i]       = degenerate[last];
+            stl->stats.number_of_facets  -= 1;
+            stl->stats.degenerate_facets += 1;
+            stl->stats.facets_removed    += 1;
+        } else
+            ++ i;
+    }
+
+    // Build the edge table.
+    const int num_facets = stl->stats.number_of_facets;
+    std::vector<FacetEdge> edges(size_t(num_facets) * 3);
+    stl->stats.shortest_edge = tbb::parallel_reduce(
+        tbb::blocked_range<int>(0, num_facets), stl->stats.shortest_edge,
+        [stl, &edges](const tbb::blocked_range<int> &range, float shortest_edge) {
+            for (int i = range.begin(); i < range.end(); ++ i) {
+                stl_facet facet = stl->facet_start[i];
+                unify_zeros(facet);
+                for (int j = 0; j < 3; ++ j) {
+                    float length = load_edge_exact(edges[size_t(i) * 3 + j], i, j, &facet.vertex[j], &facet.vertex[(j + 1) % 3]);
+                    shortest_edge = STL_MIN(length, shortest_edge);
+                }
+            }
+            return shortest_edge;
+        },
+        [](float a, float b) { return std::min(a, b); });
+
+    // Distribute the edges into buckets by a hash of their key with a counting sort. The sort is stable,
+    // therefore the edges of a bucket stay in the order of their insertion into the admesh hash table.
+    size_t num_buckets = 1;
+    while (num_buckets < edges.size())
+        num_buckets <<= 1;
+    std::vector<uint32_t> edge_bucket(edges.size());
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, edges.size()),
+        [&edges, &edge_bucket, num_buckets](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                edge_bucket[i] = uint32_t(edges[i].hash() & (num_buckets - 1));
+        });
+    std::vector<uint32_t> bucket_start(num_buckets + 1, 0);
+    for (uint32_t bucket : edge_bucket)
+        ++ bucket_start[bucket + 1];
+    for (size_t i = 1; i <= num_buckets; ++ i)
+        bucket_start[i] += bucket_start[i - 1];
+    std::vector<uint32_t> bucket_edges(edges.size());
+    {
+        std::vector<uint32_t> bucket_end(bucket_start.begin(), bucket_start.end() - 1);
+        for (size_t i = 0; i < edges.size(); ++ i)
+            bucket_edges[bucket_end[edge_bucket[i]] ++] = uint32_t(i);
+    }
+
+    // Connect the equal edges of each bucket.
+    tbb::parallel_for(
+        tbb::blocked_range<size_t>(0, num_buckets),
+        [stl, &edges, &bucket_start, &bucket_edges](const tbb::blocked_range<size_t> &range) {
+            std::vector<const FacetEdge*> waiting;
+            for (size_t i = range.begin(); i < range.end(); ++ i)
+                if (bucket_start[i + 1] - bucket_start[i] > 1)
+                    match_edges(stl, edges, bucket_edges.data() + bucket_start[i], bucket_edges.data() + bucket_start[i + 1], waiting);
+        });
+
+    // Count the connections. admesh counts a facet with n connected edges in each of the
+    // connected_facets_k_edge with k <= n, and each connection in connected_edges twice.
+    struct Counts {
+        Counts() : edges(0), facets_1_edge(0), facets_2_edge(0), facets_3_edge(0) {}
+        int edges, facets_1_edge, facets_2_edge, facets_3_edge;
+    };
+    Counts counts = tbb::parallel_reduce(
+        tbb::blocked_range<int>(0, num_facets), Counts(),
+        [stl](const tbb::blocked_range<int> &range, Counts counts) {
+            for (int i = range.begin(); i < range.end(); ++ i) {
+                const stl_neighbors &neighbors = stl->neighbors_start[i];
+                int n = (neighbors.neighbor[0] != -1) + (neighbors.neighbor[1] != -1) + (neighbors.neighbor[2] != -1);
+                counts.edges         += n;
+                counts.facets_1_edge += n >= 1;
+                counts.facets_2_edge += n >= 2;
+                counts.facets_3_edge += n == 3;
+            }
+            return counts;
+        },
+        [](Counts a, const Counts &b) {
+            a.edges         += b.edges;
+            a.facets_1_edge += b.facets_1_edge;
+            a.facets_2_edge += b.facets_2_edge;
+            a.facets_3_edge += b.facets_3_edge;
+            return a;
+        });
+    stl->stats.connected_edges         = counts.edges;
+    stl->stats.connected_facets_1_edge = counts.facets_1_edge;
+    stl->stats.connected_facets_2_edge = counts.facets_2_edge;
+    stl->stats.connected_facets_3_edge = counts.facets_3_edge;
+}
+
+// Key of an edge in stl_check_facets_nearby_hashed(), indices of the grid cells of the two end points.
+struct GridEdgeKey {
+    uint32_t key[6];
+    bool operator==(const GridEdgeKey &rhs) const { return memcmp(this->key, rhs.key, sizeof(this->key)) == 0; }
+};
+
+struct GridEdgeKeyHash {
+    size_t operator()(const GridEdgeKey &edge) const {
+        size_t hash = 0;
+        for (int i = 0; i < 6; ++ i)
+            hash = hash * 1000003 ^ edge.key[i];
+        return hash;
+    }
+};
+
+// Same as admesh stl_load_edge_nearby().
+static inline bool load_edge_nearby(const stl_file *stl, stl_hash_edge &edge, const stl_vertex *a, const stl_vertex *b, float tolerance)
+{
+    // Index of a grid cell spaced by tolerance.
+    uint32_t vertex1[3] = {
+        (uint32_t)((a->x - stl->stats.min.x) / tolerance),
+        (uint32_t)((a->y - stl->stats.min.y) / tolerance),
+        (uint32_t)((a->z - stl->stats.min.z) / tolerance)
+    };
+    uint32_t vertex2[3] = {
+        (uint32_t)((b->x - stl->stats.min.x) / tolerance),
+        (uint32_t)((b->y - stl->stats.min.y) / tolerance),
+        (uint32_t)((b->z - stl->stats.min.z) / tolerance)
+    };
+    if (vertex1[0] == vertex2[0] && vertex1[1] == vertex2[1] && vertex1[2] == vertex2[2])
+        // Both vertices hash to the same value
+        return false;
+    // Ensure identical vertex ordering of edges, which vertices land into equal grid cells.
+    // This method is numerically robust.
+    if ((vertex1[0] != vertex2[0]) ?
+            (vertex1[0] < vertex2[0]) :
+            ((vertex1[1] != vertex2[1]) ?
+                (vertex1[1] < vertex2[1]) :
+                (vertex1[2] < vertex2[2]))) {
+        memcpy(&edge.key[0], vertex1, sizeof(stl_vertex));
+        memcpy(&edge.key[3], vertex2, sizeof(stl_vertex));
+    } else {
+        memcpy(&edge.key[0], vertex2, sizeof(stl_vertex));
+        memcpy(&edge.key[3], vertex1, sizeof(stl_vertex));
+        // this edge is loaded backwards
+        edge.which_edge += 3;
+    }
+    return true;
+}
+
+void stl_check_facets_nearby_hashed(stl_file *stl, float tolerance)
+{
+    if (stl->error)
+        return;
+    if (stl->stats.connected_facets_1_edge == stl->stats.number_of_facets &&
+        stl->stats.connected_facets_2_edge == stl->stats.number_of_facets &&
+        stl->stats.connected_facets_3_edge == stl->stats.number_of_facets)
+        // No need to check any further.  All facets are connected
+        return;
+    if (! (tolerance > 0.f))
+        // With a zero tolerance, admesh maps all the vertices into a single grid cell, therefore no edge is matched.
+        return;
+
+    // Edges waiting for a match, in the order of their insertion.
+    std::unordered_map<GridEdgeKey, std::vector<stl_hash_edge>, GridEdgeKeyHash> waiting;
+    for (int i = 0; i < stl->stats.number_of_facets; ++ i) {
+        // Matching an edge modifies the facets, the edges of this facet are taken from the facet before the modification.
+        stl_facet facet = stl->facet_start[i];
+        unify_zeros(facet);
+        for (int j = 0; j < 3; ++ j) {
+            if (stl->neighbors_start[i].neighbor[j] != -1)
+                continue;
+            stl_hash_edge edge;
+            edge.facet_number = i;
+            edge.which_edge   = j;
+            if (! load_edge_nearby(stl, edge, &facet.vertex[j], &facet.vertex[(j + 1) % 3], tolerance))
+                // only insert edges that have different keys
+                continue;
+            GridEdgeKey key;
+            memcpy(key.key, edge.key, sizeof(key.key));
+            std::vector<stl_hash_edge> &edges = waiting[key];
+            auto it = std::find_if(edges.begin(), edges.end(),
+                [&edge](const stl_hash_edge &other) { return other.facet_number != edge.facet_number; });
+            if (it == edges.end()) {
+                edges.push_back(edge);
+            } else {
+                stl_hash_edge other = *it;
+                edges.erase(it);
+                stl_match_neighbors_nearby(stl, &edge, &other);
+            }
+        }
+    }
+}
+
+// Same as admesh stl_reverse_facet(), but the reversed facets are counted by the caller.
+static void reverse_facet(stl_file *stl, int facet_num)
+{
+    stl_neighbors &neighbors = stl->neighbors_start[facet_num];
+    int neighbor[3] = { neighbors.neighbor[0], neighbors.neighbor[1], neighbors.neighbor[2] };
+    int vnot[3]     = { neighbors.which_vertex_not[0], neighbors.which_vertex_not[1], neighbors.which_vertex_not[2] };
+
+    // reverse the facet
+    std::swap(stl->facet_start[facet_num].vertex[0], stl->facet_start[facet_num].vertex[1]);
+
+    // fix the vnots of the neighboring facets
+    if (neighbor[0] != -1)
+        stl->neighbors_start[neighbor[0]].which_vertex_not[(vnot[0] + 1) % 3] =
+            (stl->neighbors_start[neighbor[0]].which_vertex_not[(vnot[0] + 1) % 3] + 3) % 6;
+    if (neighbor[1] != -1)
+        stl->neighbors_start[neighbor[1]].which_vertex_not[(vnot[1] + 1) % 3] =
+            (stl->neighbors_start[neighbor[1]].which_vertex_not[(vnot[1] + 1) % 3] + 4) % 6;
+    if (neighbor[2] != -1)
+        stl->neighbors_start[neighbor[2]].which_vertex_not[(vnot[2] + 1) % 3] =
+            (stl->neighbors_start[neighbor[2]].which_vertex_not[(vnot[2] + 1) % 3] + 2) % 6;
+
+    // swap the neighbors of the facet that is being reversed
+    neighbors.neighbor[1] = neighbor[2];
+    neighbors.neighbor[2] = neighbor[1];
+    // swap and reverse the vnots of the facet that is being reversed
+    neighbors.which_vertex_not[0] = (vnot[0] + 3) % 6;
+    neighbors.which_vertex_not[1] = (vnot[2] + 3) % 6;
+    neighbors.which_vertex_not[2] = (vnot[1] + 3) % 6;
+}
+
+// Orient the facets of a part the same way as stl_fix_normal_directions() does, starting with the seed facet.
+// Returns the number of facets reversed.
+static int fix_part_normal_directions(stl_file *stl, int seed, std::vector<char> &norm_sw)
+{
+    int facets_reversed = 0;
+    // If normal vector is not within tolerance and backwards, reverse the seed.
+    if (stl_check_normal_vector(stl, seed, 0) == 2) {
+        reverse_facet(stl, seed);
+        ++ facets_reversed;
+    }
+    norm_sw[seed] = 1;
+    std::vector<int> stack;
+    for (int facet_num = seed;;) {
+        const stl_neighbors &neighbors = stl->neighbors_start[facet_num];
+        for (int j = 0; j < 3; ++ j) {
+            // Reverse the neighboring facets if necessary.
+            if (neighbors.which_vertex_not[j] > 2 && neighbors.neighbor[j] != -1) {
+                reverse_facet(stl, neighbors.neighbor[j]);
+                ++ facets_reversed;
+            }
+            // If we haven't fixed the neighbor yet, add it to the stack.
+            if (neighbors.neighbor[j] != -1 && norm_sw[neighbors.neighbor[j]] != 1)
+                stack.push_back(neighbors.neighbor[j]);
+        }
+        if (stack.empty())
+            break;
+        facet_num = stack.back();
+        stack.pop_back();
+        norm_sw[facet_num] = 1;
+    }
+    return facets_reversed;
+}
+
+void stl_fix_normal_directions_parallel(stl_file *stl)
+{
+    if (stl->error)
+        return;
+    const int num_facets = stl->stats.number_of_facets;
+    if (num_facets == 0) {
+        stl->stats.number_of_parts += 1;
+        return;
+    }
+
+    // Split the facets into parts, each part seeded by its lowest facet index, as admesh does.
+    // If a part links to a facet of a part seeded earlier (the neighbor links are not symmetric),
+    // the orientation of the latter part affects the former, and the parts are processed sequentially.
+    std::vector<int> part(num_facets, -1);
+    std::vector<int> seeds;
+    std::vector<int> stack;
+    bool             independent = true;
+    for (int i = 0; i < num_facets; ++ i) {
+        if (part[i] != -1)
+            continue;
+        int part_id = int(seeds.size());
+        seeds.push_back(i);
+        part[i] = part_id;
+        stack.push_back(i);
+        while (! stack.empty()) {
+            const stl_neighbors &neighbors = stl->neighbors_start[stack.back()];
+            stack.pop_back();
+            for (int j = 0; j < 3; ++ j) {
+                int neighbor = neighbors.neighbor[j];
+                if (neighbor == -1)
+                    continue;
+                if (part[neighbor] == -1) {
+                    part[neighbor] = part_id;
+                    stack.push_back(neighbor);
+                } else if (part[neighbor] != part_id)
+                    independent = false;
+            }
+        }
+    }
+
+    std::vector<char> norm_sw(num_facets, 0);
+    int facets_reversed = 0;
+    if (independent) {
+        tbb::atomic<int> reversed;
+        reversed = 0;
+        tbb::parallel_for(
+            tbb::blocked_range<size_t>(0, seeds.size()),
+            [stl, &seeds, &norm_sw, &reversed](const tbb::blocked_range<size_t> &range) {
+                for (size_t i = range.begin(); i < range.end(); ++ i)
+                    reversed += fix_part_normal_directions(stl, seeds[i], norm_sw);
+            });
+        facets_reversed = reversed;
+    } else {
+        for (int seed : seeds)
+            facets_reversed += fix_part_normal_directions(stl, seed, norm_sw);
+    }
+    stl->stats.facets_reversed += facets_reversed;
+    stl->stats.number_of_parts += int(seeds.size());
+}
+
+} // namespace Slic3r
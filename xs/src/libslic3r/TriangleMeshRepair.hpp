@@ -0,0 +1,30 @@
+#ifndef slic3r_TriangleMeshRepair_hpp_
+#define slic3r_TriangleMeshRepair_hpp_
+
+#include "libslic3r.h"
+#include <admesh/stl.h>
+
+namespace Slic3r {
+
+// Replacements of the admesh repair steps called by TriangleMesh::repair(), which scale to meshes
+// with millions of facets. admesh matches the edges through a chained hash table with a fixed number
+// of chains, which degrades to a linear search on large meshes. These functions produce the same
+// facets, neighbors and repair statistics as their admesh counterparts.
+
+// Replaces stl_check_facets_exact(). Removes the degenerate facets, then connects the edges with
+// bitwise equal end points using an edge table bucketed by a counting sort of the edge hashes.
+// The edge table is built and matched in parallel.
+void stl_check_facets_exact_parallel(stl_file *stl);
+
+// Replaces stl_check_facets_nearby(). Connects the yet unconnected edges with end points falling
+// into the same cells of a grid spaced by tolerance. As connecting the edges modifies the facets,
+// the edges are matched sequentially, but through a hash map of the grid cells.
+void stl_check_facets_nearby_hashed(stl_file *stl, float tolerance);
+
+// Replaces stl_fix_normal_directions(). The facets are oriented consistently with the first facet
+// of their connected component, the components are processed in parallel.
+void stl_fix_normal_directions_parallel(stl_file *stl);
+
+} // namespace Slic3r
+
+#endif /* slic3r_TriangleMeshRepair_hpp_ */
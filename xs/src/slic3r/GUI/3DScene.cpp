@@ -267,7 +267,8 @@ std::vector<int> GLVolumeCollection::load_object(
         const ModelVolume *model_volume = model_object->volumes[volume_idx];
         for (int instance_idx : instance_idxs) {
             const ModelInstance *instance = model_object->instances[instance_idx];
-            TriangleMesh mesh = model_volume->mesh;
+            // Only the facets and their normals are displayed, the facet neighbors are not needed.
+            TriangleMesh mesh(model_volume->its);
             instance->transform_mesh(&mesh);
             volumes_idx.push_back(int(this->volumes.size()));
             float color[4];
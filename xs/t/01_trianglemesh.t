@@ -4,7 +4,7 @@ use strict;
 use warnings;
 
 use Slic3r::XS;
-use Test::More tests => 49;
+use Test::More tests => 76;
 
 is Slic3r::TriangleMesh::hello_world(), 'Hello world!',
     'hello world';
@@ -136,4 +136,109 @@ my $cube = {
     }
 }
 
+{
+    # A degenerate facet ahead of the others, the slicer shall address the facets left by the repair correctly.
+    my $m = Slic3r::TriangleMesh->new;
+    $m->ReadFromPerl($cube->{vertices}, [ [0,1,1], @{$cube->{facets}} ]);
+    my $upper = Slic3r::TriangleMesh->new;
+    my $lower = Slic3r::TriangleMesh->new;
+    $m->cut(10, $upper, $lower);
+    is $upper->facets_count, 2+12+6, 'cut of a mesh with a degenerate facet: upper mesh has the expected number of facets';
+    is $lower->facets_count, 2+12+6, 'cut of a mesh with a degenerate facet: lower mesh has the expected number of facets';
+    $upper->repair; $lower->repair;
+    ok abs($upper->stats->{volume} - 10*20*20) < 1E-2 && abs($lower->stats->{volume} - 10*20*20) < 1E-2, 'cut of a mesh with a degenerate facet: both halves are closed';
+}
+
+{
+    # A 20mm cube with each side split into a 4x4 grid, next to a copy of it turned inside out.
+    my (@vertices, @facets, %vertex_idx);
+    my $vertex = sub {
+        my $key = join ',', @_;
+        $vertex_idx{$key} //= do { push @vertices, [@_]; $#vertices };
+    };
+    foreach my $axis (0..2) {
+        foreach my $side (0, 20) {
+            foreach my $i (0..3) {
+                foreach my $j (0..3) {
+                    my @q = map {
+                        my @p;
+                        @p[$axis, ($axis+1) % 3, ($axis+2) % 3] = ($side, 5*$_->[0], 5*$_->[1]);
+                        $vertex->(@p);
+                    } [$i,$j], [$i+1,$j], [$i+1,$j+1], [$i,$j+1];
+                    my @f = ([ @q[0,1,2] ], [ @q[0,2,3] ]);
+                    @$_ = reverse @$_ for $side ? () : @f;
+                    push @facets, @f;
+                }
+            }
+        }
+    }
+    my $n = @vertices;
+    my @inside_out = map [ reverse map $_ + $n, @$_ ], @facets;
+    push @vertices, map [ $_->[0] + 30, @$_[1,2] ], @vertices;
+    # Flip some facets, open gaps by shifting the vertices of a few facets, remove a facet.
+    $_ % 7 == 3 and @{$facets[$_]} = reverse @{$facets[$_]} for 0..$#facets;
+    foreach my $f (grep $_ % 23 == 11, 0..$#facets) {
+        $facets[$f] = [ map { push @vertices, [ map $_ + 0.001, @{$vertices[$_]} ]; $#vertices } @{$facets[$f]} ];
+    }
+    splice @facets, 100, 1;
+    push @facets, @inside_out;
+    
+    my $parallel = Slic3r::TriangleMesh->new;
+    $parallel->ReadFromPerl(\@vertices, \@facets);
+    $parallel->repair;
+    my $serial = Slic3r::TriangleMesh->new;
+    $serial->ReadFromPerl(\@vertices, \@facets);
+    $serial->repair_serial;
+    
+    my $stats = $parallel->stats;
+    ok $stats->{edges_fixed} > 0 && $stats->{facets_added} > 0 && $stats->{facets_reversed} > 0,
+        'mesh with gaps and flipped facets needs repair';
+    is_deeply $stats, $serial->stats, 'parallel repair: same stats as admesh';
+    is_deeply $parallel->neighbors, $serial->neighbors, 'parallel repair: same neighbors as admesh';
+    is_deeply $parallel->normals, $serial->normals, 'parallel repair: same normals as admesh';
+    is_deeply $parallel->vertices, $serial->vertices, 'parallel repair: same vertices as admesh';
+    is_deeply $parallel->facets, $serial->facets, 'parallel repair: same facets as admesh';
+}
+
+{
+    # Welding the vertices by their coordinates numbers them as the admesh walk over the facet neighbors.
+    my $admesh = Slic3r::TriangleMesh::sphere(10);
+    $admesh->repair;
+    my $welded = $admesh->clone;
+    $welded->generate_shared_vertices_welded;
+    is_deeply $welded->vertices, $admesh->vertices, 'welded shared vertices: same v_shared as admesh';
+    is_deeply $welded->facets, $admesh->facets, 'welded shared vertices: same v_indices as admesh';
+}
+
+{
+    # The SSE2 and the scalar transformations against the admesh rotation, scaling and translation.
+    my $mesh = Slic3r::TriangleMesh::sphere(10);
+    $mesh->repair;
+    $mesh->scale_xyz(Slic3r::Pointf3->new(1.3, 0.7, 1.1));
+    $mesh->translate(3.3, -7.1, 2.2);
+    my $PI = 4 * atan2(1, 1);
+    my $bb3 = sub { my ($bb) = @_; [ $bb->x_min, $bb->y_min, $bb->x_max, $bb->y_max, $bb->z_min, $bb->z_max ] };
+    foreach my $deg (30, 90, 180, -123.4) {
+        my $angle = $deg / 180 * $PI;
+        my $admesh = $mesh->clone;
+        $admesh->rotate_z_scale_translate_admesh($angle, 1.7, 5.5, -2.25, 1);
+        my $simd = $mesh->clone;
+        $simd->rotate_z_scale_translate($angle, 1.7, 5.5, -2.25, 1);
+        my $scalar = $mesh->clone;
+        $scalar->rotate_z_scale_translate_scalar($angle, 1.7, 5.5, -2.25, 1);
+        my $expected = [ $admesh->vertices, $admesh->normals, $admesh->stats, $admesh->bb3 ];
+        is_deeply [ $simd->vertices, $simd->normals, $simd->stats, $simd->bb3 ], $expected,
+            "rotate_z_scale_translate by $deg degrees: same mesh as admesh";
+        is_deeply [ $scalar->vertices, $scalar->normals, $scalar->stats, $scalar->bb3 ], $expected,
+            "rotate_z_scale_translate by $deg degrees, scalar: same mesh as admesh";
+        
+        $admesh = $mesh->clone;
+        $admesh->rotate_z_scale_translate_admesh($angle, 1.7, 0, 0, 0);
+        is_deeply $bb3->($mesh->transformed_bounding_box($angle, 1.7)), $admesh->bb3,
+            "transformed_bounding_box by $deg degrees: bounding box of the admesh transformed mesh";
+        is_deeply $bb3->($mesh->transformed_bounding_box_scalar($angle, 1.7)), $admesh->bb3,
+            "transformed_bounding_box by $deg degrees, scalar: bounding box of the admesh transformed mesh";
+    }
+}
+
 __END__
@@ -9,7 +9,7 @@ BEGIN {
 }
 
 use Slic3r::XS;
-use Test::More tests => 20;
+use Test::More tests => 70;
 
 my $square = Slic3r::Polygon->new(  # ccw
     [100, 100],
@@ -89,4 +89,80 @@ my $expolygon = Slic3r::ExPolygon->new($square, $hole_in_square);
     ok $path->is_valid(), 'return path is valid';
 }
 
+{
+    # Two square holes and a diamond hole between them, whose side vertices lie on the line through the top edges
+    # of the square holes grown by the margin. The line connecting the corners of the grown squares passes
+    # through the diamond touching its vertices only.
+    my $contour = Slic3r::Polygon->new([0, 0], [300, 0], [300, 200], [0, 200]);
+    my @holes = (
+        Slic3r::Polygon->new([40, 60], [40, 100], [80, 100], [80, 60]),
+        Slic3r::Polygon->new([130, 101], [150, 121], [170, 101], [150, 81]),
+        Slic3r::Polygon->new([220, 60], [220, 100], [260, 100], [260, 60]),
+    );
+    $_->scale(1/0.000001) for $contour, @holes;
+    my $expolygon = Slic3r::ExPolygon->new($contour, @holes);
+    my $mp = Slic3r::MotionPlanner->new([ $expolygon ], 1);
+    isa_ok $mp, 'Slic3r::MotionPlanner';
+    my $mp_voronoi = Slic3r::MotionPlanner->new([ $expolygon ]);
+    
+    foreach my $query ([ 20, 100, 280, 100 ], [ 30, 101, 270, 101 ], [ 150, 50, 150, 150 ], [ 10, 10, 290, 190 ]) {
+        my $from = Slic3r::Point->new(@$query[0, 1]);
+        my $to = Slic3r::Point->new(@$query[2, 3]);
+        $_->scale(1/0.000001) for $from, $to;
+        my $path = $mp->shortest_path($from, $to);
+        ok $expolygon->contains_polyline($path), "visibility path from @$query[0, 1] to @$query[2, 3] is fully contained in expolygon";
+        is scalar(@{ Slic3r::Geometry::Clipper::intersection_pl([$path], \@holes) }), 0, 'visibility path does not pass through the holes';
+        ok $path->length <= $mp_voronoi->shortest_path($from, $to)->length, 'visibility path is not longer than the Voronoi path';
+    }
+}
+
+{
+    # A 3x2 grid of islands with two slotted holes each. The A* search must find paths as short
+    # as the Dijkstra search over the same graphs, within an island and between the islands.
+    my @islands = ();
+    foreach my $x (0, 60, 120) {
+        foreach my $y (0, 60) {
+            my @polygons = (
+                Slic3r::Polygon->new([$x, $y], [$x+40, $y], [$x+40, $y+40], [$x, $y+40]),
+                Slic3r::Polygon->new([$x+10, $y+5], [$x+10, $y+30], [$x+15, $y+30], [$x+15, $y+5]),
+                Slic3r::Polygon->new([$x+25, $y+10], [$x+25, $y+35], [$x+30, $y+35], [$x+30, $y+10]),
+            );
+            $_->scale(1/0.000001) for @polygons;
+            push @islands, Slic3r::ExPolygon->new(@polygons);
+        }
+    }
+    foreach my $visibility_graph (0, 1) {
+        my $mp = Slic3r::MotionPlanner->new(\@islands, $visibility_graph);
+        my $graph = $visibility_graph ? 'visibility' : 'Voronoi';
+        foreach my $query ([ 5, 20, 35, 20 ], [ 2, 2, 38, 38 ], [ 5, 20, 125, 80 ], [ 5, 5, 140, 95 ], [ 125, 85, 5, 5 ]) {
+            my $from = Slic3r::Point->new(@$query[0, 1]);
+            my $to = Slic3r::Point->new(@$query[2, 3]);
+            $_->scale(1/0.000001) for $from, $to;
+            my $path = $mp->shortest_path($from, $to);
+            ok $path->is_valid(), "$graph path from @$query[0, 1] to @$query[2, 3] is valid";
+            ok $path->first_point->coincides_with($from) && $path->last_point->coincides_with($to),
+                "$graph path from @$query[0, 1] to @$query[2, 3] connects the end points";
+            ok abs($path->length - $mp->shortest_path_dijkstra($from, $to)->length) < 1,
+                "$graph path from @$query[0, 1] to @$query[2, 3] is as long as the Dijkstra path";
+            ok $islands[0]->contains_polyline($path), "$graph path inside an island is fully contained in the island"
+                if $query->[0] < 40 && $query->[2] < 40;
+        }
+    }
+}
+
+{
+    # A straight move may touch the boundaries of the island, as long as it does not leave the island.
+    my $mp = Slic3r::MotionPlanner->new([ $expolygon ]);
+    foreach my $query ([ [130, 150], [150, 170], 'touching a corner of the hole' ], [ [120, 140], [180, 140], 'along an edge of the hole' ]) {
+        my ($from, $to) = map Slic3r::Point->new(@$_), @$query[0, 1];
+        $_->scale(1/0.000001) for $from, $to;
+        is scalar(@{$mp->shortest_path($from, $to)}), 2, "straight move $query->[2]";
+    }
+    my $from = Slic3r::Point->new(130, 130);
+    my $to = Slic3r::Point->new(170, 170);
+    $_->scale(1/0.000001) for $from, $to;
+    my $path = $mp->shortest_path($from, $to);
+    ok @$path > 2 && $expolygon->contains_polyline($path), 'a move through the corners of the hole avoids the hole';
+}
+
 __END__
@@ -4,7 +4,8 @@ use strict;
 use warnings;
 
 use Slic3r::XS;
-use Test::More tests => 4;
+use File::Temp qw(tempdir);
+use Test::More tests => 21;
 
 {
     my $model = Slic3r::Model->new;
@@ -19,4 +20,64 @@ use Test::More tests => 4;
     is_deeply $object->layer_height_ranges, $lhr, 'layer_height_ranges roundtrip';
 }
 
+{
+    my $mesh = Slic3r::TriangleMesh->new;
+    $mesh->ReadFromPerl(
+        [ [20,20,0], [20,0,0], [0,0,0], [0,20,0], [20,20,20], [0,20,20], [0,0,20], [20,0,20] ],
+        [ [0,1,2], [0,2,3], [4,5,6], [4,6,7], [0,4,7], [0,7,1], [1,7,6], [1,6,2], [2,6,5], [2,5,3], [4,0,3], [4,3,5] ],
+    );
+    $mesh->repair;
+    my $model = Slic3r::Model->new;
+    my $object = $model->_add_object;
+    $object->_add_volume($mesh);
+    is scalar(@{$object->raw_convex_hull}), 4, 'raw_convex_hull of a cube';
+    is scalar(@{$object->raw_horizontal_projection}), 1, 'raw_horizontal_projection of a cube';
+    $object->translate(10, 0, 0);
+    my $SCALING_FACTOR = 0.000001;
+    is $object->raw_convex_hull->bounding_box->x_min, 10/$SCALING_FACTOR,
+        'raw_convex_hull is updated after translating the object';
+
+    my $dir = tempdir(CLEANUP => 1);
+    foreach my $compress (0, 1) {
+        my $path = "$dir/cube" . ($compress ? '.zip.amf' : '.amf');
+        ok $model->store_amf($path, $compress), 'store_amf' . ($compress ? ' compressed' : '');
+        my $loaded = Slic3r::Model->load_amf($path);
+        is $loaded->objects->[0]->volumes->[0]->mesh_copy->facets_count, 12,
+            'load_amf' . ($compress ? ' compressed' : '') . ' round trip';
+    }
+
+    my $hash = Slic3r::Model->file_hash("$dir/cube.amf");
+    like $hash, qr/^[0-9a-f]{16}$/, 'file_hash';
+    ok $model->store_cache("$dir/cube.model", $hash), 'store_cache';
+    is Slic3r::Model->load_cache("$dir/cube.model", $hash)->objects->[0]->volumes->[0]->mesh_copy->facets_count, 12,
+        'load_cache round trip';
+}
+
+{
+    # The volume stores the repaired mesh as an indexed triangle set, mesh_copy() rebuilds it.
+    my $mesh = Slic3r::TriangleMesh::sphere(10);
+    $mesh->repair;
+    my $model = Slic3r::Model->new;
+    my $volume = $model->_add_object->_add_volume($mesh);
+    my $copy = $volume->mesh_copy;
+    is_deeply $copy->stats, $mesh->stats, 'mesh_copy keeps the stats';
+    is_deeply $copy->vertices, $mesh->vertices, 'mesh_copy is repaired and keeps the vertices';
+    is_deeply $copy->facets, $mesh->facets, 'mesh_copy keeps the facets';
+    is_deeply $copy->neighbors, $mesh->neighbors, 'mesh_copy rebuilds the facet neighbors';
+    is $volume->bounding_box->serialize, $mesh->bounding_box->serialize, 'bounding_box of the indexed volume';
+}
+
+{
+    # A mesh fixed by the repair: a vertex of a facet is slightly off and a facet is missing.
+    my $mesh = Slic3r::TriangleMesh->new;
+    $mesh->ReadFromPerl(
+        [ [20,20,0], [20,0,0], [0,0,0], [0,20,0], [20,20,20], [0,20,20], [0,0,20], [20,0,20], [20.0005,20,20] ],
+        [ [0,1,2], [0,2,3], [8,5,6], [0,4,7], [0,7,1], [1,7,6], [1,6,2], [2,6,5], [2,5,3], [4,0,3], [4,3,5] ],
+    );
+    $mesh->repair;
+    ok $mesh->stats->{edges_fixed} > 0 && $mesh->stats->{facets_added} > 0, 'the edges are fixed and the hole is filled';
+    my $volume = Slic3r::Model->new->_add_object->_add_volume($mesh);
+    is_deeply $volume->mesh_copy->neighbors, $mesh->neighbors, 'mesh_copy rebuilds the facet neighbors of a fixed mesh';
+}
+
 __END__
@@ -4,7 +4,7 @@ use strict;
 use warnings;
 
 use Slic3r::XS;
-use Test::More tests => 2;
+use Test::More tests => 5;
 
 {
     my $gcodegen = Slic3r::GCode->new;
@@ -14,4 +14,15 @@ use Test::More tests => 2;
     is_deeply $gcodegen->origin->pp, [15,5], 'origin returns reference to point';
 }
 
+{
+    my $writer = Slic3r::GCode::Writer->new;
+    $writer->set_extruders([0]);
+    $writer->set_extruder(0);
+    is $writer->travel_to_xy(Slic3r::Pointf->new(1.0625, -0.0001)), "G1 X1.062 Y-0.000 F7800.000\n",
+        'travel_to_xy rounds coordinates like printf';
+    is $writer->extrude_to_xy(Slic3r::Pointf->new(10, 20), 1.234567), "G1 X10.000 Y20.000 E1.23457\n",
+        'extrude_to_xy';
+    is $writer->set_speed(1234.5), "G1 F1234.5\n", 'set_speed';
+}
+
 __END__
@@ -0,0 +1,54 @@
+#!/usr/bin/perl
+
+# Slicing throughput against the number of threads.
+# The slices must not depend on the number of threads used,
+# nor on the bands, the Z index or the order of the slicing planes.
+
+use strict;
+use warnings;
+
+use Slic3r::XS;
+use Test::More tests => 8;
+use Time::HiRes qw(time);
+
+my @threads = (1, 2, 4, 8, 16);
+
+my $mesh = Slic3r::TriangleMesh::sphere(50);
+$mesh->repair;
+my $facets = $mesh->facets_count;
+my @z = map { -49.95 + 0.1 * $_ } 0..999;
+
+my $reference;
+foreach my $threads (@threads) {
+    my $t0 = time;
+    my $slices = $mesh->slice(\@z, $threads);
+    my $elapsed = time - $t0;
+    my $dump = [ map { [ map $_->pp, @$_ ] } @$slices ];
+    $reference //= $dump;
+    is_deeply $dump, $reference, "slices with $threads thread(s) match the single threaded slices";
+    diag sprintf "%2d thread(s): %d facets x %d layers in %.3f s (%.0f facets/s)",
+        $threads, $facets, scalar(@z), $elapsed, $facets / ($elapsed || 1e-6);
+}
+
+{
+    my $slices = $mesh->slice(\@z, 0, 2000);
+    is_deeply [ map { [ map $_->pp, @$_ ] } @$slices ], $reference,
+        'slices in narrow bands match the slices of a single band';
+}
+
+{
+    # A few planes are sliced through the Z index.
+    my @idx = (0, 17, 500, 998);
+    my $slices = $mesh->slice([ @z[@idx] ]);
+    is_deeply [ map { [ map $_->pp, @$_ ] } @$slices ], [ @$reference[@idx] ],
+        'slices of a few planes match the full slices';
+}
+
+{
+    my @idx = map { ($_ * 389) % scalar(@z) } 0..$#z;
+    my $slices = $mesh->slice([ @z[@idx] ], 0, 2000);
+    is_deeply [ map { [ map $_->pp, @$_ ] } @$slices ], [ @$reference[@idx] ],
+        'slices of unsorted planes are returned in the order of the planes';
+}
+
+__END__
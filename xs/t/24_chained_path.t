@@ -0,0 +1,77 @@
+#!/usr/bin/perl
+
+# Nearest neighbor path ordering against a linear scan reference,
+# with the timing of both on a synthetic and on an infill like layer.
+
+use strict;
+use warnings;
+
+use Slic3r::XS;
+use Test::More tests => 4;
+use Time::HiRes qw(time);
+
+# Greedy nearest neighbor walk by a linear scan, selecting the points like Point::nearest_point_index().
+sub chained_path_reference {
+    my ($points) = @_;
+    my @left = (0..$#$points);
+    my $start = $points->[0];
+    my @order;
+    while (@left) {
+        my ($best, $dmin) = (-1, -1);
+        for my $k (0..$#left) {
+            my $p = $points->[$left[$k]];
+            my $d = ($start->[0] - $p->[0])**2 + ($start->[1] - $p->[1])**2;
+            next if $dmin != -1 && $d > $dmin;
+            ($best, $dmin) = ($k, $d);
+            last if $dmin == 0;
+        }
+        push @order, $left[$best];
+        $start = $points->[$left[$best]];
+        splice @left, $best, 1;
+    }
+    return \@order;
+}
+
+sub compare {
+    my ($name, $points) = @_;
+    my $t0 = time;
+    my $reference = chained_path_reference($points);
+    my $t1 = time;
+    my $order = Slic3r::Geometry::chained_path([ map Slic3r::Point->new(@$_), @$points ]);
+    my $t2 = time;
+    is_deeply $order, $reference, "chained_path matches the linear scan on $name";
+    diag sprintf "%s, %d points: linear scan %.3f s, chained_path %.3f s", $name, scalar(@$points), $t1 - $t0, $t2 - $t1;
+}
+
+srand(1);
+compare('random points', [ map [ int(rand(10000000)), int(rand(10000000)) ], 1..2000 ]);
+
+# End points of short infill segments on a regular grid, many of them equally distant.
+{
+    my @points;
+    for my $i (0..49) {
+        for my $j (0..19) {
+            push @points, [ $i * 400000, $j * 500000 ], [ $i * 400000, $j * 500000 + 300000 ];
+        }
+    }
+    compare('infill segments', \@points);
+}
+
+{
+    # Short gap fill like segments of a dense top solid layer.
+    my @polylines = map {
+        my ($x, $y) = (int(rand(10000000)), int(rand(10000000)));
+        Slic3r::Polyline->new([ $x, $y ], [ $x + int(rand(400000)), $y + int(rand(400000)) ]);
+    } 1..20000;
+    my $collection = Slic3r::Polyline::Collection->new(@polylines);
+    my $t0 = time;
+    my $chained = $collection->chained_path(0);
+    diag sprintf "chained_path of %d polylines: %.3f s", scalar(@polylines), time - $t0;
+    is scalar(@$chained), scalar(@polylines), 'all polylines chained';
+    my $t1 = time;
+    my $chained_no_reverse = $collection->chained_path(1);
+    diag sprintf "chained_path of %d polylines, no reverse: %.3f s", scalar(@polylines), time - $t1;
+    is scalar(@$chained_no_reverse), scalar(@polylines), 'all polylines chained without reversal';
+}
+
+__END__
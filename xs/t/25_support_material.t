@@ -0,0 +1,94 @@
+#!/usr/bin/perl
+
+# Support of a leaning tower overhanging at every layer, checked against the values
+# of the sequential support generator. Set SLIC3R_BENCHMARK to time the support generation
+# of taller leaning towers and of a table with a wide top on a thin column.
+
+use strict;
+use warnings;
+
+use List::Util qw(sum);
+use Slic3r::XS;
+use Test::More tests => 4 + ($ENV{SLIC3R_BENCHMARK} ? 4 : 0);
+use Time::HiRes qw(time);
+
+sub leaning_tower {
+    my ($height) = @_;
+    my $mesh = Slic3r::TriangleMesh::cube(20, 20, $height);
+    # Lean the tower by 0.9 radians, so that each layer overhangs the layer below by more than half an extrusion width.
+    $mesh->rotate_y(0.9);
+    return $mesh;
+}
+
+sub table {
+    my ($height) = @_;
+    my $mesh = Slic3r::TriangleMesh::cube(4, 4, $height);
+    $mesh->translate(18, 18, 0);
+    my $top = Slic3r::TriangleMesh::cube(40, 40, 3);
+    $top->translate(0, 0, $height);
+    $mesh->merge($top);
+    return $mesh;
+}
+
+# The model has to outlive the print, which references its objects.
+sub print_with_support {
+    my ($mesh) = @_;
+    my $bb = $mesh->bounding_box;
+    $mesh->translate(-$bb->x_min, -$bb->y_min, -$bb->z_min);
+    $mesh->repair;
+    my $model = Slic3r::Model->new;
+    my $object = $model->_add_object;
+    $object->_add_volume($mesh);
+    $object->_add_instance->set_offset(Slic3r::Pointf->new(100, 100));
+    my $config = Slic3r::Config->new;
+    $config->apply_static(Slic3r::Config::Static::new_FullPrintConfig);
+    $config->set('support_material', 1);
+    my $print = Slic3r::Print->new;
+    $print->apply_config($config);
+    $print->add_model_object($object);
+    my $print_object = $print->get_object(0);
+    $print_object->_slice;
+    $print_object->detect_surfaces_type;
+    return ($model, $print, $print_object);
+}
+
+sub support_layers {
+    my ($object) = @_;
+    return [ map {
+        my $layer = $object->get_support_layer($_);
+        [ $layer->print_z, $layer->support_islands->pp, $layer->support_fills->items_count ]
+    } 0..($object->support_layer_count - 1) ];
+}
+
+{
+    my ($model, $print, $object) = print_with_support(leaning_tower(50));
+    $object->_generate_support_material;
+    my $SCALING_FACTOR = 0.000001;
+    my $area = sum(map { map $_->area, @{$object->get_support_layer($_)->support_islands} } 0..($object->support_layer_count - 1))
+        * $SCALING_FACTOR**2;
+    is $object->support_layer_count, 110, 'number of support layers of a 50mm leaning tower';
+    ok abs($object->get_support_layer(0)->print_z - 0.35) < 1e-6, 'support of a 50mm leaning tower starts at the print bed';
+    ok abs($area - 45711.40) < 1, 'total area of the support islands of a 50mm leaning tower';
+    my $layers = support_layers($object);
+    $object->clear_support_layers;
+    $object->_generate_support_material;
+    is_deeply support_layers($object), $layers, 'support of a 50mm leaning tower is reproducible';
+}
+
+if ($ENV{SLIC3R_BENCHMARK}) {
+    foreach my $shape ([ 'leaning tower', \&leaning_tower ], [ 'table', \&table ]) {
+        my ($name, $make_mesh) = @$shape;
+        foreach my $height (100, 200) {
+            my ($model, $print, $object) = print_with_support($make_mesh->($height));
+            my $t0 = time;
+            $object->_generate_support_material;
+            my $elapsed = time - $t0;
+            ok $object->support_layer_count > 0 && $object->get_support_layer(0)->print_z < 1,
+                "support of a ${height}mm $name starts at the print bed";
+            diag sprintf "%3d mm %s, %d layers: %d support layers generated in %.3f s",
+                $height, $name, $object->layer_count, $object->support_layer_count, $elapsed;
+        }
+    }
+}
+
+__END__
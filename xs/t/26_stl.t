@@ -0,0 +1,111 @@
+#!/usr/bin/perl
+
+# The STL loader, which parses the ASCII files in chunks in parallel, checked against admesh stl_open().
+
+use strict;
+use warnings;
+
+use Slic3r::XS;
+use File::Temp qw(tempdir);
+use Test::More tests => 13;
+
+# Facets of a cube of a side $size, each side split into a $n x $n grid.
+sub grid_cube {
+    my ($size, $n) = @_;
+    my @facets;
+    foreach my $axis (0..2) {
+        foreach my $side (0, $size) {
+            foreach my $i (0..$n-1) {
+                foreach my $j (0..$n-1) {
+                    my @q = map {
+                        my @p;
+                        @p[$axis, ($axis+1) % 3, ($axis+2) % 3] = ($side, $size*$_->[0]/$n, $size*$_->[1]/$n);
+                        \@p;
+                    } [$i,$j], [$i+1,$j], [$i+1,$j+1], [$i,$j+1];
+                    my @f = ([ @q[0,1,2] ], [ @q[0,2,3] ]);
+                    @$_ = reverse @$_ for $side ? () : @f;
+                    push @facets, @f;
+                }
+            }
+        }
+    }
+    return \@facets;
+}
+
+sub ascii_stl {
+    my ($facets, $eol) = @_;
+    return join '', "solid cube$eol",
+        (map { ("  facet normal 0 0 0$eol", "    outer loop$eol",
+            (map sprintf("      vertex %.6f %.6f %.6f$eol", @$_), @$_),
+            "    endloop$eol", "  endfacet$eol") } @$facets),
+        "endsolid cube$eol";
+}
+
+sub binary_stl {
+    my ($header, $facets) = @_;
+    return pack('a80V', $header, scalar(@$facets))
+        . join '', map pack('f<12v', 0, 0, 0, (map @$_, @$_), 0), @$facets;
+}
+
+my $dir = tempdir(CLEANUP => 1);
+sub write_stl {
+    my ($name, $data) = @_;
+    my $path = "$dir/$name.stl";
+    open my $fh, '>:raw', $path or die "Failed to write $path\n";
+    print $fh $data;
+    close $fh;
+    return $path;
+}
+
+sub load {
+    my ($path, $serial) = @_;
+    my $mesh = Slic3r::TriangleMesh->new;
+    $serial ? $mesh->ReadSTLFile_serial($path) : $mesh->ReadSTLFile($path);
+    return $mesh;
+}
+
+# Load $path in parallel, $admesh_path through admesh, compare the facets read.
+sub compare_with_admesh {
+    my ($path, $admesh_path, $name) = @_;
+    my $mesh   = load($path);
+    my $admesh = load($admesh_path, 1);
+    is $mesh->facets_count, $admesh->facets_count, "$name: same number of facets as admesh";
+    my $size = $mesh->size;
+    $_->repair for $mesh, $admesh;
+    is_deeply [ $size, $mesh->vertices, $mesh->facets ], [ $admesh->size, $admesh->vertices, $admesh->facets ],
+        "$name: same facets as admesh";
+    return $mesh;
+}
+
+{
+    # About 2.4MB, parsed in three chunks.
+    my $facets = grid_cube(20.3, 33);
+    my $lf   = write_stl('lf',   ascii_stl($facets, "\n"));
+    my $crlf = write_stl('crlf', ascii_stl($facets, "\r\n"));
+    compare_with_admesh($lf, $lf, 'ASCII STL over 1MB');
+    compare_with_admesh($crlf, $crlf, 'ASCII STL with CRLF line ends');
+    compare_with_admesh($crlf, $lf, 'ASCII STL with CRLF line ends vs. LF');
+    
+    # Cut in the middle of the vertices of the last facet.
+    my $data = ascii_stl($facets, "\n");
+    my $truncated = write_stl('truncated', substr($data, 0, rindex($data, 'vertex') - 20));
+    my $mesh = load($truncated);
+    compare_with_admesh($truncated, $truncated, 'truncated ASCII STL');
+    is $mesh->facets_count, @$facets - 1, 'truncated ASCII STL: incomplete facet ignored';
+}
+
+{
+    # Small integer coordinates, so there is no byte above 127 following the header,
+    # which admesh would read as an ASCII file.
+    my $facets = grid_cube(8, 1);
+    my $binary = write_stl('binary', binary_stl('solid cube', $facets));
+    my $ascii  = write_stl('ascii', ascii_stl($facets, "\n"));
+    is load($binary)->facets_count, 12, 'binary STL with a header starting with solid';
+    compare_with_admesh($binary, $ascii, 'binary STL with a header starting with solid');
+    
+    my $truncated = write_stl('binary_truncated', substr(binary_stl('cube', grid_cube(20.3, 2)), 0, -10));
+    is_deeply [ load($truncated)->facets_count, load($truncated, 1)->facets_count ], [ 0, 0 ],
+        'truncated binary STL is rejected';
+}
+
+__END__